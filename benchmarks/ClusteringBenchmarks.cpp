@@ -0,0 +1,70 @@
+// ToyTopoClustering on events of increasing hit multiplicity, and the neighbour table it runs on
+#include "ToyBenchmarkGeometry.h"
+#include "ToyTopoClustering.h"
+#include <benchmark/benchmark.h>
+
+using namespace ToyCalorimeter;
+using dd4hep::DDSegmentation::ToySegmentation;
+
+namespace {
+
+  const ToySegmentation& clusteringSegmentation() {
+    static const auto segmentation = []() {
+      auto s = ToyBenchmarkGeometry::make(false);
+      s->buildNeighbourTable();
+      return s;
+    }();
+    return *segmentation;
+  }
+
+  // Showers of up to 100 cells grown from random crystals, energies falling with the distance to the seed
+  void showers(const ToySegmentation& segmentation, std::size_t nHits, std::vector<long>& cells, std::vector<float>& energy) {
+    std::mt19937 engine(7);
+    std::uniform_int_distribution<long> anyCell(0, segmentation.numberOfCells()-1);
+    std::vector<char> used(segmentation.numberOfCells(), 0);
+    std::vector<std::pair<long, int>> queue;
+    while ( cells.size() < nHits ) {
+      queue.assign(1, {anyCell(engine), 0});
+      const std::size_t end = std::min(nHits, cells.size() + 100);
+      for ( std::size_t q = 0; q < queue.size() && cells.size() < end; q++ ) {
+        const auto [cell, step] = queue[q];
+        if ( used[cell] ) continue;
+        used[cell] = 1;
+        cells.push_back(cell);
+        energy.push_back(2.f*std::exp(-2.f*step));
+        for ( const uint32_t n : segmentation.neighbours(cell) ) {
+          if ( !used[n] ) queue.emplace_back(n, step+1);
+        }
+      }
+    }
+  }
+
+  void BM_NeighbourTableBuild(benchmark::State& state) {
+    auto segmentation = ToyBenchmarkGeometry::make(false);
+    for ( auto _ : state ) {
+      segmentation->buildNeighbourTable();
+      benchmark::DoNotOptimize(segmentation->neighbourIndices().data());
+    }
+    state.SetItemsProcessed(state.iterations()*segmentation->numberOfCells());
+  }
+  BENCHMARK(BM_NeighbourTableBuild)->Unit(benchmark::kMillisecond);
+
+  // Argument: hits per event
+  void BM_TopoClustering(benchmark::State& state) {
+    const auto& segmentation = clusteringSegmentation();
+    std::vector<long> cells;
+    std::vector<float> energy;
+    showers(segmentation, state.range(0), cells, energy);
+    std::vector<int> cluster(cells.size());
+    ToyTopoClustering topo(segmentation);
+    int nClusters = 0;
+    for ( auto _ : state ) {
+      nClusters = topo.run(cells, energy, cluster);
+      benchmark::DoNotOptimize(cluster.data());
+    }
+    state.SetItemsProcessed(state.iterations()*cells.size());
+    state.counters["clusters"] = nClusters;
+  }
+  BENCHMARK(BM_TopoClustering)->RangeMultiplier(8)->Range(1000, 64000)->Unit(benchmark::kMicrosecond);
+
+}
@@ -0,0 +1,86 @@
+// Hit conversion of Geant4EDM4ToyReadout: the converters registered for Geant4Calorimeter::Hit and ToyCaloHit,
+// run on a synthetic Geant4HitCollection as saveCollection() runs them. The hits carry no MC contributions, so
+// this is the hit loop with its unit conversion; the output collections are cleared outside the timed region.
+#include "Geant4EDM4ToyReadout.h"
+#include "ToyBenchmarkGeometry.h"
+#include "ToyCaloHit.h"
+#include "ToyHitPool.h"
+#include <DD4hep/Detector.h>
+#include <DDG4/Geant4Context.h>
+#include <DDG4/Geant4HitCollection.h>
+#include <DDG4/Geant4Kernel.h>
+#include <DDG4/Geant4Particle.h>
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+using namespace ToyCalorimeter;
+using dd4hep::sim::Geant4EDM4ToyReadout;
+using dd4hep::sim::Geant4HitCollection;
+
+namespace {
+
+  // One output action for all benchmarks; it is never run, so it opens no file
+  Geant4EDM4ToyReadout& converterOutput() {
+    static dd4hep::sim::Geant4Context context(&dd4hep::sim::Geant4Kernel::instance(dd4hep::Detector::getInstance()));
+    static Geant4EDM4ToyReadout* output = new Geant4EDM4ToyReadout(&context, "ConverterBenchmarkOutput");
+    return *output;
+  }
+
+  const dd4hep::DDSegmentation::ToySegmentation& converterSegmentation() {
+    static const auto segmentation = ToyBenchmarkGeometry::make(false);
+    return *segmentation;
+  }
+
+  // nHits hits in distinct random cells, at the cell centres, owned by the returned collection
+  template <typename HIT, typename POOLED>
+  std::unique_ptr<Geant4HitCollection> syntheticHits(std::size_t nHits) {
+    const auto& segmentation = converterSegmentation();
+    auto coll = std::make_unique<Geant4HitCollection>("MyToyCalorimeter", "ToyCalorimeterHits", nullptr, (HIT*)nullptr);
+    std::mt19937 engine(11);
+    std::uniform_int_distribution<long> cell(0, segmentation.numberOfCells()-1);
+    std::exponential_distribution<double> energy(1.);
+    while ( coll->GetSize() < nHits ) {
+      const auto cellID = segmentation.cellIDOfIndex(cell(engine));
+      if ( coll->findByKey<HIT>(cellID) ) continue;
+      const auto pos = segmentation.position(cellID);
+      HIT* hit = new POOLED(dd4hep::Position(pos.x(), pos.y(), pos.z()));
+      hit->cellID = cellID;
+      hit->energyDeposit = energy(engine);
+      coll->add(cellID, hit);
+    }
+    return coll;
+  }
+
+  template <typename HIT, typename POOLED, typename COLL>
+  void convert(benchmark::State& state) {
+    auto& output = converterOutput();
+    const auto* converter = Geant4EDM4ToyReadout::converter(typeid(HIT));
+    if ( !converter ) throw std::runtime_error("no converter registered for the benchmarked hit type");
+    auto hits = syntheticHits<HIT, POOLED>(state.range(0));
+    dd4hep::sim::Geant4ParticleMap particles;
+    const std::string name = "ToyCalorimeterHits";
+    for ( auto _ : state ) {
+      (*converter)(output, name, *hits, &particles);
+      state.PauseTiming();
+      benchmark::DoNotOptimize(output.outputCollection<COLL>(name).size());
+      output.outputCollection<COLL>(name).clear();
+      output.outputCollection<edm4hep::CaloHitContributionCollection>(name + "Contributions").clear();
+      state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations()*state.range(0));
+  }
+
+  void BM_ConvertCalorimeterHits(benchmark::State& state) {
+    using Hit = dd4hep::sim::Geant4Calorimeter::Hit;
+    convert<Hit, ToyPooledHit<Hit>, edm4hep::SimCalorimeterHitCollection>(state);
+  }
+  BENCHMARK(BM_ConvertCalorimeterHits)->Arg(1000)->Arg(20000)->Unit(benchmark::kMicrosecond);
+
+  void BM_ConvertToyCaloHits(benchmark::State& state) {
+    convert<ToyCaloHit, ToyCaloHit, edm4toy::SimToyCalorimeterHitCollection>(state);
+  }
+  BENCHMARK(BM_ConvertToyCaloHits)->Arg(1000)->Arg(20000)->Unit(benchmark::kMicrosecond);
+
+}
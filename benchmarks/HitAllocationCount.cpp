@@ -0,0 +1,82 @@
+// Heap allocations per event of the hit bookkeeping in process(): hits created with plain new, as the
+// ToyCalorimeter actions did before the per-thread pools, against the pooled hits they create now
+// (Geant4Calorimeter::Hit through ToyPooledHit, ToyCaloHit through its own pool).
+// Events of ToyBenchmarkSteps go through findOrCreateHit() into a Geant4HitCollection that is deleted at the
+// end of the event, as Geant4 does; every global operator new of the process is counted. Allocations of the
+// collection itself are the same for both and are part of the counts.
+//
+//   HitAllocationCount [events] [steps per event]      (20 and 100000)
+#include "ToyBenchmarkGeometry.h"
+#include "ToyCaloHit.h"
+#include "ToyHitBooking.h"
+#include "ToyHitPool.h"
+#include <DDG4/Geant4Data.h>
+#include <DDG4/Geant4HitCollection.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+namespace {
+  std::size_t g_allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+  ++g_allocations;
+  if ( void* p = std::malloc(size ? size : 1) ) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return ::operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+using namespace ToyCalorimeter;
+using dd4hep::DDSegmentation::ToySegmentation;
+
+namespace {
+
+  // Plain heap hits, the same type without the pooled operator new
+  struct PlainToyCaloHit : ToyCaloHit {
+    using ToyCaloHit::ToyCaloHit;
+    void* operator new(std::size_t size) { return ::operator new(size); }
+    void operator delete(void* hit) { ::operator delete(hit); }
+  };
+
+  template <typename HIT, typename CREATED>
+  void count(const char* name, const ToySegmentation& segmentation, const ToyBenchmarkSteps& steps, int nEvents) {
+    std::size_t first = 0, later = 0, hits = 0;
+    for ( int event = 0; event < nEvents; event++ ) {
+      const std::size_t before = g_allocations;
+      auto* coll = new dd4hep::sim::Geant4HitCollection("MyToyCalorimeter", "ToyCalorimeterHits", nullptr, (HIT*)nullptr);
+      bool created = false;
+      for ( std::size_t i = 0; i < steps.cellID.size(); i++ ) {
+        auto* hit = findOrCreateHit<HIT, CREATED>(coll, segmentation, steps.cellID[i], created);
+        hit->energyDeposit += stepDeposit(steps.edep[i]);
+      }
+      hits = coll->GetSize();
+      delete coll;
+      (event == 0 ? first : later) += g_allocations - before;
+    }
+    std::printf("%-34s %10zu %18zu %26.1f\n", name, hits, first, nEvents > 1 ? double(later)/(nEvents-1) : 0.);
+  }
+
+}
+
+int main(int argc, char** argv) {
+  const int nEvents         = argc > 1 ? std::stoi(argv[1]) : 20;
+  const std::size_t nSteps  = argc > 2 ? std::stoul(argv[2]) : 100000;
+  const auto segmentation   = ToyBenchmarkGeometry::make(false);
+  const ToyBenchmarkSteps steps(*segmentation, nSteps);
+
+  using Hit = dd4hep::sim::Geant4Calorimeter::Hit;
+  std::printf("Heap allocations per event, %d events of %zu steps\n", nEvents, nSteps);
+  std::printf("%-34s %10s %18s %26s\n", "hit type", "hits/event", "allocs first event", "allocs later events (mean)");
+  count<Hit, Hit>("Geant4Calorimeter::Hit, new", *segmentation, steps, nEvents);
+  count<Hit, ToyPooledHit<Hit>>("Geant4Calorimeter::Hit, pooled", *segmentation, steps, nEvents);
+  count<ToyCaloHit, PlainToyCaloHit>("ToyCaloHit, new", *segmentation, steps, nEvents);
+  count<ToyCaloHit, ToyCaloHit>("ToyCaloHit, pooled", *segmentation, steps, nEvents);
+  return 0;
+}
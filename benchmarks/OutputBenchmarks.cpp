@@ -0,0 +1,33 @@
+// commit() of Geant4EDM4ToyReadout: writing an event frame to a local file through ToyFrameWriter, per
+// compression setting. Frames are built outside the timed region.
+#include "ToyBenchmarkFrame.h"
+#include "ToyFrameWriter.h"
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <random>
+
+using namespace ToyCalorimeter;
+
+namespace {
+
+  // Arguments: hits per event, compression (0 ROOT default, 1 ZSTD, 2 LZ4)
+  void BM_FrameCommit(benchmark::State& state) {
+    const char* algorithms[] = {"", "ZSTD", "LZ4"};
+    ToyWriterOptions options;
+    options.compression = algorithms[state.range(1)];
+    const std::string fileName = "ToyCalorimeterBenchmarks.commit.root";
+    auto writer = ToyFrameWriter::create(fileName, options);
+    std::mt19937 engine(5);
+    for ( auto _ : state ) {
+      state.PauseTiming();
+      podio::Frame frame = syntheticFrame(state.range(0), engine);
+      state.ResumeTiming();
+      writer->writeFrame(frame, "events");
+    }
+    writer->finish();
+    std::remove(fileName.c_str());
+    state.SetItemsProcessed(state.iterations()*state.range(0));
+  }
+  BENCHMARK(BM_FrameCommit)->ArgsProduct({{1000, 20000}, {0, 1, 2}})->Unit(benchmark::kMicrosecond);
+
+}
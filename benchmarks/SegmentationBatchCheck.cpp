@@ -0,0 +1,78 @@
+// Checks the batch ToySegmentation::decode() and positions() against the per-cell System/Phi/Theta/Depth and
+// position(), for the position table and the analytic mode. With TOYCALO_ENABLE_AVX2 this compares the vector
+// path with the scalar one; cells outside the table and a batch size that is not a multiple of 4 are included.
+// Analytic mode has no position for cells off its ring: position() must throw for them instead.
+// Run by ctest, exits with 1 on the first mismatch.
+#include "ToyBenchmarkGeometry.h"
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace ToyCalorimeter;
+using dd4hep::DDSegmentation::ToySegmentation;
+
+namespace {
+
+  // Crystals of the geometry and, for the position table, cells outside of it (every field up to its full width)
+  std::vector<unsigned long long> checkIDs(const ToySegmentation& segmentation, std::size_t n) {
+    auto ids = ToyBenchmarkGeometry::cellIDs(segmentation, n);
+    if ( segmentation.isAnalytic() ) return ids;
+    std::mt19937 engine(7);
+    std::uniform_int_distribution<int> any(0, 511);
+    for ( std::size_t i = 0; i < n; i += 5 ) {
+      ids[i] = segmentation.setCellID(ToyBenchmarkGeometry::kSystem, any(engine), any(engine), any(engine));
+    }
+    return ids;
+  }
+
+  bool check(const char* name, const ToySegmentation& segmentation) {
+    const auto ids = checkIDs(segmentation, 4099);
+    const std::size_t n = ids.size();
+    std::vector<int> system(n), phi(n), theta(n), depth(n);
+    std::vector<double> x(n), y(n), z(n);
+    segmentation.decode(ids, system, phi, theta, depth);
+    segmentation.positions(ids, x, y, z);
+    for ( std::size_t i = 0; i < n; i++ ) {
+      const auto id = ids[i];
+      const auto pos = segmentation.position(id);
+      if ( system[i] != segmentation.System(id) || phi[i] != segmentation.Phi(id) ||
+           theta[i] != segmentation.Theta(id) || depth[i] != segmentation.Depth(id) ) {
+        std::cerr << name << ": decode() differs from the scalar decoding for cell " << std::hex << id << std::endl;
+        return false;
+      }
+      if ( x[i] != pos.x() || y[i] != pos.y() || z[i] != pos.z() ) {
+        std::cerr << name << ": positions() differs from position() for cell " << std::hex << id << std::endl;
+        return false;
+      }
+    }
+    std::cout << name << ": " << n << " cells agree" << std::endl;
+    return true;
+  }
+
+  bool checkOffRing(const ToySegmentation& segmentation) {
+    const auto id = segmentation.setCellID(ToyBenchmarkGeometry::kSystem, 0, 1, 0);
+    try {
+      segmentation.position(id);
+    }
+    catch (const std::runtime_error&) {
+      std::cout << "analytic: cell off the ring rejected" << std::endl;
+      return true;
+    }
+    std::cerr << "analytic: position() returned a position for the cell off the ring " << std::hex << id << std::endl;
+    return false;
+  }
+
+}
+
+int main() {
+#if defined(__AVX2__)
+  std::cout << "Batch functions built with AVX2" << std::endl;
+#else
+  std::cout << "Batch functions built without AVX2, checking the scalar path only" << std::endl;
+#endif
+  const auto table    = ToyBenchmarkGeometry::make(false);
+  const auto analytic = ToyBenchmarkGeometry::make(true);
+  const bool ok = check("position table", *table) && check("analytic", *analytic) && checkOffRing(*analytic);
+  return ok ? 0 : 1;
+}
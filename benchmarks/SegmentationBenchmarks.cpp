@@ -0,0 +1,118 @@
+// ToySegmentation: cell ID encoding and decoding, cell positions and the dense cell index
+#include "ToyBenchmarkGeometry.h"
+#include <benchmark/benchmark.h>
+#include <stdexcept>
+
+using namespace ToyCalorimeter;
+using dd4hep::DDSegmentation::ToySegmentation;
+
+namespace {
+
+  constexpr std::size_t kCells = 4096;
+
+  const ToySegmentation& tableSegmentation() {
+    static const auto segmentation = ToyBenchmarkGeometry::make(false);
+    return *segmentation;
+  }
+  const ToySegmentation& analyticSegmentation() {
+    static const auto segmentation = ToyBenchmarkGeometry::make(true);
+    return *segmentation;
+  }
+  const ToySegmentation& genericSegmentation() {
+    static const auto segmentation = ToyBenchmarkGeometry::make(false, ToyBenchmarkGeometry::kGenericEncoding);
+    return *segmentation;
+  }
+
+  // Argument of the encode and decode benchmarks: 0 for the generic BitFieldCoder, 1 for ToyCellIDCoder
+  const ToySegmentation& coderSegmentation(const benchmark::State& state) {
+    const auto& segmentation = state.range(0) ? tableSegmentation() : genericSegmentation();
+    if ( segmentation.hasFixedLayout() != bool(state.range(0)) ) {
+      throw std::logic_error("benchmark segmentation does not use the expected cell ID coder");
+    }
+    return segmentation;
+  }
+
+  void BM_SegmentationEncode(benchmark::State& state) {
+    const auto& segmentation = coderSegmentation(state);
+    int i = 0;
+    for ( auto _ : state ) {
+      const auto id = segmentation.setCellID(ToyBenchmarkGeometry::kSystem, i & 63, (i >> 6) & 127, (i >> 13) & 7);
+      benchmark::DoNotOptimize(id);
+      ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+  BENCHMARK(BM_SegmentationEncode)->Arg(0)->Arg(1);
+
+  void BM_SegmentationDecode(benchmark::State& state) {
+    const auto& segmentation = coderSegmentation(state);
+    const auto ids = ToyBenchmarkGeometry::cellIDs(segmentation, kCells);
+    for ( auto _ : state ) {
+      for ( const auto id : ids ) {
+        benchmark::DoNotOptimize(segmentation.System(id) + segmentation.Phi(id) + segmentation.Theta(id) + segmentation.Depth(id));
+      }
+    }
+    state.SetItemsProcessed(state.iterations()*ids.size());
+  }
+  BENCHMARK(BM_SegmentationDecode)->Arg(0)->Arg(1);
+
+  void BM_SegmentationBatchDecode(benchmark::State& state) {
+    const auto& segmentation = tableSegmentation();
+    const auto ids = ToyBenchmarkGeometry::cellIDs(segmentation, kCells);
+    std::vector<int> system(kCells), phi(kCells), theta(kCells), depth(kCells);
+    for ( auto _ : state ) {
+      segmentation.decode(ids, system, phi, theta, depth);
+      benchmark::DoNotOptimize(depth.data());
+    }
+    state.SetItemsProcessed(state.iterations()*ids.size());
+  }
+  BENCHMARK(BM_SegmentationBatchDecode);
+
+  void BM_SegmentationCellIndex(benchmark::State& state) {
+    const auto& segmentation = tableSegmentation();
+    const auto ids = ToyBenchmarkGeometry::cellIDs(segmentation, kCells);
+    for ( auto _ : state ) {
+      for ( const auto id : ids ) benchmark::DoNotOptimize(segmentation.cellIndex(id));
+    }
+    state.SetItemsProcessed(state.iterations()*ids.size());
+  }
+  BENCHMARK(BM_SegmentationCellIndex);
+
+  // Argument: 0 for the position table, 1 for analytic mode
+  void BM_SegmentationPosition(benchmark::State& state) {
+    const auto& segmentation = state.range(0) ? analyticSegmentation() : tableSegmentation();
+    const auto ids = ToyBenchmarkGeometry::cellIDs(segmentation, kCells);
+    for ( auto _ : state ) {
+      for ( const auto id : ids ) benchmark::DoNotOptimize(segmentation.position(id));
+    }
+    state.SetItemsProcessed(state.iterations()*ids.size());
+  }
+  BENCHMARK(BM_SegmentationPosition)->Arg(0)->Arg(1);
+
+  void BM_SegmentationBatchPositions(benchmark::State& state) {
+    const auto& segmentation = state.range(0) ? analyticSegmentation() : tableSegmentation();
+    const auto ids = ToyBenchmarkGeometry::cellIDs(segmentation, kCells);
+    std::vector<double> x(kCells), y(kCells), z(kCells);
+    for ( auto _ : state ) {
+      segmentation.positions(ids, x, y, z);
+      benchmark::DoNotOptimize(z.data());
+    }
+    state.SetItemsProcessed(state.iterations()*ids.size());
+  }
+  BENCHMARK(BM_SegmentationBatchPositions)->Arg(0)->Arg(1);
+
+  // Cell of a step in analytic mode, as the sensitive actions find it: from the global position alone
+  void BM_SegmentationAnalyticCellID(benchmark::State& state) {
+    const auto& segmentation = analyticSegmentation();
+    std::vector<dd4hep::DDSegmentation::Vector3D> global;
+    for ( int i = 0; i < int(kCells); i++ ) {
+      global.push_back(ToyBenchmarkGeometry::crystalCentre(i & 63, (i >> 6) & 127, (i >> 13) & 7));
+    }
+    for ( auto _ : state ) {
+      for ( const auto& g : global ) benchmark::DoNotOptimize(segmentation.analyticCellID(ToyBenchmarkGeometry::kSystem, g));
+    }
+    state.SetItemsProcessed(state.iterations()*global.size());
+  }
+  BENCHMARK(BM_SegmentationAnalyticCellID);
+
+}
@@ -0,0 +1,62 @@
+// Per-step bookkeeping of the ToyCalorimeter sensitive actions: the hit map of Geant4HitCollection with pooled
+// hits, as process() does by default, against the dense per-cell accumulation of DenseAccumulation = True.
+// Steps hit cells of a few showers repeatedly, like the steps of an electromagnetic shower do.
+// Both run the functions of ToyHitBooking.h that the sensitive actions call; only the Geant4 step itself is missing.
+#include "ToyBenchmarkGeometry.h"
+#include "ToyHitBooking.h"
+#include "ToyHitPool.h"
+#include <DDG4/Geant4Data.h>
+#include <DDG4/Geant4HitCollection.h>
+#include <benchmark/benchmark.h>
+
+using namespace ToyCalorimeter;
+using dd4hep::DDSegmentation::ToySegmentation;
+using Hit       = dd4hep::sim::Geant4Calorimeter::Hit;
+using PooledHit = ToyPooledHit<Hit>;
+
+namespace {
+
+  const ToySegmentation& sensitiveSegmentation() {
+    static const auto segmentation = ToyBenchmarkGeometry::make(false);
+    return *segmentation;
+  }
+
+  void BM_SensitiveHitMap(benchmark::State& state) {
+    const auto& segmentation = sensitiveSegmentation();
+    const ToyBenchmarkSteps steps(segmentation, state.range(0));
+    for ( auto _ : state ) {
+      // One event: the collection owns the hits and returns them to the pool when deleted
+      auto* coll = new dd4hep::sim::Geant4HitCollection("MyToyCalorimeter", "ToyCalorimeterHits", nullptr, (Hit*)nullptr);
+      bool created = false;
+      for ( std::size_t i = 0; i < steps.cellID.size(); i++ ) {
+        auto* hit = findOrCreateHit<Hit, PooledHit>(coll, segmentation, steps.cellID[i], created);
+        hit->energyDeposit += stepDeposit(steps.edep[i]);
+      }
+      benchmark::DoNotOptimize(coll->GetSize());
+      delete coll;
+    }
+    state.SetItemsProcessed(state.iterations()*steps.cellID.size());
+  }
+  BENCHMARK(BM_SensitiveHitMap)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+  void BM_SensitiveDense(benchmark::State& state) {
+    const auto& segmentation = sensitiveSegmentation();
+    const ToyBenchmarkSteps steps(segmentation, state.range(0));
+    ToyCellAccumulator cells;
+    cells.resize(segmentation.numberOfCells());
+    for ( auto _ : state ) {
+      auto* coll = new dd4hep::sim::Geant4HitCollection("MyToyCalorimeter", "ToyCalorimeterHits", nullptr, (Hit*)nullptr);
+      for ( std::size_t i = 0; i < steps.cellID.size(); i++ ) {
+        const auto cellID = steps.cellID[i];
+        cells.add(segmentation.cellIndex(cellID), cellID, stepDeposit(steps.edep[i]), 0.0);
+      }
+      // end(): one hit per touched cell
+      createDenseHits<Hit, PooledHit>(cells, segmentation, coll, [](const ToyCellAccumulator::Cell&, Hit*) {});
+      benchmark::DoNotOptimize(coll->GetSize());
+      delete coll;
+    }
+    state.SetItemsProcessed(state.iterations()*steps.cellID.size());
+  }
+  BENCHMARK(BM_SensitiveDense)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+}
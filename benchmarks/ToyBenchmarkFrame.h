@@ -0,0 +1,47 @@
+#ifndef ToyBenchmarkFrame_h
+#define ToyBenchmarkFrame_h 1
+#include <edm4hep/CaloHitContributionCollection.h>
+#include <edm4hep/MCParticleCollection.h>
+#include <edm4hep/SimCalorimeterHitCollection.h>
+#include <podio/Frame.h>
+
+#include <random>
+
+namespace ToyCalorimeter {
+
+  // Event frame as Geant4EDM4ToyReadout writes it: 100 MC particles, nHits calorimeter hits with two
+  // contributions each
+  inline podio::Frame syntheticFrame(std::size_t nHits, std::mt19937& engine) {
+    std::uniform_real_distribution<float> flat(0.f, 1.f);
+    edm4hep::MCParticleCollection particles;
+    for ( int i = 0; i < 100; i++ ) {
+      auto p = particles.create();
+      p.setPDG(i % 2 ? 22 : 11);
+      p.setMomentum({flat(engine), flat(engine), 10*flat(engine)});
+    }
+    edm4hep::SimCalorimeterHitCollection hits;
+    edm4hep::CaloHitContributionCollection contributions;
+    for ( std::size_t i = 0; i < nHits; i++ ) {
+      auto hit = hits.create();
+      hit.setCellID(0x4000000ULL + i);
+      hit.setEnergy(flat(engine));
+      hit.setPosition({2250*flat(engine), 2250*flat(engine), 1000*flat(engine)});
+      for ( int c = 0; c < 2; c++ ) {
+        auto contribution = contributions.create();
+        contribution.setPDG(11);
+        contribution.setEnergy(flat(engine));
+        contribution.setTime(flat(engine));
+        contribution.setParticle(particles[(i + c) % particles.size()]);
+        hit.addToContributions(contribution);
+      }
+    }
+    podio::Frame frame;
+    frame.put(std::move(particles), "MCParticles");
+    frame.put(std::move(hits), "ToyCalorimeterHits");
+    frame.put(std::move(contributions), "ToyCalorimeterHitsContributions");
+    return frame;
+  }
+
+}
+
+#endif
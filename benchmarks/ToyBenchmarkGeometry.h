@@ -0,0 +1,89 @@
+#ifndef ToyBenchmarkGeometry_h
+#define ToyBenchmarkGeometry_h 1
+#include "ToySegmentation.h"
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace ToyCalorimeter {
+
+  // Barrel of the size of compact/ToyCalorimeter.xml, built without the geometry: nPhi x nTheta x nDepth
+  // crystals with saved positions, or the analytic mode of the segmentation
+  struct ToyBenchmarkGeometry {
+    static constexpr int    kSystem = 4;
+    static constexpr int    kNPhi   = 64;
+    static constexpr int    kNTheta = 128;
+    static constexpr int    kNDepth = 8;
+    static constexpr double kInnerR = 2250.;
+    static constexpr double kDepth  = 25.;
+
+    // The readout <id> of compact/ToyCalorimeter.xml, decoded by ToyCellIDCoder, and the same fields in another
+    // order, which ToySegmentation decodes with the generic BitFieldCoder
+    static constexpr const char* kEncoding        = "system:5,phi:9,theta:9,depth:9";
+    static constexpr const char* kGenericEncoding = "phi:9,system:5,theta:9,depth:9";
+
+    static std::unique_ptr<dd4hep::DDSegmentation::ToySegmentation> make(bool analytic, const char* encoding = kEncoding) {
+      using namespace dd4hep::DDSegmentation;
+      auto segmentation = std::make_unique<ToySegmentation>(encoding);
+      if ( analytic ) {
+        segmentation->setParameterValue("phi_segments", std::to_string(kNPhi));
+        segmentation->setParameterValue("barrel_inner_r", std::to_string(kInnerR));
+        segmentation->setParameterValue("barrel_outer_r", std::to_string(kInnerR + kNDepth*kDepth));
+      }
+      else {
+        for ( int depth = 0; depth < kNDepth; depth++ ) {
+          for ( int theta = 0; theta < kNTheta; theta++ ) {
+            for ( int phi = 0; phi < kNPhi; phi++ ) {
+              const VolumeID vID = segmentation->setVolumeID(kSystem, phi, theta, depth);
+              segmentation->savePosition(segmentation->getFirst32bits(vID), crystalCentre(phi, theta, depth));
+            }
+          }
+        }
+      }
+      segmentation->freezePositions();
+      return segmentation;
+    }
+
+    static dd4hep::DDSegmentation::Vector3D crystalCentre(int phi, int theta, int depth) {
+      const double r  = kInnerR + (depth + 0.5)*kDepth;
+      const double p  = 2*M_PI*phi/kNPhi;
+      const double th = M_PI*(theta + 0.5)/kNTheta;
+      return dd4hep::DDSegmentation::Vector3D(r*std::cos(p), r*std::sin(p), r/std::tan(th));
+    }
+
+    // Random cell IDs of existing crystals: the analytic barrel is the single ring at theta = depth = 0
+    static std::vector<unsigned long long> cellIDs(const dd4hep::DDSegmentation::ToySegmentation& segmentation,
+                                                   std::size_t n, unsigned seed = 1) {
+      const bool ring = segmentation.isAnalytic();
+      std::mt19937 engine(seed);
+      std::uniform_int_distribution<int> phi(0, kNPhi-1), theta(0, ring ? 0 : kNTheta-1), depth(0, ring ? 0 : kNDepth-1);
+      std::vector<unsigned long long> ids(n);
+      for ( auto& id : ids ) id = segmentation.setCellID(kSystem, phi(engine), theta(engine), depth(engine));
+      return ids;
+    }
+  };
+
+  // nSteps steps in 10 showers of about 5x5x8 crystals, 10 steps per touched cell on average
+  struct ToyBenchmarkSteps {
+    std::vector<unsigned long long> cellID;
+    std::vector<double>             edep;
+
+    ToyBenchmarkSteps(const dd4hep::DDSegmentation::ToySegmentation& segmentation, std::size_t nSteps, unsigned seed = 3) {
+      std::mt19937 engine(seed);
+      std::uniform_int_distribution<int> centre(0, 1000), spread(-2, 2), depth(0, ToyBenchmarkGeometry::kNDepth-1);
+      std::exponential_distribution<double> energy(1.);
+      for ( std::size_t i = 0; i < nSteps; i++ ) {
+        const int shower = i % 10;
+        const int phi    = (shower*6 + spread(engine) + ToyBenchmarkGeometry::kNPhi) % ToyBenchmarkGeometry::kNPhi;
+        const int theta  = 10 + shower*10 + spread(engine);
+        cellID.push_back(segmentation.setCellID(ToyBenchmarkGeometry::kSystem, phi, theta, depth(engine)));
+        edep.push_back(energy(engine));
+      }
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,116 @@
+// Events per second of the Geant4EDM4ToyReadout output against the number of worker threads. Every worker
+// builds event frames and writes them either through one ToyFrameWriter under a global mutex, as commit() of
+// the shared output does, or through the queue of ToyAsyncFrameWriter (AsyncWriter = True). --work spends the
+// given milliseconds per event on each worker before its frame is built, in place of the simulation. The time
+// includes finishing the file, so the async writer is measured until its queue is drained.
+//
+//   WriterScaling [--threads 1,2,4,8] [--events N] [--hits N] [--work MS] [--queue N] [--compression ALG]
+#include "ToyAsyncFrameWriter.h"
+#include "ToyBenchmarkFrame.h"
+#include "ToyFrameWriter.h"
+#include "ToyToolSupport.h"
+#include <TROOT.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ToyCalorimeter;
+
+namespace {
+
+  struct Settings {
+    unsigned         events      {400};
+    std::size_t      hits        {20000};
+    double           workMs      {0.};
+    std::size_t      queueDepth  {16};
+    ToyWriterOptions options;
+  };
+
+  void simulate(double ms) {
+    const auto end = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(ms);
+    while ( std::chrono::steady_clock::now() < end ) {}
+  }
+
+  // Runs nThreads workers over the events, write(frame) hands a frame to the output. Returns seconds.
+  template <typename WRITE, typename FINISH>
+  double run(unsigned nThreads, const Settings& settings, WRITE&& write, FINISH&& finish) {
+    std::atomic<unsigned> next {0};
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for ( unsigned t = 0; t < nThreads; t++ ) {
+      workers.emplace_back([&, t]() {
+        std::mt19937 engine(t);
+        while ( next++ < settings.events ) {
+          simulate(settings.workMs);
+          write(syntheticFrame(settings.hits, engine));
+        }
+      });
+    }
+    for ( auto& worker : workers ) worker.join();
+    finish();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  double runMutex(unsigned nThreads, const Settings& settings) {
+    const std::string fileName = "WriterScaling.mutex.root";
+    auto writer = ToyFrameWriter::create(fileName, settings.options);
+    std::mutex lock;
+    const double seconds = run(nThreads, settings,
+      [&](podio::Frame&& frame) {
+        std::lock_guard<std::mutex> guard(lock);
+        writer->writeFrame(frame, "events");
+      },
+      [&]() { writer->finish(); });
+    std::remove(fileName.c_str());
+    return seconds;
+  }
+
+  double runAsync(unsigned nThreads, const Settings& settings) {
+    const std::string fileName = "WriterScaling.async.root";
+    auto writer = ToyAsyncFrameWriter::acquire(fileName, settings.queueDepth, settings.options);
+    const double seconds = run(nThreads, settings,
+      [&](podio::Frame&& frame) { writer->push(std::move(frame), "events"); },
+      [&]() { writer.reset(); });
+    std::remove(fileName.c_str());
+    return seconds;
+  }
+
+}
+
+int main(int argc, char** argv) {
+  Settings settings;
+  std::vector<unsigned> threads = {1, 2, 4, 8};
+  ToyCommandLine cmd(argc, argv,
+    "WriterScaling [--threads 1,2,4,8] [--events N] [--hits N] [--work MS] [--queue N] [--compression ALG]");
+  while ( cmd.next() ) {
+    const std::string& arg = cmd.arg();
+    if      ( arg == "--threads" )     {
+      threads.clear();
+      std::stringstream list(cmd.value());
+      for ( std::string n; std::getline(list, n, ','); ) threads.push_back(std::max(1, std::stoi(n)));
+    }
+    else if ( arg == "--events" )      settings.events              = std::stoul(cmd.value());
+    else if ( arg == "--hits" )        settings.hits                = std::stoul(cmd.value());
+    else if ( arg == "--work" )        settings.workMs              = std::stod(cmd.value());
+    else if ( arg == "--queue" )       settings.queueDepth          = std::stoul(cmd.value());
+    else if ( arg == "--compression" ) settings.options.compression = cmd.value();
+    else                               return cmd.usage();
+  }
+
+  ROOT::EnableThreadSafety();
+  std::printf("%u events of %zu hits, %.1f ms of work per event, queue depth %zu\n",
+              settings.events, settings.hits, settings.workMs, settings.queueDepth);
+  std::printf("%8s %18s %18s\n", "threads", "mutex [events/s]", "async [events/s]");
+  for ( unsigned n : threads ) {
+    const double mutex = runMutex(n, settings);
+    const double async = runAsync(n, settings);
+    std::printf("%8u %18.1f %18.1f\n", n, settings.events/mutex, settings.events/async);
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Compare a ToyCalorimeterBenchmarks JSON result with a stored baseline.
+
+    compare_benchmarks.py baseline.json current.json [--threshold 0.10] [--metric cpu_time]
+    compare_benchmarks.py --update baseline.json current.json
+
+Benchmarks slower than the baseline by more than the threshold are flagged and make the script exit with 1.
+With repetitions the median aggregate is compared, otherwise the single run. --update copies the current
+result to the baseline.
+"""
+import argparse
+import json
+import shutil
+import sys
+
+TO_NS = {'ns': 1., 'us': 1e3, 'ms': 1e6, 's': 1e9}
+
+
+def load(path, metric):
+    # {benchmark name: time in ns}
+    with open(path) as f:
+        data = json.load(f)
+    times, medians = {}, {}
+    for bm in data.get('benchmarks', []):
+        if bm.get('error_occurred'):
+            continue
+        value = bm[metric] * TO_NS[bm.get('time_unit', 'ns')]
+        if bm.get('run_type') == 'aggregate':
+            if bm.get('aggregate_name') == 'median':
+                medians[bm['run_name']] = value
+        else:
+            times.setdefault(bm.get('run_name', bm['name']), value)
+    times.update(medians)
+    return times, data.get('context', {})
+
+
+def format_time(ns):
+    for unit, scale in (('s', 1e9), ('ms', 1e6), ('us', 1e3)):
+        if ns >= scale:
+            return f"{ns/scale:.3g} {unit}"
+    return f"{ns:.3g} ns"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('baseline')
+    parser.add_argument('current')
+    parser.add_argument('--threshold', type=float, default=0.10, help='allowed relative slowdown (default 0.10)')
+    parser.add_argument('--metric', choices=['cpu_time', 'real_time'], default='cpu_time')
+    parser.add_argument('--update', action='store_true', help='store the current result as the new baseline')
+    args = parser.parse_args()
+
+    if args.update:
+        shutil.copyfile(args.current, args.baseline)
+        print(f"Stored {args.current} as baseline {args.baseline}")
+        return 0
+
+    try:
+        baseline, base_context = load(args.baseline, args.metric)
+    except FileNotFoundError:
+        print(f"No baseline {args.baseline}, store one with --update", file=sys.stderr)
+        return 2
+    current, context = load(args.current, args.metric)
+    if base_context.get('host_name') != context.get('host_name'):
+        print(f"Note: baseline from {base_context.get('host_name')}, current run on {context.get('host_name')}")
+
+    regressions = []
+    width = max((len(name) for name in current), default=10)
+    print(f"{'benchmark':<{width}}  {'baseline':>10}  {'current':>10}  {'change':>8}")
+    for name, time in current.items():
+        if name not in baseline:
+            print(f"{name:<{width}}  {'-':>10}  {format_time(time):>10}  {'new':>8}")
+            continue
+        change = time/baseline[name] - 1.
+        flag = ''
+        if change > args.threshold:
+            flag = '  REGRESSION'
+            regressions.append(name)
+        print(f"{name:<{width}}  {format_time(baseline[name]):>10}  {format_time(time):>10}  {change:+8.1%}{flag}")
+    for name in baseline.keys() - current.keys():
+        print(f"{name:<{width}}  {format_time(baseline[name]):>10}  {'-':>10}  {'missing':>8}")
+
+    if regressions:
+        print(f"\n{len(regressions)} benchmark(s) slower than the baseline by more than {args.threshold:.0%}")
+        return 1
+    print(f"\nNo regressions above {args.threshold:.0%}")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
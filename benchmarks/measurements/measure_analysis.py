@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Event rate of ToyCaloAnalysis against the PyROOT loop of eventdisplay.py.
+
+One sample (fixed seed, 10 GeV e- into the barrel by default) is simulated with ddsim. ToyCaloAnalysis runs over
+it with each thread count and prints its own rate, which leaves out the start-up. The Python path is
+DetPlot.loadHitsForEvent with the MCParticles and calorimeter hits of the notebook and every MC particle kept
+(maxMC = -1, the analysis matches all of them), timed in this process over the first --python-events events
+after the import. It only builds the hit and particle objects and fills no histograms, so the ratio is a
+lower bound of the speed-up over a full Python analysis. eventdisplay.py needs plotly.
+
+    measure_analysis.py [--build DIR] [--events N] [--python-events N] [--threads 1,2,4,8]
+                        [--particle e-] [--momentum GeV] [--collection ToyCalorimeterHits]
+                        [--workdir DIR] [--json FILE]
+"""
+import os
+import re
+import sys
+import time
+import toymeasure
+
+
+def pythonRate(sample, collection, nEvents):
+    """Events per second of DetPlot.loadHitsForEvent over the first nEvents events."""
+    display = os.path.join(toymeasure.SOURCE_DIR, 'eventdisplay')
+    sys.path.insert(0, display)
+    import eventdisplay as evd
+    cwd = os.getcwd()
+    os.chdir(display)   # DetPlot reads ./PDG_IDs.txt
+    try:
+        detplot = evd.DetPlot(os.path.abspath(os.path.join(cwd, sample)), -1,
+                              {'MCParticles': {'type': 'MCParticle'}, collection: {'type': 'SimCalorimeterHit'}},
+                              {})
+        start = time.perf_counter()
+        for i in range(nEvents):
+            detplot.loadHitsForEvent(i)
+        return nEvents/(time.perf_counter() - start)
+    finally:
+        os.chdir(cwd)
+
+
+def main():
+    parser = toymeasure.arguments(__doc__.splitlines()[0], events=200)
+    parser.add_argument('--build', help='build directory with ToyCaloAnalysis (default: from PATH)')
+    parser.add_argument('--python-events', type=int, default=20, help='events of the Python loop (%(default)s)')
+    parser.add_argument('--threads', default='1,2,4,8', help='thread counts of ToyCaloAnalysis (%(default)s)')
+    parser.add_argument('--particle', default='e-', help='particle gun (%(default)s)')
+    parser.add_argument('--momentum', type=float, default=10., help='momentum in GeV (%(default)s)')
+    parser.add_argument('--collection', default='ToyCalorimeterHits', help='hit collection (%(default)s)')
+    args = parser.parse_args()
+    os.makedirs(args.workdir, exist_ok=True)
+
+    sample = os.path.join(args.workdir, 'analysis_sample.root')
+    toymeasure.ddsim(sample, args.events, {'particle': args.particle, 'momentum': args.momentum})
+
+    analysis = toymeasure.tool(args.build, 'ToyCaloAnalysis')
+    python = pythonRate(sample, args.collection, min(args.python_events, args.events))
+    rows = [{'analysis': 'eventdisplay.py loadHitsForEvent', 'threads': 1, 'events/s': python, 'ratio': 1.}]
+    for threads in args.threads.split(','):
+        log = os.path.join(args.workdir, f'analysis_{threads}.log')
+        _, memory = toymeasure.run([analysis, '-o', os.path.join(args.workdir, f'analysis_{threads}.root'),
+                                    '--collection', args.collection, '--threads', threads, sample], log)
+        with open(log) as f:
+            rate = re.search(r'\(([0-9.eE+-]+) events/s\)', f.read())
+        if not rate:
+            sys.exit(f"no event rate in {log}")
+        rows.append({'analysis': 'ToyCaloAnalysis', 'threads': int(threads), 'events/s': float(rate.group(1)),
+                     'ratio': float(rate.group(1))/python, 'peak RSS [MB]': memory})
+
+    print(f"\n{args.events} events of {args.momentum} GeV {args.particle}, {args.collection}")
+    toymeasure.report(['analysis', 'threads', 'events/s', 'ratio', 'peak RSS [MB]'], rows, args.json)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Size of the ToyCalorimeter hit collection with full and compact Geant4EDM4ToyReadout hits.
+
+The same sample (fixed seed, 10 GeV e- into the barrel by default) is simulated with SimToyCalorimeterHit and
+with CompactHits, alone and with the EnergyThreshold and EnergyMantissaBits given on the command line. The
+compressed and uncompressed bytes of the branches of the hit collection in the events tree are compared to
+the full hits; the reduction is expected above 2. The cell position table that compact hits add to the
+metadata tree is listed separately, together with the hits per event that were kept.
+
+    measure_compact_hits.py [--events N] [--particle e-] [--momentum GeV] [--threshold keV] [--bits N]
+                            [--collection ToyCalorimeterHits] [--workdir DIR] [--json FILE]
+"""
+import os
+import toymeasure
+
+
+def branchBytes(path, tree, accept):
+    """(compressed, uncompressed, entries) of the branches of tree that accept(name)."""
+    import ROOT
+    f = ROOT.TFile.Open(path)
+    t = f.Get(tree)
+    zipped, total = 0, 0
+    for branch in t.GetListOfBranches():
+        if accept(branch.GetName()):
+            zipped += branch.GetZipBytes('*')
+            total  += branch.GetTotBytes('*')
+    entries = t.GetEntries()
+    f.Close()
+    return zipped, total, entries
+
+
+def hitsPerEvent(path, collection):
+    from podio.root_io import Reader
+    hits, events = 0, 0
+    for frame in Reader(path).get('events'):
+        hits += len(frame.get(collection))
+        events += 1
+    return hits/max(events, 1)
+
+
+def main():
+    parser = toymeasure.arguments(__doc__.splitlines()[0], events=100)
+    parser.add_argument('--particle', default='e-', help='particle gun (%(default)s)')
+    parser.add_argument('--momentum', type=float, default=10., help='momentum in GeV (%(default)s)')
+    parser.add_argument('--threshold', type=float, default=10., help='EnergyThreshold in keV (%(default)s)')
+    parser.add_argument('--bits', type=int, default=10, help='EnergyMantissaBits (%(default)s)')
+    parser.add_argument('--collection', default='ToyCalorimeterHits', help='hit collection (%(default)s)')
+    args = parser.parse_args()
+    os.makedirs(args.workdir, exist_ok=True)
+
+    threshold = args.threshold*1.e-3   # keV in MeV, the Geant4 energy unit of the property
+    variants = [('full',                   {}),
+                ('compact',                {'CompactHits': True}),
+                ('compact+threshold',      {'CompactHits': True, 'EnergyThreshold': threshold}),
+                ('compact+threshold+bits', {'CompactHits': True, 'EnergyThreshold': threshold,
+                                            'EnergyMantissaBits': args.bits})]
+    # The collection branch and its vector member and relation branches (_<collection>_...), not the
+    # collections whose names only start with it
+    inCollection = lambda name: name == args.collection or name.startswith('_' + args.collection + '_')
+    rows = []
+    for name, properties in variants:
+        output = os.path.join(args.workdir, f'compact_hits_{name.replace("+", "_")}.root')
+        toymeasure.ddsim(output, args.events, {'particle': args.particle, 'momentum': args.momentum,
+                                               'outputProperties': properties})
+        zipped, total, entries = branchBytes(output, 'events', inCollection)
+        metadata, _, _ = branchBytes(output, 'metadata', lambda branch: True)
+        rows.append({'hits': name, 'hits/event': hitsPerEvent(output, args.collection),
+                     'compressed [kB/event]': zipped/1.e3/max(entries, 1),
+                     'uncompressed [kB/event]': total/1.e3/max(entries, 1),
+                     'metadata [kB]': metadata/1.e3, 'file [MB]': os.path.getsize(output)/1.e6})
+        print(f"{name}: done", flush=True)
+
+    for row in rows:
+        for column in ('compressed', 'uncompressed'):
+            key = f'{column} [kB/event]'
+            if row[key] > 0:
+                row[f'{column} reduction'] = rows[0][key]/row[key]
+    print(f"\n{args.events} events of {args.momentum} GeV {args.particle}, {args.collection}, "
+          f"threshold {args.threshold} keV, {args.bits} mantissa bits")
+    toymeasure.report(['hits', 'hits/event', 'compressed [kB/event]', 'compressed reduction',
+                       'uncompressed [kB/event]', 'uncompressed reduction', 'metadata [kB]', 'file [MB]'],
+                      rows, args.json)
+
+
+if __name__ == '__main__':
+    main()
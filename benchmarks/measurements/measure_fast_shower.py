@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Event throughput of full Geant4 showering against the parametrized ToyEMShowerModel.
+
+The same particle gun (10 GeV e- into the barrel by default) is simulated with full showers and with
+setupToyFastShower of toycalo_steering.py, with optical physics only if --optical is given (then
+setupCerenkovScint against setupCerenkovScintFastShower; the optical photons are not parametrized). A one-event
+run of each setup is subtracted, so events/s is the rate of the event loop without start-up. The mean
+calorimeter energy per event is printed to check that both deposit the same energy.
+
+    measure_fast_shower.py [--events N] [--particle e-] [--momentum GeV] [--action ToyCalorimeter_SDAction]
+                           [--optical] [--workdir DIR] [--json FILE]
+"""
+import os
+import toymeasure
+
+
+def meanEnergy(path, collection='ToyCalorimeterHits'):
+    from podio.root_io import Reader
+    total, events = 0., 0
+    for frame in Reader(path).get('events'):
+        total += sum(hit.getEnergy() for hit in frame.get(collection))
+        events += 1
+    return total/max(events, 1)
+
+
+def main():
+    parser = toymeasure.arguments(__doc__.splitlines()[0])
+    parser.add_argument('--particle', default='e-', help='particle gun (%(default)s)')
+    parser.add_argument('--momentum', type=float, default=10., help='momentum in GeV (%(default)s)')
+    parser.add_argument('--action', default='ToyCalorimeter_SDAction',
+                        help='SD action, ToyCalorimeter_SDAction or ToyCalorimeter_SDAction_Custom (%(default)s)')
+    parser.add_argument('--optical', action='store_true', help='with Cerenkov and scintillation photons')
+    args = parser.parse_args()
+    os.makedirs(args.workdir, exist_ok=True)
+
+    setups = {'full': 'setupCerenkovScint' if args.optical else 'none',
+              'fast': 'setupCerenkovScintFastShower' if args.optical else 'setupToyFastShower'}
+    rows = []
+    for name, physics in setups.items():
+        variant = {'action': args.action, 'physics': physics, 'particle': args.particle, 'momentum': args.momentum}
+        startup, _ = toymeasure.ddsim(os.path.join(args.workdir, f'shower_{name}_1.root'), 1, variant)
+        output = os.path.join(args.workdir, f'shower_{name}.root')
+        wall, memory = toymeasure.ddsim(output, args.events, variant)
+        loop = wall - startup
+        rows.append({'showers': name, 'physics': physics, 'event loop [s]': loop,
+                     'events/s': (args.events - 1)/loop if loop > 0 else None,
+                     'peak RSS [MB]': memory, 'calo energy/event [GeV]': meanEnergy(output)})
+        print(f"{name}: done", flush=True)
+
+    if rows[0]['events/s'] and rows[1]['events/s']:
+        rows[1]['speed-up'] = rows[1]['events/s']/rows[0]['events/s']
+    print(f"\n{args.events} events of {args.momentum} GeV {args.particle}, {args.action}")
+    toymeasure.report(['showers', 'physics', 'event loop [s]', 'events/s', 'speed-up', 'peak RSS [MB]',
+                       'calo energy/event [GeV]'], rows, args.json)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Parametrized optical photons of ToyCalorimeter_SDAction_Custom against Geant4 scintillation.
+
+Both runs use setupCerenkovScint and the same particle gun (10 GeV e- into the barrel by default, fixed seed).
+The full run tracks every optical photon. The parametrized run kills them at creation with
+ToyOpticalPhotonKiller (CountPhotons) and sums edep x SCINTILLATIONYIELD into yourInterestingQuantity, with a
+collection efficiency of 1. The killer counts, per creator process, the photons Geant4 generated in the same
+events, so the summed yourInterestingQuantity is compared with the Scintillation count; the ratio is expected
+at 1 within the statistical error of the count. The Cerenkov photons, which the parametrization leaves out,
+are listed alongside.
+
+The toy geometry has no photodetector, so the light collection is not validated: CollectionEfficiency has to
+be filled from a detector that has one. A one-event run of each setup is subtracted from the timings, and the
+mean calorimeter energy shows that killing the photons leaves the deposits unchanged.
+
+    measure_optical.py [--events N] [--particle e-] [--momentum GeV] [--workdir DIR] [--json FILE]
+"""
+import math
+import os
+import re
+import sys
+import toymeasure
+
+KILLED = re.compile(r'Killed (\d+) optical photons created by (\S+)')
+
+
+def eventSums(path):
+    """Mean calorimeter energy in GeV and mean yourInterestingQuantity per event."""
+    from podio.root_io import Reader
+    energy, interesting, events = 0., 0., 0
+    for frame in Reader(path).get('events'):
+        energy += sum(hit.getEnergy() for hit in frame.get('ToyCalorimeterHits'))
+        interesting += sum(hit.getYourInterestingQuantity() for hit in frame.get('ToyCalorimeterHitsInteresting'))
+        events += 1
+    return energy/max(events, 1), interesting/max(events, 1)
+
+
+def killedPhotons(log):
+    """Photons killed by ToyOpticalPhotonKiller per creator process, summed over the threads."""
+    killed = {}
+    with open(log) as f:
+        for match in KILLED.finditer(f.read()):
+            killed[match.group(2)] = killed.get(match.group(2), 0) + int(match.group(1))
+    return killed
+
+
+def main():
+    parser = toymeasure.arguments(__doc__.splitlines()[0])
+    parser.add_argument('--particle', default='e-', help='particle gun (%(default)s)')
+    parser.add_argument('--momentum', type=float, default=10., help='momentum in GeV (%(default)s)')
+    args = parser.parse_args()
+    os.makedirs(args.workdir, exist_ok=True)
+
+    gun = {'particle': args.particle, 'momentum': args.momentum, 'physics': 'setupCerenkovScint',
+           'action': 'ToyCalorimeter_SDAction_Custom'}
+    setups = {'full': gun,
+              'parametrized': dict(gun, actionProperties={'ParametrizedPhotons': True, 'CollectionEfficiency': [1.0]},
+                                   stack=[{'name': 'ToyOpticalPhotonKiller/OpticalPhotonKiller',
+                                           'parameter': {'CountPhotons': True}}])}
+    rows = []
+    for name, variant in setups.items():
+        startup, _ = toymeasure.ddsim(os.path.join(args.workdir, f'optical_{name}_1.root'), 1, variant)
+        output = os.path.join(args.workdir, f'optical_{name}.root')
+        wall, memory = toymeasure.ddsim(output, args.events, variant)
+        loop = wall - startup
+        energy, interesting = eventSums(output)
+        rows.append({'photons': name, 'event loop [s]': loop,
+                     'events/s': (args.events - 1)/loop if loop > 0 else None,
+                     'peak RSS [MB]': memory, 'calo energy/event [GeV]': energy})
+        if 'stack' in variant:
+            log = os.path.splitext(output)[0] + '.log'
+            killed = killedPhotons(log)
+            if 'Scintillation' not in killed:
+                sys.exit(f"no scintillation photons counted in {log}")
+            scintillation = killed['Scintillation']
+            rows[-1].update({'Geant4 scint./event': scintillation/args.events,
+                             'Geant4 Cerenkov/event': killed.get('Cerenkov', 0)/args.events,
+                             'parametrized/event': interesting,
+                             'ratio': interesting*args.events/scintillation,
+                             'stat. error': interesting*args.events/scintillation/math.sqrt(scintillation)})
+        print(f"{name}: done", flush=True)
+
+    if rows[0]['events/s'] and rows[1]['events/s']:
+        rows[1]['speed-up'] = rows[1]['events/s']/rows[0]['events/s']
+    print(f"\n{args.events} events of {args.momentum} GeV {args.particle}, ToyCalorimeter_SDAction_Custom")
+    toymeasure.report(['photons', 'event loop [s]', 'events/s', 'speed-up', 'peak RSS [MB]', 'calo energy/event [GeV]',
+                       'Geant4 scint./event', 'Geant4 Cerenkov/event', 'parametrized/event', 'ratio', 'stat. error'],
+                      rows, args.json)
+
+
+if __name__ == '__main__':
+    main()
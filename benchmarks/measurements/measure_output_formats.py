@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Write and read throughput and file size of the Geant4EDM4ToyReadout backends and compression settings.
+
+A standard sample (10 GeV e- into the barrel by default, fixed seed, the custom output with its default
+settings) is simulated once with ddsim. ToyIOBenchmark then writes its events again with every combination of
+backend, compression and flush size and reads each file back, so the numbers contain no simulation. RNTuple
+is written once with the podio defaults (algo "default"), its writer takes no compression or flush size. RNTuple
+rows only appear if the build has TOYCALO_USE_RNTUPLE; otherwise ToyIOBenchmark reports that the backend is
+not available and skips it.
+
+    measure_output_formats.py [--build DIR] [--events N] [--particle e-] [--momentum GeV]
+                              [--backends TTree,RNTuple] [--compression ZSTD:5,...] [--flush 0,...]
+                              [--workdir DIR] [--json FILE]
+"""
+import os
+import toymeasure
+
+COLUMNS = ['backend', 'algo', 'flush', 'size [MB]', 'write [ev/s]', 'write [MB/s]', 'read [ev/s]']
+
+
+def main():
+    parser = toymeasure.arguments(__doc__.splitlines()[0], events=200)
+    parser.add_argument('--build', help='build directory with ToyIOBenchmark (default: from PATH)')
+    parser.add_argument('--particle', default='e-', help='particle gun (%(default)s)')
+    parser.add_argument('--momentum', type=float, default=10., help='momentum in GeV (%(default)s)')
+    parser.add_argument('--backends', default='TTree,RNTuple', help='%(default)s')
+    parser.add_argument('--compression', default='ZSTD:1,ZSTD:5,LZ4:4,LZMA:7,ZLIB:1', help='%(default)s')
+    parser.add_argument('--flush', default='0,4000000,32000000', help='TTree flush sizes in bytes (%(default)s)')
+    args = parser.parse_args()
+    os.makedirs(args.workdir, exist_ok=True)
+
+    sample = os.path.join(args.workdir, 'output_formats_sample.root')
+    toymeasure.ddsim(sample, args.events, {'particle': args.particle, 'momentum': args.momentum})
+
+    log = os.path.join(args.workdir, 'output_formats.log')
+    toymeasure.run([toymeasure.tool(args.build, 'ToyIOBenchmark'), '--backends', args.backends,
+                    '--compression', args.compression, '--flush', args.flush, '--dir', args.workdir, sample], log)
+
+    rows = []
+    with open(log) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == len(COLUMNS) and fields[0] in ('TTree', 'RNTuple'):
+                rows.append(dict(zip(COLUMNS, fields[:3] + [float(v) for v in fields[3:]])))
+            elif line.strip():
+                print(line.rstrip())
+    print(f"\n{args.events} events of {args.momentum} GeV {args.particle}")
+    toymeasure.report(COLUMNS, rows, args.json)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Explicit crystal placements against the parameterised phi ring (placement="param" in the <dim> element).
+
+Three geometries of the same ring are simulated:
+  explicit   one placement per crystal, positions saved in the ToySegmentation table (the default compact file)
+  analytic   one placement per crystal, positions computed by the analytic ToySegmentation
+  param      one parameterised placement for the ring, analytic ToySegmentation
+For each, a one-event run measures the start-up (geometry construction, conversion to Geant4, physics
+initialisation) and its peak resident memory; a run with --events events measures the event loop. The
+calorimeter steps come from the HotPathCounters of ToyCalorimeter_SDAction, so steps/s counts the steps in the
+crystals per second of event loop.
+
+    measure_placement.py [--events N] [--phi-segments N --box-half MM] [--workdir DIR] [--json FILE]
+
+The ring has 64 crystals of 20 cm by default. More crystals need smaller ones to fit into the ring, e.g.
+--phi-segments 512 --box-half 12 (the phi field of the readout holds at most 512).
+"""
+import os
+import toymeasure
+
+
+def main():
+    parser = toymeasure.arguments(__doc__.splitlines()[0])
+    parser.add_argument('--phi-segments', type=int, default=64, help='crystals in the ring (%(default)s)')
+    parser.add_argument('--box-half', type=float, help='crystal half length in mm (100 unless given)')
+    args = parser.parse_args()
+    os.makedirs(args.workdir, exist_ok=True)
+
+    ring = [(r'phiSegments="64"', f'phiSegments="{args.phi_segments}"')]
+    if args.box_half:
+        ring += [(r'boxHalfX="10\*cm"', f'boxHalfX="{args.box_half}*mm"'),
+                 (r'boxHalfY="10\*cm"', f'boxHalfY="{args.box_half}*mm"'),
+                 (r'boxHalfZ="10\*cm"', f'boxHalfZ="{args.box_half}*mm"')]
+    analytic = [(r'<segmentation type="ToySegmentation"/>',
+                 f'<segmentation type="ToySegmentation" phi_segments="{args.phi_segments}" '
+                 'barrel_inner_r="barrelInnerR" barrel_outer_r="barrelOuterR"/>')]
+    geometries = {
+        'explicit': ring,
+        'analytic': ring + analytic,
+        'param':    ring + analytic + [(r'<dim phiSegments=', '<dim placement="param" phiSegments=')],
+    }
+    variant = {'action': 'ToyCalorimeter_SDAction', 'actionProperties': {'HotPathCounters': True}}
+
+    rows = []
+    for name, replacements in geometries.items():
+        compact = toymeasure.compactVariant(os.path.join(args.workdir, f'placement_{name}.xml'), replacements)
+        startup, startupMemory = toymeasure.ddsim(os.path.join(args.workdir, f'placement_{name}_1.root'), 1,
+                                                  variant, compact)
+        output = os.path.join(args.workdir, f'placement_{name}.root')
+        wall, memory = toymeasure.ddsim(output, args.events, variant, compact)
+        loop = wall - startup
+        steps = toymeasure.hotPathCounter(toymeasure.runParameters(output), 'Steps')
+        rows.append({'geometry': name, 'startup [s]': startup, 'startup RSS [MB]': startupMemory,
+                     'peak RSS [MB]': memory, 'event loop [s]': loop, 'calo steps': steps,
+                     'calo steps/s': steps/loop if loop > 0 else None})
+        print(f"{name}: done", flush=True)
+
+    print(f"\n{args.phi_segments} crystals, {args.events} events (event loop = run time minus the one-event run)")
+    toymeasure.report(['geometry', 'startup [s]', 'startup RSS [MB]', 'peak RSS [MB]', 'event loop [s]',
+                       'calo steps', 'calo steps/s'], rows, args.json)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,50 @@
+# Steering of the measurement scripts in this directory: scripts/toycalo_steering.py with the custom output,
+# a fixed seed and the variant a script passes as JSON in the TOYCALO_MEASURE environment variable:
+#   action            SD action of MyToyCalorimeter, e.g. "ToyCalorimeter_SDAction"
+#   actionProperties  properties of that action, e.g. {"HotPathCounters": true}
+#   outputProperties  properties of Geant4EDM4ToyReadout, e.g. {"CompactHits": true}
+#   stack             stacking actions for SIM.action.stack, e.g. [{"name": "ToyOpticalPhotonKiller/Killer"}]
+#   physics           setup function of toycalo_steering.py for SIM.physics.setupUserPhysics, "none" for none
+#   particle, momentum  particle gun, fixed momentum in GeV
+#   seed              random seed (12345)
+# ddsim runs this file with separate global and local namespaces, so the output setup below gets everything
+# it uses as default arguments.
+import json
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.environ['TOYCALO_SOURCE_DIR'], 'scripts'))
+import toycalo_steering as toy
+from g4units import GeV
+
+variant = json.loads(os.environ.get('TOYCALO_MEASURE', '{}'))
+
+SIM = toy.SIM
+SIM.random.seed = variant.get('seed', 12345)
+
+def setupMeasuredOutput(dd4hepSimulation, setup=toy.setupEDM4hepOutputToyCalo,
+                        properties=variant.get('outputProperties', {})):
+     output = setup(dd4hepSimulation)
+     for name, value in properties.items():
+          setattr(output, name, value)
+     return output
+
+SIM.outputConfig.userOutputPlugin = setupMeasuredOutput
+SIM.outputConfig.myExtension      = '.root'
+
+if 'action' in variant:
+     SIM.action.mapActions['MyToyCalorimeter'] = (variant['action'], variant.get('actionProperties', {}))
+
+if 'stack' in variant:
+     SIM.action.stack = variant['stack']
+
+if variant.get('physics') == 'none':
+     SIM.physics.setupUserPhysics(lambda kernel: None)
+elif 'physics' in variant:
+     SIM.physics.setupUserPhysics(getattr(toy, variant['physics']))
+
+if 'particle' in variant:
+     SIM.gun.particle = variant['particle']
+if 'momentum' in variant:
+     SIM.gun.momentumMin = variant['momentum']*GeV
+     SIM.gun.momentumMax = variant['momentum']*GeV
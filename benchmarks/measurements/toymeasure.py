@@ -0,0 +1,112 @@
+"""Helpers of the measurement scripts in this directory.
+
+The scripts run ddsim and the tools of a ToyCalorimeter build and print the numbers they measured; no numbers
+are stored in the repository. Run them on a machine where the tree builds, with the DD4hep, Geant4 and podio
+environment and the ToyCalorimeter plugin on the library path (the environment script of the installed
+package). Every script takes --help.
+"""
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+SOURCE_DIR = os.path.abspath(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+STEERING   = os.path.join(SOURCE_DIR, 'benchmarks', 'measurements', 'measure_steering.py')
+COMPACT    = os.path.join(SOURCE_DIR, 'compact', 'ToyCalorimeter.xml')
+
+
+def arguments(description, events=20):
+    """Options every measurement takes; add more to the returned parser."""
+    parser = argparse.ArgumentParser(description=description)
+    parser.add_argument('--events', type=int, default=events, help='events per simulation run (%(default)s)')
+    parser.add_argument('--workdir', default='toycalo_measurements', help='output and log files (%(default)s)')
+    parser.add_argument('--json', help='also write the results to this file')
+    return parser
+
+
+def run(command, log, env=None):
+    """Runs command with its output in log. Returns (wall seconds, peak resident memory in MB); exits on failure."""
+    with open(log, 'w') as out:
+        start = time.perf_counter()
+        process = subprocess.Popen(command, stdout=out, stderr=subprocess.STDOUT, env=env)
+        _, status, usage = os.wait4(process.pid, 0)
+        wall = time.perf_counter() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    if process.returncode != 0:
+        sys.exit(f"{' '.join(command)} failed with {process.returncode}, see {log}")
+    return wall, usage.ru_maxrss/1024.
+
+
+def ddsim(output, events, variant=None, compact=COMPACT):
+    """Simulates events with measure_steering.py and the variant; the log is output with .log."""
+    env = dict(os.environ, TOYCALO_SOURCE_DIR=SOURCE_DIR, TOYCALO_MEASURE=json.dumps(variant or {}))
+    command = ['ddsim', '--steeringFile', STEERING, '--compactFile', compact,
+               '--numberOfEvents', str(events), '--outputFile', output]
+    return run(command, os.path.splitext(output)[0] + '.log', env)
+
+
+def tool(build, name):
+    """Path of a ToyCalorimeter tool: in the build directory if given, otherwise from PATH."""
+    if build:
+        for candidate in (os.path.join(build, 'tools', name), os.path.join(build, 'bin', name)):
+            if os.path.exists(candidate):
+                return candidate
+        sys.exit(f"{name} not found in {build}")
+    path = shutil.which(name)
+    if not path:
+        sys.exit(f"{name} not found, give the build directory with --build")
+    return path
+
+
+def runParameters(path):
+    """Parameters of the run frames of a podio file, as {name: list of values}."""
+    from podio.root_io import Reader
+    parameters = {}
+    for frame in Reader(path).get('runs'):
+        for name in frame.parameters:
+            parameters[name] = list(frame.get_parameter(name))
+    return parameters
+
+
+def hotPathCounter(parameters, counter):
+    """Sum over actions and threads of a HotPathCounters entry, e.g. 'Steps' (see toycalo_steering.py)."""
+    total = 0.
+    for name, values in parameters.items():
+        if name.endswith('__' + counter):
+            high = parameters.get(name + 'High', [0]*len(values))
+            total += sum(float(v) + float(h)*2**31 for v, h in zip(values, high))
+    return total
+
+
+def compactVariant(path, replacements):
+    """Writes a copy of compact/ToyCalorimeter.xml with the regular expression replacements applied."""
+    with open(COMPACT) as f:
+        text = f.read()
+    for pattern, replacement in replacements:
+        text, n = re.subn(pattern, replacement, text)
+        if n == 0:
+            sys.exit(f"{pattern} not found in {COMPACT}")
+    with open(path, 'w') as f:
+        f.write(text)
+    return path
+
+
+def report(columns, rows, path=None):
+    """Prints rows (dicts) as a table and writes them to path as JSON."""
+    widths = [max(len(c), *(len(format_value(r.get(c))) for r in rows)) for c in columns]
+    print('  '.join(c.ljust(w) for c, w in zip(columns, widths)))
+    for r in rows:
+        print('  '.join(format_value(r.get(c)).ljust(w) for c, w in zip(columns, widths)))
+    if path:
+        with open(path, 'w') as f:
+            json.dump(rows, f, indent=2)
+
+
+def format_value(value):
+    if isinstance(value, float):
+        return f"{value:.4g}"
+    return '' if value is None else str(value)
@@ -135,6 +135,139 @@ class SimCalorimeterHitCollection():
         for hit in self.hits:
             yield hit
 
+class CellPositionTable():
+    # Cell centres of a compact hit collection (Geant4EDM4ToyReadout.CompactHits), stored once in the
+    # metadata frame and only read when a position is first needed
+    def __init__(self, rootfile, collection):
+        self.rootfile         = rootfile
+        self.collection       = collection
+        self.loaded           = False
+
+    def load(self):
+        from podio.root_io import Reader
+        meta = Reader(self.rootfile).get('metadata')[0]
+        name = self.collection
+        # cellIndex = mixed-radix number of cell ID fields, least significant first
+        fields      = meta.get_parameter(name + '__CellIndexFields').split(',')
+        extents     = list(meta.get_parameter(name + '__CellIndexExtents'))
+        bitfields   = decode_cellid_encoding(meta.get_parameter(name + '__CellIDEncoding'))
+        self.radix  = [(bitfields.get(field), extent) for field, extent in zip(fields, extents)]
+        self.x      = np.array(meta.get_parameter(name + '__CellPositionX'), dtype=np.float32)
+        self.y      = np.array(meta.get_parameter(name + '__CellPositionY'), dtype=np.float32)
+        self.z      = np.array(meta.get_parameter(name + '__CellPositionZ'), dtype=np.float32)
+        self.loaded = True
+
+    def positions(self, cellIDs):
+        if not self.loaded:
+            self.load()
+        index  = np.zeros(len(cellIDs), dtype=np.int64)
+        stride = 1
+        for bitfield, extent in self.radix:
+            if bitfield is not None:    # fields missing from the encoding are always 0
+                offset, width = bitfield
+                value = (cellIDs >> np.uint64(offset)) & np.uint64((1 << width) - 1)
+                index += value.astype(np.int64) * stride
+            stride *= extent
+        return self.x[index], self.y[index], self.z[index]
+
+def decode_cellid_encoding(encoding):
+    # DD4hep cell ID encoding "name:[offset:]width,..." -> {name: (offset, width)}
+    fields, offset = {}, 0
+    for item in encoding.split(','):
+        parts = item.strip().split(':')
+        if len(parts) == 3:
+            offset = int(parts[1])
+        width = abs(int(parts[-1]))
+        fields[parts[0]] = (offset, width)
+        offset += width
+    return fields
+
+class CompactCalorimeterHitCollection():
+    # Takes edm4toy CompactToyCalorimeterHits; x, y, z come from the position table when first used
+    def __init__(self, rawhits, table):
+        self.N                = len(rawhits)
+        self.cellID           = np.array([hit.cellID                   for hit in rawhits], dtype=np.uint64)
+        self.E                = np.array([hit.energy                   for hit in rawhits])
+        self.table            = table
+        self.xyz              = None
+
+    def positions(self):
+        if self.xyz is None:
+            self.xyz = self.table.positions(self.cellID)
+        return self.xyz
+
+    x     = property(lambda self: self.positions()[0])
+    y     = property(lambda self: self.positions()[1])
+    z     = property(lambda self: self.positions()[2])
+    r     = property(lambda self: np.sqrt(self.x**2 + self.y**2 + self.z**2))
+    theta = property(lambda self: np.arccos(np.divide(self.z, self.r, out=np.zeros(self.N), where=self.r != 0)))
+    phi   = property(lambda self: np.arctan2(self.y, self.x))
+
+class ToyDisplayFile():
+    # Columnar event file of ToyDisplayExport, memory-mapped: the arrays of an event are views into the
+    # file, nothing is copied or parsed per hit. Level 0 is the full event, higher levels merge 2^k x 2^k
+    # crystals and keep fewer MC particles.
+    header_dtype = np.dtype([('magic', 'S8'), ('version', '<u4'), ('nLevels', '<u4'),
+                             ('nEvents', '<u8'), ('directoryOffset', '<u8')])
+    event_dtype  = np.dtype([('run', '<u8'), ('event', '<u8')])
+    block_dtype  = np.dtype([('hitsOffset', '<u8'), ('nHits', '<u8'), ('tracksOffset', '<u8'), ('nTracks', '<u8')])
+
+    def __init__(self, path):
+        self.data    = np.memmap(path, dtype=np.uint8, mode='r')
+        header       = np.frombuffer(self.data, self.header_dtype, count=1)[0]
+        if header['magic'] != b'TOYDISP1':
+            raise ValueError(f"{path} is not a ToyDisplayExport file")
+        self.nLevels = int(header['nLevels'])
+        self.N       = int(header['nEvents'])
+        offset       = int(header['directoryOffset'])
+        self.events  = np.frombuffer(self.data, self.event_dtype, count=self.N, offset=offset)
+        self.blocks  = np.frombuffer(self.data, self.block_dtype, count=self.N*self.nLevels,
+                                     offset=offset + self.N*self.event_dtype.itemsize).reshape(self.N, self.nLevels)
+
+    def columns(self, offset, n, dtypes):
+        # Consecutive columns of n values, each padded to 8 bytes
+        result = []
+        for dtype in dtypes:
+            dtype = np.dtype(dtype)
+            result.append(np.frombuffer(self.data, dtype, count=n, offset=offset))
+            offset += (n*dtype.itemsize + 7) // 8 * 8
+        return result
+
+    def hits(self, i, level=0):
+        block = self.blocks[i, min(level, self.nLevels-1)]
+        n = int(block['nHits'])
+        cellID, x, y, z, E = self.columns(int(block['hitsOffset']), n, ['<u8', '<f4', '<f4', '<f4', '<f4'])
+        return DisplayHitCollection(cellID, x, y, z, E)
+
+    def tracks(self, i, level=0):
+        block = self.blocks[i, min(level, self.nLevels-1)]
+        n = int(block['nTracks'])
+        return DisplayTrackCollection(*self.columns(int(block['tracksOffset']), n, ['<i4'] + ['<f4']*7))
+
+class DisplayHitCollection():
+    # Calorimeter hits of a ToyDisplayFile, same attributes as SimCalorimeterHitCollection
+    def __init__(self, cellID, x, y, z, E):
+        self.N      = len(cellID)
+        self.cellID = cellID
+        self.x      = x
+        self.y      = y
+        self.z      = z
+        self.E      = E
+
+    r     = property(lambda self: np.sqrt(self.x**2 + self.y**2 + self.z**2))
+    theta = property(lambda self: np.arccos(np.divide(self.z, self.r, out=np.zeros(self.N, dtype=np.float32), where=self.r != 0)))
+    phi   = property(lambda self: np.arctan2(self.y, self.x))
+
+class DisplayTrackCollection():
+    # MC particles of a ToyDisplayFile as straight lines from vertex to endpoint
+    def __init__(self, PDG, energy, vx, vy, vz, endx, endy, endz):
+        self.N          = len(PDG)
+        self.PDG        = PDG
+        self.energy     = energy
+        self.vx, self.vy, self.vz       = vx, vy, vz
+        self.endx, self.endy, self.endz = endx, endy, endz
+        self.pathlength = np.sqrt((vx-endx)**2 + (vy-endy)**2 + (vz-endz)**2)
+
 class DetPlot():
     def __init__(self, rootfile, maxMC, subdet_collections, MC_settings):
         self.rootfile = rootfile
@@ -143,6 +276,7 @@ class DetPlot():
         self.collections = defaultdict(dict)
         self.pdg_vis_map = self.generate_pdg_vis_map('./PDG_IDs.txt')
         self.MC_settings = MC_settings
+        self.position_tables = {}
 
     def print_sizes_for_event_num(self, eventnum):
         print(f"{'Subdetector Collection':<40} {'Hits':<10}")
@@ -176,6 +310,19 @@ class DetPlot():
                 elif self.subdet_colls[branch_name]['type']=='SimCalorimeterHit':
                     self.collections[branch_name][i] = SimCalorimeterHitCollection([SimCalorimeterHit(hit) for hit in data])
 
+                elif self.subdet_colls[branch_name]['type']=='CompactCalorimeterHit':
+                    table = self.position_tables.setdefault(branch_name, CellPositionTable(self.rootfile, branch_name))
+                    self.collections[branch_name][i] = CompactCalorimeterHitCollection(list(data), table)
+
+    def loadDisplayEvent(self, display, i, level=0):
+        # Fast path: event i of a ToyDisplayFile; collections configured as 'SimCalorimeterHit' get the hits
+        # of the file, MCParticles its tracks
+        for branch_name, settings in self.subdet_colls.items():
+            if settings['type']=='MCParticle':
+                self.collections[branch_name][i] = display.tracks(i, level)
+            elif settings['type']=='SimCalorimeterHit':
+                self.collections[branch_name][i] = display.hits(i, level)
+
     def getHitmarkersForEvent(self, eventnum):
         hitmarkers = []
         for branch_name in self.subdet_colls.keys():
@@ -210,6 +357,8 @@ class DetPlot():
 
     def plot_MC_tracks(self, MCcollection):
         MCS = self.MC_settings
+        if isinstance(MCcollection, DisplayTrackCollection):
+            return self.plot_display_tracks(MCcollection)
         mctracks = []
 
         sortkey = (lambda mcp: mcp.time) if MCS['sortBy']=='time' else (lambda mcp: mcp.energy)
@@ -254,6 +403,36 @@ class DetPlot():
                 )
         return mctracks
 
+    def plot_display_tracks(self, tracks):
+        # One trace per PDG code, its lines separated by NaN, instead of one trace per particle
+        MCS = self.MC_settings
+        keep = (tracks.energy > MCS['Ecutoff_GeV']) & (tracks.pathlength > MCS['pathlength_mm'])
+        if MCS['limitPDG']:
+            keep &= np.isin(tracks.PDG, MCS['PDG_show'])
+        mctracks = []
+        for pdg in np.unique(tracks.PDG[keep]):
+            sel = keep & (tracks.PDG == pdg)
+            n = np.count_nonzero(sel)
+            def polyline(start, end):
+                xyz = np.full(3*n, np.nan, dtype=np.float32)
+                xyz[0::3] = start[sel]
+                xyz[1::3] = end[sel]
+                return xyz
+            color = self.pdg_vis_map['color'].get(pdg, "#999999")
+            name = f"{self.pdg_vis_map['particle_name'].get(pdg, 'Unknown'):<6s} ({n} tracks)"
+            lw = np.log(tracks.energy[sel].max())+abs(np.log(MCS['MC_Ecutoff_GeV'])) if MCS['lineWidthByEnergy'] else MCS['defLineWidth']
+            mctracks.append(
+                go.Scatter3d(
+                    x=polyline(tracks.vx, tracks.endx),
+                    y=polyline(tracks.vy, tracks.endy),
+                    z=polyline(tracks.vz, tracks.endz),
+                    mode='lines',
+                    line=dict(color=color, width=lw),
+                    name=name
+                )
+            )
+        return mctracks
+
     def getLayout(self, plotSettings):
 
         xrange = plotSettings['xlim'][1] - plotSettings['xlim'][0]
@@ -0,0 +1,104 @@
+#include "ToyAnalysis.h"
+#include "ToyToolSupport.h"
+#include <edm4hep/MCParticleCollection.h>
+#include <cmath>
+#include <stdexcept>
+
+namespace ToyCalorimeter {
+
+  ToyAnalysis::ToyAnalysis(const ToyAnalysisOptions& options) : m_options(options)  {
+    const double eMax = options.maxEnergy;
+    m_histograms.resize(NHistograms);
+    m_histograms[TotalEnergy]            = ToyHistogram("totalEnergy", "Deposited energy per event;E [GeV];events", 200, 0., eMax);
+    m_histograms[HitEnergy]              = ToyHistogram("hitEnergy", "Hit energy;log10(E/GeV);hits", 200, -6., std::log10(eMax));
+    m_histograms[HitMultiplicity]        = ToyHistogram("hitMultiplicity", "Hits per event;hits;events", 200, 0., 20000.);
+    m_histograms[PhiSectorEnergy]        = ToyHistogram("phiSectorEnergy", "Energy per phi sector;sector;E [GeV]",
+                                                        options.phiSectors, 0., options.phiSectors);
+    m_histograms[InterestingSum]         = ToyHistogram("interestingSum", "Sum of yourInterestingQuantity per event;sum;events", 200, 0., 1000.);
+    m_histograms[MatchedFraction]        = ToyHistogram("matchedFraction", "Hit energy carried by MC contributions;fraction;hits", 110, 0., 1.1);
+    m_histograms[PrimaryDepositFraction] = ToyHistogram("primaryDepositFraction", "Deposit of each primary;E_{dep}/E;primaries", 110, 0., 1.1);
+  }
+
+  void ToyAnalysis::process(const podio::Frame& event)  {
+    const podio::CollectionBase* hits = event.get(m_options.collection);
+    const bool known = visitSimCalorimeterHits(hits, [&](const auto& simHits) { processHits(simHits, event); });
+    if ( !known && hits ) {
+      throw std::runtime_error(m_options.collection + " is a " + std::string(hits->getTypeName()) +
+                               ", not a simulated calorimeter hit collection");
+    }
+    ++m_events;
+  }
+
+  template <typename COLL> void ToyAnalysis::processHits(const COLL& hits, const podio::Frame& event)  {
+    const auto* particles = dynamic_cast<const edm4hep::MCParticleCollection*>(event.get(m_options.particles));
+    const std::size_t nParticles = particles ? particles->size() : 0;
+
+    // Primary ancestor of every particle, resolved on first use; -1 means not resolved yet
+    m_primaryOf.assign(nParticles, -1);
+    m_primaryDeposit.assign(nParticles, 0.);
+    auto primary = [&](int index) {
+      int top = index;
+      while ( m_primaryOf[top] < 0 ) {
+        const auto parents = (*particles)[top].getParents();
+        if ( parents.empty() ) break;
+        const int parent = parents[0].getObjectID().index;
+        if ( parent < 0 || std::size_t(parent) >= nParticles ) break;
+        top = parent;
+      }
+      if ( m_primaryOf[top] >= 0 ) top = m_primaryOf[top];
+      // Path compression: every particle on the way points to the primary directly
+      for ( int i = index; m_primaryOf[i] < 0; ) {
+        m_primaryOf[i] = top;
+        const auto parents = (*particles)[i].getParents();
+        if ( i == top || parents.empty() ) break;
+        i = parents[0].getObjectID().index;
+      }
+      return top;
+    };
+
+    static const ToyCellPositionTable noPositions;
+    const ToyCellPositionTable& positions = m_options.positions ? *m_options.positions : noPositions;
+    const double sectorWidth = 2*M_PI/m_options.phiSectors;
+    double total = 0, interesting = 0;
+    for ( const auto& hit : hits )  {
+      const double energy = hit.getEnergy();
+      total += energy;
+      m_histograms[HitEnergy].fill(energy > 0 ? std::log10(energy) : -1e9);
+
+      const auto pos = hitPosition(hit, positions);
+      double phi = std::atan2(pos.y, pos.x);
+      if ( phi < 0 ) phi += 2*M_PI;
+      m_histograms[PhiSectorEnergy].fill(std::floor(phi/sectorWidth), energy);
+
+      if constexpr ( requires { hit.getYourInterestingQuantity(); } )  {
+        interesting += hit.getYourInterestingQuantity();
+      }
+
+      double matched = 0;
+      for ( const auto& contribution : hit.getContributions() )  {
+        const auto particle = contribution.getParticle();
+        if ( !particle.isAvailable() ) continue;
+        const int index = particle.getObjectID().index;
+        if ( index < 0 || std::size_t(index) >= nParticles ) continue;
+        matched += contribution.getEnergy();
+        m_primaryDeposit[primary(index)] += contribution.getEnergy();
+      }
+      if ( energy > 0 ) m_histograms[MatchedFraction].fill(matched/energy);
+    }
+    m_histograms[TotalEnergy].fill(total);
+    m_histograms[HitMultiplicity].fill(hits.size());
+    m_histograms[InterestingSum].fill(interesting);
+
+    for ( std::size_t i = 0; i < nParticles; i++ )  {
+      if ( m_primaryDeposit[i] <= 0 ) continue;
+      const double energy = (*particles)[i].getEnergy();
+      if ( energy > 0 ) m_histograms[PrimaryDepositFraction].fill(m_primaryDeposit[i]/energy);
+    }
+  }
+
+  void ToyAnalysis::merge(const ToyAnalysis& other)  {
+    for ( int h = 0; h < NHistograms; h++ ) m_histograms[h].add(other.m_histograms[h]);
+    m_events += other.m_events;
+  }
+
+}
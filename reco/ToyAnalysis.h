@@ -0,0 +1,96 @@
+#ifndef ToyAnalysis_h
+#define ToyAnalysis_h 1
+#include "ToyCellPositionTable.h"
+#include <podio/Frame.h>
+
+#include <memory>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ToyCalorimeter {
+
+  // Fixed-bin histogram with under- and overflow bins. One copy per thread, merged with add() at the end,
+  // so filling needs no locks.
+  struct ToyHistogram {
+    std::string         name;
+    std::string         title;
+    int                 nBins {1};
+    double              low   {0};
+    double              high  {1};
+    std::vector<double> sumW;      // bin 0 is the underflow, bin nBins+1 the overflow
+    std::vector<double> sumW2;
+    double              entries {0};
+
+    ToyHistogram() = default;
+    ToyHistogram(std::string name, std::string title, int nBins, double low, double high)
+      : name(std::move(name)), title(std::move(title)), nBins(nBins), low(low), high(high),
+        sumW(nBins+2, 0.), sumW2(nBins+2, 0.) {}
+
+    int bin(double x) const {
+      if (x < low) return 0;
+      if (x >= high) return nBins+1;
+      return 1 + static_cast<int>((x - low)*nBins/(high - low));
+    }
+    void fill(double x, double w = 1.) {
+      const int b = bin(x);
+      sumW[b]  += w;
+      sumW2[b] += w*w;
+      entries  += 1;
+    }
+    void add(const ToyHistogram& other) {
+      for (int b=0; b<nBins+2; b++) {
+        sumW[b]  += other.sumW[b];
+        sumW2[b] += other.sumW2[b];
+      }
+      entries += other.entries;
+    }
+  };
+
+  struct ToyAnalysisOptions {
+    std::string collection   {"ToyCalorimeterHits"};
+    std::string particles    {"MCParticles"};
+    int         phiSectors   {64};     // sectors of the per-phi energy profile
+    double      maxEnergy    {100.};   // upper edge of the energy histograms in GeV
+    // Cell positions of compact hits, from the metadata of the input (shared by the threads)
+    std::shared_ptr<const ToyCellPositionTable> positions;
+  };
+
+  // Standard ToyCalorimeter quantities of the events frames:
+  //  - total deposited energy, hit energies and multiplicity per event
+  //  - energy per phi sector, summed over events (divide by events() for the mean profile)
+  //  - sum of yourInterestingQuantity per event, for edm4toy::SimToyCalorimeterHits
+  //  - MC matching: energy fraction of every hit carried by its contributions, and the energy each
+  //    primary particle deposited relative to its own energy
+  //
+  // The hit collection can hold edm4hep::SimCalorimeterHits, edm4toy::SimToyCalorimeterHits or
+  // edm4toy::CompactToyCalorimeterHits; the latter need the positions option.
+  // Use one instance per thread and merge them once all events are done.
+  class ToyAnalysis {
+    public:
+      explicit ToyAnalysis(const ToyAnalysisOptions& options = {});
+
+      void process(const podio::Frame& event);
+      void merge(const ToyAnalysis& other);
+
+      long events() const { return m_events; }
+      const std::vector<ToyHistogram>& histograms() const { return m_histograms; }
+
+    private:
+      template <typename COLL> void processHits(const COLL& hits, const podio::Frame& event);
+
+      enum Histogram { TotalEnergy, HitEnergy, HitMultiplicity, PhiSectorEnergy, InterestingSum,
+                       MatchedFraction, PrimaryDepositFraction, NHistograms };
+
+      ToyAnalysisOptions        m_options;
+      std::vector<ToyHistogram> m_histograms;
+      long                      m_events {0};
+      // Per-event scratch, kept to avoid reallocations
+      std::vector<int>          m_primaryOf;
+      std::vector<double>       m_primaryDeposit;
+  };
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "ToyCellPositionTable.h"
+#include <DDSegmentation/BitFieldCoder.h>
+#include <podio/podioVersion.h>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+  template <typename T> T parameter(const podio::Frame& frame, const std::string& key)  {
+    #if podio_VERSION_MAJOR > 0 || podio_VERSION_MINOR > 16 || podio_VERSION_PATCH > 2
+    return frame.getParameter<T>(key).value_or(T{});
+    #else
+    return frame.getParameter<T>(key);
+    #endif
+  }
+
+}
+
+namespace ToyCalorimeter {
+
+  ToyCellPositionTable::ToyCellPositionTable(const podio::Frame& metadata, const std::string& collection)
+    : m_collection(collection)  {
+    m_x = parameter<std::vector<float>>(metadata, collection + "__CellPositionX");
+    if ( m_x.empty() ) return;
+    m_y = parameter<std::vector<float>>(metadata, collection + "__CellPositionY");
+    m_z = parameter<std::vector<float>>(metadata, collection + "__CellPositionZ");
+
+    const auto fields   = parameter<std::string>(metadata, collection + "__CellIndexFields");
+    const auto extents  = parameter<std::vector<int>>(metadata, collection + "__CellIndexExtents");
+    const auto encoding = parameter<std::string>(metadata, collection + "__CellIDEncoding");
+    dd4hep::DDSegmentation::BitFieldCoder coder(encoding);
+
+    std::stringstream names(fields);
+    std::size_t size = 1;
+    for ( std::string name; std::getline(names, name, ','); )  {
+      if ( m_digits.size() >= extents.size() ) break;
+      Digit digit {0, 0, extents[m_digits.size()]};
+      for ( const auto& element : coder.fields() )  {
+        if ( element.name() != name ) continue;
+        digit.offset = element.offset();
+        digit.mask   = (element.width() < 64 ? (uint64_t(1) << element.width()) : 0) - 1;
+      }
+      size *= digit.extent;
+      m_digits.push_back(digit);
+    }
+    if ( m_digits.size() != extents.size() || size != m_x.size() || m_y.size() != m_x.size() || m_z.size() != m_x.size() )  {
+      throw std::runtime_error("the cell position table of " + collection + " in the metadata is inconsistent");
+    }
+  }
+
+  long ToyCellPositionTable::cellIndex(uint64_t cellID) const  {
+    long index = 0, stride = 1;
+    for ( const auto& digit : m_digits )  {
+      const long value = long((cellID >> digit.offset) & digit.mask);
+      if ( value >= digit.extent ) return -1;
+      index  += value*stride;
+      stride *= digit.extent;
+    }
+    return index;
+  }
+
+  edm4hep::Vector3f ToyCellPositionTable::position(uint64_t cellID) const  {
+    if ( m_x.empty() )  {
+      throw std::runtime_error("compact hits of " + (m_collection.empty() ? std::string("the input") : m_collection) +
+                               " need cell positions, but the metadata has none for them");
+    }
+    const long index = cellIndex(cellID);
+    if ( index < 0 || std::size_t(index) >= m_x.size() )  {
+      throw std::runtime_error("cell " + std::to_string(cellID) + " is not in the cell position table");
+    }
+    return edm4hep::Vector3f(m_x[index], m_y[index], m_z[index]);
+  }
+
+}
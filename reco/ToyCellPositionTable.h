@@ -0,0 +1,51 @@
+#ifndef ToyCellPositionTable_h
+#define ToyCellPositionTable_h 1
+#include <edm4hep/Vector3f.h>
+#include <podio/Frame.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ToyCalorimeter {
+
+  // Cell centres of a collection of edm4toy::CompactToyCalorimeterHits, which carry no position.
+  // Geant4EDM4ToyReadout writes them once to the metadata frame (see addPositionTable()):
+  //   <collection>__CellIndexFields, __CellIndexExtents   cell index as a mixed-radix number of cell ID fields,
+  //                                                       least significant first
+  //   <collection>__CellIDEncoding                        where these fields are in the cell ID
+  //   <collection>__CellPositionX, Y, Z                   positions in mm, indexed by the cell index
+  // The C++ twin of CellPositionTable in eventdisplay.py.
+  class ToyCellPositionTable {
+    public:
+      ToyCellPositionTable() = default;
+      // Empty if the metadata holds no table for the collection
+      ToyCellPositionTable(const podio::Frame& metadata, const std::string& collection);
+
+      bool empty() const { return m_x.empty(); }
+
+      // Index into the table, -1 for cells outside of it
+      long cellIndex(uint64_t cellID) const;
+      // Throws std::runtime_error for cells outside the table, and for every cell if the table is empty
+      edm4hep::Vector3f position(uint64_t cellID) const;
+
+    private:
+      struct Digit {
+        unsigned offset;
+        uint64_t mask;       // 0 for fields missing from the encoding, they are always 0
+        long     extent;
+      };
+      std::string        m_collection;
+      std::vector<Digit> m_digits;
+      std::vector<float> m_x, m_y, m_z;
+  };
+
+  // Position of a hit: its own for full hits, the table entry of its cell for compact hits
+  template <typename HIT> edm4hep::Vector3f hitPosition(const HIT& hit, const ToyCellPositionTable& positions) {
+    if constexpr ( requires { hit.getPosition(); } ) return hit.getPosition();
+    else return positions.position(hit.getCellID());
+  }
+
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef ToyThreadPool_h
+#define ToyThreadPool_h 1
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ToyCalorimeter {
+
+  // Fixed set of workers taking jobs from a queue, for the standalone tools
+  class ToyThreadPool {
+    public:
+      explicit ToyThreadPool(unsigned nThreads) {
+        for (unsigned i=0; i<nThreads; i++) m_workers.emplace_back([this]() { work(); });
+      }
+      ~ToyThreadPool() {
+        {
+          std::lock_guard<std::mutex> guard(m_lock);
+          m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto& worker : m_workers) worker.join();
+      }
+      unsigned size() const { return m_workers.size(); }
+
+      template <typename F> std::future<std::invoke_result_t<F>> submit(F&& job) {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(job));
+        {
+          std::lock_guard<std::mutex> guard(m_lock);
+          m_jobs.emplace_back([task]() { (*task)(); });
+        }
+        m_wake.notify_one();
+        return task->get_future();
+      }
+
+    private:
+      void work() {
+        for (;;) {
+          std::function<void()> job;
+          {
+            std::unique_lock<std::mutex> guard(m_lock);
+            m_wake.wait(guard, [this]() { return m_stop || !m_jobs.empty(); });
+            if (m_jobs.empty()) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+          }
+          job();
+        }
+      }
+
+      std::vector<std::thread>          m_workers;
+      std::deque<std::function<void()>> m_jobs;
+      std::mutex                        m_lock;
+      std::condition_variable           m_wake;
+      bool                              m_stop {false};
+  };
+
+  // Ordered pipeline: n items are produced by next() and consumed by done() on the calling thread, in order,
+  // while process() runs on the pool. At most 2 items per worker are in flight. Exceptions of process()
+  // come out of done()'s call site.
+  template <typename NEXT, typename PROCESS, typename DONE>
+  void processInOrder(ToyThreadPool& pool, std::size_t n, NEXT next, PROCESS process, DONE done) {
+    using item_t   = std::invoke_result_t<NEXT>;
+    using result_t = std::invoke_result_t<PROCESS, item_t&&>;
+    std::deque<std::future<result_t>> inFlight;
+    for (std::size_t i=0; i<n || !inFlight.empty(); ) {
+      if (i < n && inFlight.size() < 2*pool.size()) {
+        auto item = std::make_shared<item_t>(next());
+        inFlight.push_back(pool.submit([item, &process]() { return process(std::move(*item)); }));
+        ++i;
+        continue;
+      }
+      done(inFlight.front().get());
+      inFlight.pop_front();
+    }
+  }
+
+}
+
+#endif
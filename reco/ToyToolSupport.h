@@ -0,0 +1,71 @@
+#ifndef ToyToolSupport_h
+#define ToyToolSupport_h 1
+#include <edm4hep/SimCalorimeterHitCollection.h>
+#include <edm4toy/CompactToyCalorimeterHitCollection.h>
+#include <edm4toy/SimToyCalorimeterHitCollection.h>
+#include <podio/CollectionBase.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace ToyCalorimeter {
+
+  // Command line of the standalone tools: options taking one value, anything not starting with '-' is an input.
+  //
+  //   ToyCommandLine cmd(argc, argv, "ToyTool -o output [--threads N] input.root ...");
+  //   while (cmd.next()) {
+  //     if      (cmd.arg() == "-o")        output = cmd.value();
+  //     else if (cmd.isOption())           return cmd.usage();
+  //     else                               inputs.push_back(cmd.arg());
+  //   }
+  class ToyCommandLine {
+    public:
+      ToyCommandLine(int argc, char** argv, const char* usage) : m_argc(argc), m_argv(argv), m_usage(usage) {}
+
+      // Moves to the next argument, false after the last one
+      bool next() {
+        if (++m_index >= m_argc) return false;
+        m_arg = m_argv[m_index];
+        return true;
+      }
+      const std::string& arg() const { return m_arg; }
+      bool isOption() const { return m_arg.rfind("-", 0) == 0; }
+
+      // Value of the current option, the process exits if it is missing
+      std::string value() {
+        if (m_index+1 >= m_argc) {
+          std::cerr << "missing value for " << m_arg << std::endl;
+          std::exit(1);
+        }
+        return m_argv[++m_index];
+      }
+
+      // Prints the usage line, returns the exit code for main()
+      int usage() const {
+        std::cerr << "usage: " << m_usage << std::endl;
+        return 1;
+      }
+
+    private:
+      int         m_argc;
+      char**      m_argv;
+      const char* m_usage;
+      int         m_index {0};
+      std::string m_arg;
+  };
+
+  // Calls visit with the typed collection of simulated calorimeter hits. ToyCalorimeter_SDAction writes edm4hep
+  // hits, the interesting hits of the custom action are edm4toy hits, and with CompactHits the output writes
+  // edm4toy compact hits, positioned by a ToyCellPositionTable. False if hits is of none of these types.
+  template <typename VISIT> bool visitSimCalorimeterHits(const podio::CollectionBase* hits, VISIT&& visit) {
+    if (auto* simHits = dynamic_cast<const edm4hep::SimCalorimeterHitCollection*>(hits)) visit(*simHits);
+    else if (auto* toyHits = dynamic_cast<const edm4toy::SimToyCalorimeterHitCollection*>(hits)) visit(*toyHits);
+    else if (auto* compactHits = dynamic_cast<const edm4toy::CompactToyCalorimeterHitCollection*>(hits)) visit(*compactHits);
+    else return false;
+    return true;
+  }
+
+}
+
+#endif
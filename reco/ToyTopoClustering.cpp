@@ -0,0 +1,56 @@
+#include "ToyTopoClustering.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace ToyCalorimeter {
+
+  ToyTopoClustering::ToyTopoClustering(const dd4hep::DDSegmentation::ToySegmentation& segmentation,
+                                       const ToyClusteringOptions& options)
+    : m_segmentation(segmentation), m_options(options), m_hitOfCell(segmentation.numberOfCells(), -1)  {
+    if ( !segmentation.hasNeighbourTable() ) {
+      throw std::invalid_argument("ToyTopoClustering: the segmentation has no neighbour table");
+    }
+  }
+
+  int ToyTopoClustering::run(std::span<const long> cellIndex, std::span<const float> energy, std::span<int> cluster)  {
+    const int32_t nHits = cellIndex.size();
+    m_seeds.clear();
+    for ( int32_t i = 0; i < nHits; i++ )  {
+      cluster[i] = -1;
+      const long cell = cellIndex[i];
+      if ( cell < 0 || energy[i] < m_options.cellThreshold || m_hitOfCell[cell] >= 0 ) continue;
+      m_hitOfCell[cell] = i;
+      if ( energy[i] >= m_options.seedThreshold ) m_seeds.push_back(i);
+    }
+    std::sort(m_seeds.begin(), m_seeds.end(), [&](int32_t a, int32_t b) {
+      return energy[a] > energy[b] || (energy[a] == energy[b] && cellIndex[a] < cellIndex[b]);
+    });
+
+    int nClusters = 0;
+    for ( const int32_t seed : m_seeds )  {
+      if ( cluster[seed] >= 0 ) continue;
+      const int id = nClusters++;
+      cluster[seed] = id;
+      m_queue.assign(1, seed);
+      // Breadth first: only cells above the grow threshold pass the growth on
+      for ( std::size_t q = 0; q < m_queue.size(); q++ )  {
+        const int32_t hit = m_queue[q];
+        if ( energy[hit] < m_options.growThreshold ) continue;
+        for ( const uint32_t neighbour : m_segmentation.neighbours(cellIndex[hit]) )  {
+          const int32_t other = m_hitOfCell[neighbour];
+          if ( other < 0 || cluster[other] >= 0 ) continue;
+          cluster[other] = id;
+          m_queue.push_back(other);
+        }
+      }
+    }
+
+    // Leave the cell array empty for the next event
+    for ( int32_t i = 0; i < nHits; i++ )  {
+      const long cell = cellIndex[i];
+      if ( cell >= 0 ) m_hitOfCell[cell] = -1;
+    }
+    return nClusters;
+  }
+
+}
@@ -0,0 +1,43 @@
+#ifndef ToyTopoClustering_h
+#define ToyTopoClustering_h 1
+#include "ToySegmentation.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ToyCalorimeter {
+
+  struct ToyClusteringOptions {
+    double seedThreshold {0.1};     // GeV, a hit above starts a cluster
+    double growThreshold {0.02};    // GeV, a clustered hit above adds its neighbours
+    double cellThreshold {0.005};   // GeV, hits below are never clustered
+  };
+
+  // Seed/grow/terminate topological clustering over the neighbour table of a ToySegmentation.
+  // Seeds are taken in order of decreasing energy; each grows through the neighbour table, cells above the
+  // grow threshold passing the growth on, cells above the cell threshold only joining. A cell belongs to the
+  // first cluster reaching it. One hit per cell is expected, further hits of a cell are left unclustered.
+  //
+  // Lookups go through dense arrays over cellIndex(), so an event costs O(hits x neighbours) besides the
+  // sort of the seeds. Use one instance per thread; the segmentation is shared read-only.
+  class ToyTopoClustering {
+    public:
+      // The segmentation needs a neighbour table (ToySegmentation::buildNeighbourTable())
+      ToyTopoClustering(const dd4hep::DDSegmentation::ToySegmentation& segmentation, const ToyClusteringOptions& options = {});
+
+      // Cluster number of every hit, -1 if unclustered; clusters are numbered by decreasing seed energy.
+      // Returns the number of clusters. cellIndex < 0 marks hits outside the segmentation.
+      int run(std::span<const long> cellIndex, std::span<const float> energy, std::span<int> cluster);
+
+    private:
+      const dd4hep::DDSegmentation::ToySegmentation& m_segmentation;
+      ToyClusteringOptions m_options;
+      std::vector<int32_t> m_hitOfCell;   // hit of each cell in the current event, -1 if none
+      std::vector<int32_t> m_seeds;
+      std::vector<int32_t> m_queue;
+  };
+
+}
+
+#endif
@@ -29,11 +29,99 @@ def setupCerenkovScint(kernel):
 
      return None
 
-# Sets up a custom EDM4hep output for the ToyCalorimeter if using custom readout
+# Sets up the parametrized EM shower model on the calorimeter region instead of full showering
+# Showers are only parametrized above the Etrigger energy of their particle type
+def setupToyFastShower(kernel):
+     from DDG4 import DetectorConstruction, PhysicsList
+     from g4units import GeV
+     model = DetectorConstruction(kernel, 'ToyEMShowerModel/ToyShowerModel')
+     model.RegionName          = 'ToyCalorimeterRegion'
+     model.ApplicableParticles = ['e+', 'e-', 'gamma']
+     model.Etrigger            = {'e+': 1*GeV, 'e-': 1*GeV, 'gamma': 1*GeV}
+     model.enableUI()
+     kernel.detectorConstruction().adopt(model)
+
+     fast = PhysicsList(kernel, 'Geant4FastPhysics/FastPhysicsList')
+     fast.EnabledParticles = ['e+', 'e-', 'gamma']
+     fast.enableUI()
+     kernel.physicsList().adopt(fast)
+
+     return None
+
+# SIM.physics.setupUserPhysics keeps only the last function it is given: this one installs the optical
+# physics together with the parametrized showers. ddsim runs this file with separate global and local
+# namespaces, so the functions it calls are bound as default arguments when it is defined
+def setupCerenkovScintFastShower(kernel, optical=setupCerenkovScint, showers=setupToyFastShower):
+     optical(kernel)
+     showers(kernel)
+     return None
+
+# Replays showers from a frozen shower library built with tools/ToyShowerLibraryBuilder
+# Particles whose library bin holds no showers are simulated normally
+def setupToyShowerLibrary(kernel):
+     from DDG4 import DetectorConstruction, PhysicsList
+     from g4units import GeV
+     model = DetectorConstruction(kernel, 'ToyShowerLibraryModel/ToyShowerLibrary')
+     model.RegionName          = 'ToyCalorimeterRegion'
+     model.Library             = 'showers.lib'
+     model.Detector            = 'MyToyCalorimeter'
+     model.ApplicableParticles = ['e+', 'e-', 'gamma']
+     model.Etrigger            = {'e+': 1*GeV, 'e-': 1*GeV, 'gamma': 1*GeV}
+     model.enableUI()
+     kernel.detectorConstruction().adopt(model)
+
+     fast = PhysicsList(kernel, 'Geant4FastPhysics/FastPhysicsList')
+     fast.EnabledParticles = ['e+', 'e-', 'gamma']
+     fast.enableUI()
+     kernel.physicsList().adopt(fast)
+
+     return None
+
+# Optical physics together with the shower library, see setupCerenkovScintFastShower
+def setupCerenkovScintShowerLibrary(kernel, optical=setupCerenkovScint, showers=setupToyShowerLibrary):
+     optical(kernel)
+     showers(kernel)
+     return None
+
+# Sets up a custom EDM4hep output for the ToyCalorimeter if using custom readout, returns the output action
 def setupEDM4hepOutputToyCalo(dd4hepSimulation):
      from DDG4 import EventAction, Kernel
      dd = dd4hepSimulation
      evt_edm4hep = EventAction(Kernel(),'Geant4EDM4ToyReadout/'+dd.outputFile,True)
+     # Multi-threaded jobs: use one readout per worker (not shared) feeding a single writer thread through
+     # a bounded queue; workers only wait when WriterQueueDepth events are already waiting to be written
+     # evt_edm4hep = EventAction(Kernel(),'Geant4EDM4ToyReadout/'+dd.outputFile,False)
+     # evt_edm4hep.AsyncWriter = True
+     # evt_edm4hep.WriterQueueDepth = 16
+     # Or one file per worker, e.g. output.t003.root, joined afterwards in event-number order with
+     #   ToyMergeOutput -o output.root output.t*.root
+     # evt_edm4hep = EventAction(Kernel(),'Geant4EDM4ToyReadout/'+dd.outputFile,False)
+     # evt_edm4hep.FilePerThread = True
+     # Output format: TTree (default) or RNTuple (build with -DTOYCALO_USE_RNTUPLE=ON); compression ZSTD, LZ4,
+     # LZMA or ZLIB with its level and the TTree flush size in bytes, TTree only: RNTuple output uses the podio
+     # defaults and fails at the start of the run if any of them is set. Compare them with ToyIOBenchmark
+     # evt_edm4hep.OutputBackend = 'TTree'
+     # evt_edm4hep.Compression = 'ZSTD'
+     # evt_edm4hep.CompressionLevel = 5
+     # evt_edm4hep.FlushSize = 30000000
+     # Smaller ToyCalorimeter hits: CompactToyCalorimeterHit without position (the cell positions are written
+     # once to the metadata, see CellPositionTable in eventdisplay.py and ToyCellPositionTable.h), zero suppression
+     # and energies rounded to fewer mantissa bits (23 keeps full float precision, 10 is about 0.05%).
+     # ToyDigitizer, ToyClustering, ToyCaloAnalysis and ToyDisplayExport read compact hits as well
+     # evt_edm4hep.CompactHits = True
+     # evt_edm4hep.EnergyThreshold = 10*keV
+     # evt_edm4hep.EnergyMantissaBits = 10
+     # The calorimeter hits are digitized afterwards with noise, ADC and thresholds by
+     #   ToyDigitizer --compact ToyCalorimeter.xml -o digi.root --threads 8 output.root
+     # (noise only on cells with a simulated hit; the hit times come from the contributions, so they need
+     # SaveContributions=True)
+     # and clustered (topological clusters over the neighbour table of ToySegmentation) by
+     #   ToyClustering --compact ToyCalorimeter.xml -o clusters.root --threads 8 digi.root
+     # The standard histograms (total energy, phi-sector profile, MC matching) come from
+     #   ToyCaloAnalysis -o histograms.root --threads 8 output.root
+     # For the event display, events are exported once to a memory-mapped file with levels of detail
+     # (ToyDisplayFile and DetPlot.loadDisplayEvent in eventdisplay.py)
+     #   ToyDisplayExport -o display.bin output.root
      evt_edm4hep.Control = True
      output = dd.outputFile
      if not dd.outputFile.endswith(dd.outputConfig.myExtension):
@@ -46,7 +134,18 @@ def setupEDM4hepOutputToyCalo(dd4hepSimulation):
      evt_edm4hep.EventParametersString, evt_edm4hep.EventParametersInt, evt_edm4hep.EventParametersFloat = eventPars
      evt_edm4hep.RunNumberOffset = dd.meta.runNumberOffset if dd.meta.runNumberOffset > 0 else 0
      evt_edm4hep.EventNumberOffset = dd.meta.eventNumberOffset if dd.meta.eventNumberOffset > 0 else 0
-     return None
+     # Merge the written MC contributions per (saved MC particle, PDG, time bin in ns)
+     # evt_edm4hep.MergeContributions = True
+     # evt_edm4hep.ContributionTimeBin = 1.0
+     # Write only primaries, particles with calorimeter contributions and particles passing the energy or
+     # generation cut; the others are replaced by their nearest written ancestor in the MCParticle graph
+     # Contributors are only known with SaveContributions = True on the ToyCalorimeter action (see below),
+     # the output warns at the start of the run otherwise
+     # evt_edm4hep.PruneParticles = True
+     # evt_edm4hep.KeepCalorimeterContributors = True
+     # evt_edm4hep.KeepEnergyCut = 1*GeV
+     # evt_edm4hep.KeepGenerations = 1
+     return evt_edm4hep
 
 # See DD4hep/DDG4/python/DDSim/DD4hepSimulation.py
 SIM = DD4hepSimulation()
@@ -112,6 +211,42 @@ SIM.filter.mapDetFilter['MyToyCalorimeter']   = 'edep'
 # If using a custom hit class
 # SIM.action.mapActions["MyToyCalorimeter"]     = "ToyCalorimeter_SDAction_Custom"
 
+# Either custom action can sum deposits in a dense per-thread cell array and create the hits at
+# the end of the event, instead of looking up the hit on every step
+# SIM.action.mapActions["MyToyCalorimeter"]     = ("ToyCalorimeter_SDAction", {"DenseAccumulation": True})
+
+# Hits are taken from a per-thread pool. CountHits prints, for every event, how many hits came
+# from the pool and how many new pool pages (heap allocations) were needed for them. Counting is per thread;
+# while it is on, ToyCaloHit instances are also counted by dd4hep::InstanceCount
+# SIM.action.mapActions["MyToyCalorimeter"]     = ("ToyCalorimeter_SDAction", {"CountHits": True})
+
+# HotPathCounters counts the steps (and those below the 0.1 MeV threshold), fast simulation spots, hits
+# created and updated and the time spent in process(), per thread. The run frame of the output holds them as
+# <action>__Steps, __StepsBelowThreshold, __FastSimSpots, __HitsCreated, __HitsUpdated and __ProcessSeconds,
+# one entry per thread listed in <action>__Threads. The counts are doubles (with podio versions without double
+# parameters: ints holding the low 31 bits, the bits above in <name>High, e.g. __StepsHigh). With FilePerThread
+# each file holds its own thread, ToyMergeOutput joins the entries of all files of a run.
+# Off by default, then no counting or clock reads are done.
+# SIM.action.mapActions["MyToyCalorimeter"]     = ("ToyCalorimeter_SDAction", {"HotPathCounters": True})
+
+# MC step contributions: shower steps are kept under the particle that entered the calorimeter (the output
+# maps it to its written MCParticle); steps of the same ancestor, PDG code and time bin (ns) are merged, and
+# each hit keeps at most MaxContributions (0 = no limit). A full hit adds new steps to the same ancestor;
+# other energy goes to one contribution without an MC particle
+# SIM.action.mapActions["MyToyCalorimeter"]     = ("ToyCalorimeter_SDAction", {"SaveContributions": True,
+#                                                                              "MaxContributions": 16,
+#                                                                              "ContributionTimeBin": 1.0})
+
+# Parametrized optical photons: ToyOpticalPhotonKiller kills the optical photons when they are created, and the
+# custom action adds edep x SCINTILLATIONYIELD x collection efficiency to yourInterestingQuantity instead.
+# CollectionEfficiency is binned along the crystal length; fill it from a run with full photon tracking.
+# With CountPhotons the killer prints the photons it killed per creator process at the end of the job;
+# benchmarks/measurements/measure_optical.py compares them with the parametrized sum
+# SIM.action.stack = [ { "name": "ToyOpticalPhotonKiller/OpticalPhotonKiller" } ]
+# SIM.action.stack = [ { "name": "ToyOpticalPhotonKiller/OpticalPhotonKiller", "parameter": {"CountPhotons": True} } ]
+# SIM.action.mapActions["MyToyCalorimeter"]     = ("ToyCalorimeter_SDAction_Custom", {"ParametrizedPhotons": True,
+#                                                                                     "CollectionEfficiency": [1.0]})
+
 #~~~~~~~~~~~~~~ MC Particle handling ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 SIM.part.keepAllParticles                  = False
 SIM.part.minimalKineticEnergy              = 100*MeV
@@ -139,6 +274,17 @@ SIM.physics.rejectPDGs = {1, 2, 3, 4, 5, 6,
 SIM.physics.zeroTimePDGs = {17, 11, 13, 15}
 SIM.physics.setupUserPhysics(settings['opticalPhysics'])
 
+# Parametrized EM showers in the calorimeter region (works with both ToyCalorimeter SD actions).
+# setupUserPhysics holds a single function, so replace the call above (and keep the optical physics) with
+# SIM.physics.setupUserPhysics(setupCerenkovScintFastShower)
+# or, without optical physics,
+# SIM.physics.setupUserPhysics(setupToyFastShower)
+
+# Showers replayed from a frozen shower library, again replacing the call above
+# SIM.physics.setupUserPhysics(setupCerenkovScintShowerLibrary)
+# or, without optical physics,
+# SIM.physics.setupUserPhysics(setupToyShowerLibrary)
+
 #~~~~~~~~~~~~~~ Random Generator ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 SIM.random.enableEventSeed = False
 SIM.random.file            = None
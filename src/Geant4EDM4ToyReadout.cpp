@@ -1,84 +1,8 @@
-#ifndef DD4HEP_DDG4_CustomEDM4HepReadout_H
-#define DD4HEP_DDG4_CustomEDM4HepReadout_H
-#include <DD4hep/Detector.h>
-#include <DDG4/EventParameters.h>
-#include <DDG4/Geant4OutputAction.h>
-#include <DDG4/RunParameters.h>
-#include <edm4hep/MCParticleCollection.h>
-#include <edm4hep/SimTrackerHitCollection.h>
-#include <edm4hep/SimCalorimeterHitCollection.h>
-#include <edm4hep/CaloHitContributionCollection.h>
-#include <edm4toy/SimToyCalorimeterHitCollection.h>
-#include "ToyCaloHit.h"
-
-#include <podio/Frame.h>
-#include <podio/podioVersion.h>
-#include <podio/ROOTWriter.h>
-
+#include "Geant4EDM4ToyReadout.h"
 
 namespace dd4hep {
-
-  class ComponentCast;
-
   namespace sim {
 
-    class Geant4ParticleMap;
- 
-    class Geant4EDM4ToyReadout : public Geant4OutputAction  {
-      protected:
-        using writer_t = podio::ROOTWriter;
-        using stringmap_t = std::map< std::string, std::string >;
-        using trackermap_t = std::map< std::string, edm4hep::SimTrackerHitCollection >;
-
-        using calorimeterpair_t = std::pair< edm4hep::SimCalorimeterHitCollection, edm4hep::CaloHitContributionCollection >;
-        using calorimetermap_t = std::map< std::string, calorimeterpair_t >;
-
-        using toycalopair_t = std::pair< edm4toy::SimToyCalorimeterHitCollection, edm4hep::CaloHitContributionCollection >;
-        using toycalomap_t = std::map< std::string, toycalopair_t >;
-
-        std::unique_ptr<writer_t>     m_file  { };
-        podio::Frame                  m_frame { };
-        edm4hep::MCParticleCollection m_particles { };
-        trackermap_t                  m_trackerHits;
-        
-        calorimetermap_t              m_calorimeterHits;
-        toycalomap_t                  m_toycaloHits;
-
-        stringmap_t                   m_runHeader;
-        stringmap_t                   m_eventParametersInt;
-        stringmap_t                   m_eventParametersFloat;
-        stringmap_t                   m_eventParametersString;
-        stringmap_t                   m_cellIDEncodingStrings{};
-        std::string                   m_section_name      { "events" };
-        int                           m_runNo             { 0 };
-        int                           m_runNumberOffset   { 0 };
-        int                           m_eventNo           { 0 };
-        int                           m_eventNumberOffset { 0 };
-        bool                          m_filesByRun        { false };
-        
-        void saveParticles(Geant4ParticleMap* particles);
-        void saveFileMetaData();
-
-      public:
-        Geant4EDM4ToyReadout(Geant4Context* ctxt, const std::string& nam);
-        virtual ~Geant4EDM4ToyReadout();
-        virtual void beginRun(const G4Run* run);
-        virtual void endRun(const G4Run* run);
-        virtual void saveRun(const G4Run* run);
-        virtual void saveEvent( OutputContext<G4Event>& ctxt);
-        virtual void saveCollection( OutputContext<G4Event>& ctxt, G4VHitsCollection* collection);
-        virtual void commit( OutputContext<G4Event>& ctxt);
-        virtual void begin(const G4Event* event);
-      protected:
-      template <typename T>
-      void saveEventParameters(const std::map<std::string, std::string >& parameters)   {
-        for(const auto& p : parameters)   {
-          info("Saving event parameter: %-32s = %s", p.first.c_str(), p.second.c_str());
-          m_frame.putParameter(p.first, p.second);
-        }
-      }
-    };
-    
     template <> void EventParameters::extractParameters(podio::Frame& frame)   {
       for(auto const& p: this->intParameters()) {
         printout(DEBUG, "Geant4OutputEDM4hep", "Saving event parameter: %s", p.first.c_str());
@@ -123,7 +47,6 @@ namespace dd4hep {
 
   }   
 }     
-#endif
 
 #include <DD4hep/InstanceCount.h>
 #include <DD4hep/VolumeManager.h>
@@ -141,8 +64,14 @@ namespace dd4hep {
 #include <G4ParticleDefinition.hh>
 #include <G4VProcess.hh>
 #include <G4Event.hh>
+#include <G4HCofThisEvent.hh>
 #include <G4Run.hh>
 #include <CLHEP/Units/SystemOfUnits.h>
+#include <TROOT.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "ToySegmentation.h"
 #include <edm4hep/EventHeaderCollection.h>
 
 using namespace dd4hep::sim;
@@ -167,6 +96,22 @@ Geant4EDM4ToyReadout::Geant4EDM4ToyReadout(Geant4Context* ctxt, const std::strin
   declareProperty("EventNumberOffset",     m_eventNumberOffset);
   declareProperty("SectionName",           m_section_name);
   declareProperty("FilesByRun",            m_filesByRun);
+  declareProperty("MergeContributions",    m_mergeContributions);
+  declareProperty("ContributionTimeBin",   m_contributionTimeBin);
+  declareProperty("AsyncWriter",           m_asyncWriter);
+  declareProperty("WriterQueueDepth",      m_writerQueueDepth);
+  declareProperty("FilePerThread",         m_filePerThread);
+  declareProperty("OutputBackend",         m_writerOptions.backend);
+  declareProperty("Compression",           m_writerOptions.compression);
+  declareProperty("CompressionLevel",      m_writerOptions.level);
+  declareProperty("FlushSize",             m_writerOptions.flushSize);
+  declareProperty("CompactHits",           m_hitReduction.compact);
+  declareProperty("EnergyThreshold",       m_hitReduction.threshold);
+  declareProperty("EnergyMantissaBits",    m_hitReduction.energyBits);
+  declareProperty("PruneParticles",        m_pruneParticles);
+  declareProperty("KeepCalorimeterContributors", m_keepCalorimeterContributors);
+  declareProperty("KeepEnergyCut",         m_keepEnergyCut);
+  declareProperty("KeepGenerations",       m_keepGenerations);
   info("Writer is now instantiated ..." );
   InstanceCount::increment(this);
 }
@@ -178,7 +123,13 @@ Geant4EDM4ToyReadout::~Geant4EDM4ToyReadout()  {
 }
 
 void Geant4EDM4ToyReadout::beginRun(const G4Run* run)  {
-  G4AutoLock protection_lock(&action_mutex);
+  if ( m_pruneParticles && m_keepCalorimeterContributors && noContributionsSaved() )   {
+    warning("+++ PruneParticles keeps calorimeter contributors, but no ToyCalorimeter sensitive action has "
+            "SaveContributions = True: only primaries and particles passing the cuts are written");
+  }
+  // Per-thread instances in async or file-per-thread mode share no state
+  G4AutoLock protection_lock(&action_mutex, std::defer_lock);
+  if ( sharedWriter() ) protection_lock.lock();
   std::string fname = m_output;
   m_runNo = run->GetRunID();
   if ( m_filesByRun )    {
@@ -187,12 +138,30 @@ void Geant4EDM4ToyReadout::beginRun(const G4Run* run)  {
       fname = m_output.substr(0, idx) + _toString(m_runNo, ".run%08d") + m_output.substr(idx);
     }
   }
-  if ( !fname.empty() )   {
-    m_file = std::make_unique<podio::ROOTWriter>(fname);
-    if ( !m_file )   {
-      fatal("+++ Failed to open output file: %s", fname.c_str());
+  if ( m_filePerThread )   {
+    // Same scheme as FilesByRun: output.run00000000.t002.root, the master of a sequential job writes t000
+    std::size_t idx = fname.rfind(".");
+    int thread = std::max(0, G4Threading::G4GetThreadId());
+    if ( idx != std::string::npos )
+      fname = fname.substr(0, idx) + _toString(thread, ".t%03d") + fname.substr(idx);
+    else
+      fname += _toString(thread, ".t%03d");
+    ROOT::EnableThreadSafety();
+  }
+  try   {
+    if ( !fname.empty() && m_asyncWriter )   {
+      m_asyncFile = ToyAsyncFrameWriter::acquire(fname, m_writerQueueDepth, m_writerOptions);
+    }
+    else if ( !fname.empty() )   {
+      m_file = ToyFrameWriter::create(fname, m_writerOptions);
+      if ( !m_file )   {
+        fatal("+++ Failed to open output file: %s", fname.c_str());
+      }
+      printout( INFO, "Geant4EDM4ToyReadout" ,"Opened %s for output (%s)", fname.c_str(), m_writerOptions.backend.c_str() ) ;
     }
-    printout( INFO, "Geant4EDM4ToyReadout" ,"Opened %s for output", fname.c_str() ) ;
+  }
+  catch (const std::exception& e)   {
+    except("+++ Cannot open output file %s: %s", fname.c_str(), e.what());
   }
 }
 
@@ -203,39 +172,66 @@ void Geant4EDM4ToyReadout::endRun(const G4Run* run)  {
     m_file->finish();
     m_file.reset();
   }
+  // The last worker to release the writer drains the queue and finishes the file
+  m_asyncFile.reset();
 }
 
 void Geant4EDM4ToyReadout::saveFileMetaData() {
-  podio::Frame metaFrame{};
+  ToyMetadata metadata = m_positionTables;
   for (const auto& [name, encodingStr] : m_cellIDEncodingStrings) {
-    metaFrame.putParameter(name + "__CellIDEncoding", encodingStr);
+    metadata.strings.emplace(name + "__CellIDEncoding", encodingStr);
+  }
+  if ( m_asyncFile )   {
+    m_asyncFile->addMetadata(metadata);
+    return;
   }
 
+  podio::Frame metaFrame{};
+  metadata.fill(metaFrame);
   m_file->writeFrame(metaFrame, "metadata");
 }
 
+/// The table is indexed by ToySegmentation::cellIndex(). Readers compute that index from the cell ID with
+/// <name>__CellIndexFields and <name>__CellIndexExtents (a mixed-radix number, least significant field first)
+/// and look up <name>__CellPositionX/Y/Z in mm.
+void Geant4EDM4ToyReadout::addPositionTable(const std::string& name, const DDSegmentation::ToySegmentation& segmentation)  {
+  if ( m_positionTables.floats.count(name + "__CellPositionX") ) return;
+  std::string fields;
+  std::vector<int> extents;
+  for (const auto& [field, extent] : segmentation.cellIndexLayout())   {
+    fields += (fields.empty() ? "" : ",") + field;
+    extents.push_back(int(extent));
+  }
+  const std::size_t nCells = segmentation.numberOfCells();
+  std::vector<float> x(nCells), y(nCells), z(nCells);
+  for (std::size_t i=0; i < nCells; ++i)   {
+    const auto pos = segmentation.position(segmentation.cellIDOfIndex(long(i)));
+    x[i] = float(pos.x());
+    y[i] = float(pos.y());
+    z[i] = float(pos.z());
+  }
+  m_positionTables.strings[name + "__CellIndexFields"]  = fields;
+  m_positionTables.ints[name + "__CellIndexExtents"]    = std::move(extents);
+  m_positionTables.floats[name + "__CellPositionX"]     = std::move(x);
+  m_positionTables.floats[name + "__CellPositionY"]     = std::move(y);
+  m_positionTables.floats[name + "__CellPositionZ"]     = std::move(z);
+  info("+++ Compact hits in %s: %zu cell positions stored in the metadata", name.c_str(), nCells);
+}
+
 void Geant4EDM4ToyReadout::commit( OutputContext<G4Event>& /* ctxt */)   {
-  if ( m_file )   {
-    G4AutoLock protection_lock(&action_mutex);
+  if ( m_file || m_asyncFile )   {
+    G4AutoLock protection_lock(&action_mutex, std::defer_lock);
+    if ( sharedWriter() ) protection_lock.lock();
     m_frame.put( std::move(m_particles), "MCParticles");
-    for (auto it = m_trackerHits.begin(); it != m_trackerHits.end(); ++it)   {
-      m_frame.put( std::move(it->second), it->first);
-    }
-    for (auto& [colName, calorimeterHits] : m_calorimeterHits) {
-      m_frame.put( std::move(calorimeterHits.first), colName);
-      m_frame.put( std::move(calorimeterHits.second), colName + "Contributions");
-    }
-    for (auto& [colName, calorimeterHits] : m_toycaloHits) {
-      m_frame.put( std::move(calorimeterHits.first), colName);
-      m_frame.put( std::move(calorimeterHits.second), colName + "Contributions");
+    for (auto& [colName, coll] : m_hitCollections) {
+      m_frame.put( std::move(coll), colName);
     }
 
-    m_file->writeFrame(m_frame, m_section_name);
+    // Async mode: the frame is compressed and written by the writer thread, this only waits if the queue is full
+    if ( m_asyncFile ) m_asyncFile->push(std::move(m_frame), m_section_name);
+    else m_file->writeFrame(m_frame, m_section_name);
     m_particles.clear();
-    m_trackerHits.clear();
-
-    m_calorimeterHits.clear();
-    m_toycaloHits.clear();
+    m_hitCollections.clear();
     
     m_frame = {};
     return;
@@ -244,7 +240,9 @@ void Geant4EDM4ToyReadout::commit( OutputContext<G4Event>& /* ctxt */)   {
 }
 
 void Geant4EDM4ToyReadout::saveRun(const G4Run* run)   {
-  G4AutoLock protection_lock(&action_mutex);
+  // The async writer keeps the run frame pushed last, which must include the counters of all earlier workers
+  G4AutoLock protection_lock(&action_mutex, std::defer_lock);
+  if ( sharedWriter() || m_asyncFile ) protection_lock.lock();
   podio::Frame runHeader  {};
   for (const auto& [key, value] : m_runHeader)
     runHeader.putParameter(key, value);
@@ -259,111 +257,215 @@ void Geant4EDM4ToyReadout::saveRun(const G4Run* run)   {
   if ( parameters ) {
     parameters->extractParameters(runHeader);
   }
+  saveHotPathCounters(runHeader, run->GetRunID());
+
+  if ( m_asyncFile ) m_asyncFile->pushRun(m_runNo, std::move(runHeader));
+  else m_file->writeFrame(runHeader, "runs");
+}
 
-  m_file->writeFrame(runHeader, "runs");
+/// Counters of the sensitive actions with HotPathCounters = True, one entry per worker thread that has finished
+/// events of this run: <action>__Threads, __Steps, __StepsBelowThreshold, __FastSimSpots, __HitsCreated,
+/// __HitsUpdated and __ProcessSeconds. Counts are doubles, exact up to 2^53.
+/// With FilePerThread every file holds the entry of its own thread only; ToyMergeOutput joins the entries of
+/// all files of a run, so the totals of a job are the sums over the entries of the merged file.
+void Geant4EDM4ToyReadout::saveHotPathCounters(podio::Frame& runHeader, int runID) const  {
+  // Counts of long runs pass INT_MAX: where podio has no double parameters they are written as the low 31 bits
+  // in <name> and the bits above in <name>High
+  auto putCounts = [&runHeader](const std::string& name, const std::vector<long>& counts)  {
+    #if podio_VERSION_MAJOR > 0 || podio_VERSION_MINOR > 16 || podio_VERSION_PATCH > 2
+    runHeader.putParameter(name, std::vector<double>(counts.begin(), counts.end()));
+    #else
+    std::vector<int> low, high;
+    for (const long n : counts)   {
+      low.push_back(int(n & 0x7fffffffL));
+      high.push_back(int(n >> 31));
+    }
+    runHeader.putParameter(name, std::move(low));
+    runHeader.putParameter(name + "High", std::move(high));
+    #endif
+  };
+  for (const auto& [action, threads] : ToySDCounterRegistry::counters(runID))   {
+    std::vector<int> thread;
+    std::vector<long> steps, belowThreshold, spots, created, updated;
+    #if podio_VERSION_MAJOR > 0 || podio_VERSION_MINOR > 16 || podio_VERSION_PATCH > 2
+    std::vector<double> seconds;
+    #else
+    std::vector<float> seconds;
+    #endif
+    ToySDCounters total;
+    for (const auto& [id, c] : threads)   {
+      // Other workers write their own file, and may not have finished the run yet
+      if ( m_filePerThread && id != std::max(0, G4Threading::G4GetThreadId()) ) continue;
+      thread.push_back(id);
+      steps.push_back(c.steps);
+      belowThreshold.push_back(c.belowThreshold);
+      spots.push_back(c.spots);
+      created.push_back(c.hitsCreated);
+      updated.push_back(c.hitsUpdated);
+      seconds.push_back(std::chrono::duration<double>(c.processTime).count());
+      total.merge(c);
+    }
+    if ( thread.empty() ) continue;
+    runHeader.putParameter(action + "__Threads",             std::move(thread));
+    putCounts(action + "__Steps",               steps);
+    putCounts(action + "__StepsBelowThreshold", belowThreshold);
+    putCounts(action + "__FastSimSpots",        spots);
+    putCounts(action + "__HitsCreated",         created);
+    putCounts(action + "__HitsUpdated",         updated);
+    runHeader.putParameter(action + "__ProcessSeconds",      std::move(seconds));
+    info("+++ %s: %ld steps (%ld below threshold), %ld spots, %ld hits created, %ld updated, %.3f s in process()",
+         action.c_str(), total.steps, total.belowThreshold, total.spots, total.hitsCreated, total.hitsUpdated,
+         std::chrono::duration<double>(total.processTime).count());
+  }
 }
 
 void Geant4EDM4ToyReadout::begin(const G4Event* event)  {
   m_eventNo = event->GetEventID();
   m_frame = {};
   m_particles = {};
-  m_trackerHits.clear();
+  m_particleIndex.clear();
+  m_hitCollections.clear();
+}
 
-  m_calorimeterHits.clear();
-  m_toycaloHits.clear();
+/// Mark the particles that deposited energy in a calorimeter hit of this event
+void Geant4EDM4ToyReadout::markCalorimeterContributors(const G4Event* event, Geant4ParticleMap* pm, std::vector<char>& keep) const  {
+  G4HCofThisEvent* hce = event ? event->GetHCofThisEvent() : nullptr;
+  if ( !hce ) return;
+  auto mark = [&](const Geant4HitData::Contributions& truth)  {
+    for( const auto& c : truth )  {
+      if ( c.trackID == kUnattributedTrack ) continue;
+      int id = pm->particleID(c.trackID);
+      if ( id >= 0 && std::size_t(id) < keep.size() ) keep[id] = 1;
+    }
+  };
+  for( G4int i=0; i < hce->GetNumberOfCollections(); ++i )  {
+    auto* coll = dynamic_cast<Geant4HitCollection*>(hce->GetHC(i));
+    if ( !coll ) continue;
+    if ( typeid( ToyCaloHit ) == coll->type().type() )  {
+      for( std::size_t j=0; j < coll->GetSize(); ++j )  {
+        const ToyCaloHit* hit = coll->hit(j);
+        mark(hit->truth);
+      }
+    }
+    else if ( typeid( Geant4Calorimeter::Hit ) == coll->type().type() )  {
+      for( std::size_t j=0; j < coll->GetSize(); ++j )  {
+        const Geant4Calorimeter::Hit* hit = coll->hit(j);
+        mark(hit->truth);
+      }
+    }
+  }
 }
 
-void Geant4EDM4ToyReadout::saveParticles(Geant4ParticleMap* particles)    {
+/// Convert the particle map in one pass over the particles.
+/// Particle IDs are dense (Geant4ParticleHandler renumbers the kept particles in creation order, so parents
+/// come before their daughters), which allows flat vectors instead of ID maps.
+/// With PruneParticles only primaries, calorimeter contributors and particles passing the energy or
+/// generation cut are written. Every other particle is represented by its nearest written ancestor:
+/// its daughters are attached to that ancestor and its hit contributions point to it.
+void Geant4EDM4ToyReadout::saveParticles(Geant4ParticleMap* particles, const G4Event* event)    {
   typedef detail::ReferenceBitMask<const int> PropertyMask;
   typedef Geant4ParticleMap::ParticleMap ParticleMap;
   const ParticleMap& pm = particles->particleMap;
 
   m_particles.clear();
-  if ( pm.size() > 0 )  {
-    size_t cnt = 0;
-    std::map<int,int> p_ids;
-    std::vector<const Geant4Particle*> p_part;
-    p_part.reserve(pm.size());
-    for (const auto& iParticle : pm) {
-      int id = iParticle.first;
-      const Geant4ParticleHandle p = iParticle.second;
-      PropertyMask mask(p->status);
-      const G4ParticleDefinition* def = p.definition();
-      auto mcp = m_particles.create();
-      mcp.setPDG(p->pdgID);
-
-      float ps_fa[3] = {float(p->psx/CLHEP::GeV),float(p->psy/CLHEP::GeV),float(p->psz/CLHEP::GeV)};
-      mcp.setMomentum( ps_fa );
-
-      float pe_fa[3] = {float(p->pex/CLHEP::GeV),float(p->pey/CLHEP::GeV),float(p->pez/CLHEP::GeV)};
-      mcp.setMomentumAtEndpoint( pe_fa );
-
-      double vs_fa[3] = { p->vsx/CLHEP::mm, p->vsy/CLHEP::mm, p->vsz/CLHEP::mm } ;
-      mcp.setVertex( vs_fa );
-
-      double ve_fa[3] = { p->vex/CLHEP::mm, p->vey/CLHEP::mm, p->vez/CLHEP::mm } ;
-      mcp.setEndpoint( ve_fa );
-
-      mcp.setTime(p->time/CLHEP::ns);
-      mcp.setMass(p->mass/CLHEP::GeV);
-      mcp.setCharge(def ? def->GetPDGCharge() : 0); 
-
-      mcp.setGeneratorStatus(0);
-      if( p->genStatus ) {
-        mcp.setGeneratorStatus( p->genStatus ) ;
-      } else {
-        if ( mask.isSet(G4PARTICLE_GEN_STABLE) )             mcp.setGeneratorStatus(1);
-        else if ( mask.isSet(G4PARTICLE_GEN_DECAYED) )       mcp.setGeneratorStatus(2);
-        else if ( mask.isSet(G4PARTICLE_GEN_DOCUMENTATION) ) mcp.setGeneratorStatus(3);
-        else if ( mask.isSet(G4PARTICLE_GEN_BEAM) )          mcp.setGeneratorStatus(4);
-        else if ( mask.isSet(G4PARTICLE_GEN_OTHER) )         mcp.setGeneratorStatus(9);
-      }
-
-      mcp.setCreatedInSimulation(         mask.isSet(G4PARTICLE_SIM_CREATED) );
-      mcp.setBackscatter(                 mask.isSet(G4PARTICLE_SIM_BACKSCATTER) );
-      mcp.setVertexIsNotEndpointOfParent( mask.isSet(G4PARTICLE_SIM_PARENT_RADIATED) );
-      mcp.setDecayedInTracker(            mask.isSet(G4PARTICLE_SIM_DECAY_TRACKER) );
-      mcp.setDecayedInCalorimeter(        mask.isSet(G4PARTICLE_SIM_DECAY_CALO) );
-      mcp.setHasLeftDetector(             mask.isSet(G4PARTICLE_SIM_LEFT_DETECTOR) );
-      mcp.setStopped(                     mask.isSet(G4PARTICLE_SIM_STOPPED) );
-      mcp.setOverlay(                     false );
-
-      if( mcp.isCreatedInSimulation() )
-        mcp.setGeneratorStatus( 0 )  ;
-
-      mcp.setSpin(p->spin);
+  m_particleIndex.clear();
+  if ( pm.empty() ) return;
+
+  const std::size_t nIds = std::max(pm.rbegin()->first + 1, 0);
+  std::vector<char> keep(nIds, m_pruneParticles ? 0 : 1);
+  std::vector<int>  generation(nIds, 0);
+  if ( m_pruneParticles && m_keepCalorimeterContributors ) {
+    markCalorimeterContributors(event, particles, keep);
+  }
 
-      p_ids[id] = cnt++;
-      p_part.push_back(p);
+  std::vector<const Geant4Particle*> p_part;
+  p_part.reserve(pm.size());
+  m_particleIndex.assign(nIds, -1);
+  for (const auto& iParticle : pm) {
+    int id = iParticle.first;
+    const Geant4ParticleHandle p = iParticle.second;
+    PropertyMask mask(p->status);
+    if ( id < 0 ) continue;
+
+    // Generation and nearest written ancestor follow from the (already converted) first parent
+    int parent = p->parents.empty() ? -1 : *p->parents.begin();
+    bool primary = !mask.isSet(G4PARTICLE_SIM_CREATED) || parent < 0;
+    if ( !primary && parent < id ) generation[id] = generation[parent] + 1;
+    if ( m_pruneParticles && !keep[id] ) {
+      keep[id] = primary || generation[id] <= m_keepGenerations || p.energy() >= m_keepEnergyCut;
+    }
+    if ( !keep[id] ) {
+      m_particleIndex[id] = (parent >= 0 && parent < id) ? m_particleIndex[parent] : -1;
+      continue;
+    }
+    m_particleIndex[id] = int(p_part.size());
+    p_part.push_back(p);
+
+    const G4ParticleDefinition* def = p.definition();
+    auto mcp = m_particles.create();
+    mcp.setPDG(p->pdgID);
+
+    float ps_fa[3] = {float(p->psx/CLHEP::GeV),float(p->psy/CLHEP::GeV),float(p->psz/CLHEP::GeV)};
+    mcp.setMomentum( ps_fa );
+
+    float pe_fa[3] = {float(p->pex/CLHEP::GeV),float(p->pey/CLHEP::GeV),float(p->pez/CLHEP::GeV)};
+    mcp.setMomentumAtEndpoint( pe_fa );
+
+    double vs_fa[3] = { p->vsx/CLHEP::mm, p->vsy/CLHEP::mm, p->vsz/CLHEP::mm } ;
+    mcp.setVertex( vs_fa );
+
+    double ve_fa[3] = { p->vex/CLHEP::mm, p->vey/CLHEP::mm, p->vez/CLHEP::mm } ;
+    mcp.setEndpoint( ve_fa );
+
+    mcp.setTime(p->time/CLHEP::ns);
+    mcp.setMass(p->mass/CLHEP::GeV);
+    mcp.setCharge(def ? def->GetPDGCharge() : 0); 
+
+    mcp.setGeneratorStatus(0);
+    if( p->genStatus ) {
+      mcp.setGeneratorStatus( p->genStatus ) ;
+    } else {
+      if ( mask.isSet(G4PARTICLE_GEN_STABLE) )             mcp.setGeneratorStatus(1);
+      else if ( mask.isSet(G4PARTICLE_GEN_DECAYED) )       mcp.setGeneratorStatus(2);
+      else if ( mask.isSet(G4PARTICLE_GEN_DOCUMENTATION) ) mcp.setGeneratorStatus(3);
+      else if ( mask.isSet(G4PARTICLE_GEN_BEAM) )          mcp.setGeneratorStatus(4);
+      else if ( mask.isSet(G4PARTICLE_GEN_OTHER) )         mcp.setGeneratorStatus(9);
     }
 
-    for(size_t i=0; i < p_ids.size(); ++i)   {
-      const Geant4Particle* p = p_part[i];
-      auto q = m_particles[i];
+    mcp.setCreatedInSimulation(         mask.isSet(G4PARTICLE_SIM_CREATED) );
+    mcp.setBackscatter(                 mask.isSet(G4PARTICLE_SIM_BACKSCATTER) );
+    mcp.setVertexIsNotEndpointOfParent( mask.isSet(G4PARTICLE_SIM_PARENT_RADIATED) );
+    mcp.setDecayedInTracker(            mask.isSet(G4PARTICLE_SIM_DECAY_TRACKER) );
+    mcp.setDecayedInCalorimeter(        mask.isSet(G4PARTICLE_SIM_DECAY_CALO) );
+    mcp.setHasLeftDetector(             mask.isSet(G4PARTICLE_SIM_LEFT_DETECTOR) );
+    mcp.setStopped(                     mask.isSet(G4PARTICLE_SIM_STOPPED) );
+    mcp.setOverlay(                     false );
 
-      for (const auto& idau : p->daughters) {
-        const auto k = p_ids.find(idau);
-        if (k == p_ids.end()) {
-          fatal("+++ Particle %d: FAILED to find daughter with ID:%d",p->id,idau);
-          continue;
-        }
-        int iqdau = (*k).second;
-        auto qdau = m_particles[iqdau];
-        q.addToDaughters(qdau);
-      }
+    if( mcp.isCreatedInSimulation() )
+      mcp.setGeneratorStatus( 0 )  ;
 
-      for (const auto& ipar : p->parents) {
-        if (ipar >= 0) { 
-          const auto k = p_ids.find(ipar);
-          if (k == p_ids.end()) {
-            fatal("+++ Particle %d: FAILED to find parent with ID:%d",p->id,ipar);
-            continue;
-          }
-          int iqpar = (*k).second;
-          auto qpar = m_particles[iqpar];
-          q.addToParents(qpar);
-        }
+    mcp.setSpin(p->spin);
+  }
+
+  // Links are built from the daughter side: each written particle is attached to the written stand-in of
+  // each of its parents. Without pruning this reproduces the parent and daughter lists of the particle map.
+  std::vector<int> linked;
+  for(std::size_t i=0; i < p_part.size(); ++i)   {
+    const Geant4Particle* p = p_part[i];
+    auto q = m_particles[i];
+    linked.clear();
+    for (const auto& ipar : p->parents) {
+      if ( ipar < 0 ) continue;
+      int iqpar = particleIndex(ipar);
+      if ( iqpar < 0 || iqpar == int(i) ) {
+        if ( !m_pruneParticles ) fatal("+++ Particle %d: FAILED to find parent with ID:%d",p->id,ipar);
+        continue;
       }
+      if ( std::find(linked.begin(), linked.end(), iqpar) != linked.end() ) continue;
+      linked.push_back(iqpar);
+      auto qpar = m_particles[iqpar];
+      q.addToParents(qpar);
+      qpar.addToDaughters(q);
     }
   }
 }
@@ -403,7 +505,7 @@ void Geant4EDM4ToyReadout::saveEvent(OutputContext<G4Event>& ctxt)  {
   if ( part_map )   {
     print("+++ Saving %d EDM4hep particles....",int(part_map->particleMap.size()));
     if ( part_map->particleMap.size() > 0 )  {
-      saveParticles(part_map);
+      saveParticles(part_map, ctxt.context);
     }
   }
 }
@@ -418,126 +520,232 @@ private:
   Geant4HitCollection* m_coll{nullptr};
 };
 
-void Geant4EDM4ToyReadout::saveCollection(OutputContext<G4Event>& /*ctxt*/, G4VHitsCollection* collection)  {
-  
-  Geant4HitCollection* coll = dynamic_cast<Geant4HitCollection*>(collection);
+/// Write the MC contributions of one hit.
+/// With MergeContributions the contributions are first remapped to the MC particles that are kept
+/// and merged per (particle, PDG, time bin): secondaries that were not stored end up on their saved ancestor.
+template <typename HIT>
+void Geant4EDM4ToyReadout::saveContributions(HIT& sch, const Geant4HitData::Contributions& truth, Geant4ParticleMap* pm,
+                                             edm4hep::CaloHitContributionCollection& contributions, bool detailed)  {
+  Geant4HitData::Contributions merged;
+  const Geant4HitData::Contributions* source = &truth;
+  if ( m_mergeContributions && !truth.empty() ) {
+    ToyContributionPolicy policy;
+    policy.maxContributions = 0;
+    policy.timeBin = m_contributionTimeBin;
+    merged.reserve(truth.size());
+    for( const auto& c : truth ){
+      Geant4HitData::Contribution mapped = c;
+      if ( c.trackID != kUnattributedTrack )  {
+        mapped.trackID = particleIndex(pm->particleID(c.trackID));
+        if ( mapped.trackID < 0 )  {
+          error("+++ Event %d: track %d has no written MCParticle, its contribution is unattributed", m_eventNo, c.trackID);
+          mapped.trackID = kUnattributedTrack;
+        }
+      }
+      addContribution(merged, mapped, policy);
+    }
+    source = &merged;
+  }
+  for( const auto& c : *source ){
+    auto sCaloHitCont = contributions.create();
+    sch.addToContributions( sCaloHitCont );
+
+    sCaloHitCont.setEnergy( c.deposit/CLHEP::GeV );
+    sCaloHitCont.setTime( c.time/CLHEP::ns );
+    // The unattributed energy of a full hit has no particle
+    if ( c.trackID == kUnattributedTrack ) continue;
+    if ( source == &merged )   {
+      sCaloHitCont.setParticle( m_particles[c.trackID] );
+    }
+    else if ( auto mcp = particle(pm, c.trackID) )   {
+      sCaloHitCont.setParticle( *mcp );
+    }
 
-  std::string colName = collection->GetName();
-  if( coll == nullptr ){
-    error(" no Geant4HitCollection:  %s ", colName.c_str());
-    return ;
+    if ( detailed )     {
+      edm4hep::Vector3f p(c.x/CLHEP::mm, c.y/CLHEP::mm, c.z/CLHEP::mm);
+      sCaloHitCont.setPDG( c.pdgID );
+      sCaloHitCont.setStepPosition( p );
+    }
   }
+}
 
-  size_t nhits = collection->GetSize();
+namespace {
 
-  Geant4ParticleMap* pm = context()->event().extension<Geant4ParticleMap>(false);
-  debug("+++ Saving EDM4hep collection %s with %d entries.", colName.c_str(), int(nhits));
+  std::unordered_map<std::type_index, Geant4EDM4ToyReadout::converter_t>& converters()  {
+    static std::unordered_map<std::type_index, Geant4EDM4ToyReadout::converter_t> registry;
+    return registry;
+  }
 
-  m_cellIDEncodingStrings.try_emplace(colName, LazyEncodingExtraction{coll});
+  /// Hit quantities gathered column by column: the unit conversion then runs as plain loops over
+  /// contiguous doubles, which the compiler vectorizes
+  class HitColumns  {
+    std::size_t         m_hits;
+    std::vector<double> m_data;
+  public:
+    HitColumns(std::size_t columns, std::size_t hits) : m_hits(hits), m_data(columns*hits) {}
+    double* operator[](std::size_t column)   { return m_data.data() + column*m_hits; }
+    void toUnit(std::size_t column, double unit)   {
+      double* v = (*this)[column];
+      for (std::size_t i=0; i < m_hits; ++i) v[i] /= unit;
+    }
+  };
 
-  if( typeid( Geant4Tracker::Hit ) == coll->type().type()  ){
-    auto& hits = m_trackerHits[colName];
-    for(unsigned i=0 ; i < nhits ; ++i){
-      auto sth = hits->create();
-      const Geant4Tracker::Hit* hit = coll->hit(i);
-      const Geant4Tracker::Hit::Contribution& t = hit->truth;
-      int   trackID   = pm->particleID(t.trackID);
-      auto  mcp       = m_particles.at(trackID);
-      const auto& mom = hit->momentum;
-      const auto& pos = hit->position;
-      edm4hep::Vector3f();
+  template <typename HIT> std::vector<const HIT*> gatherHits(Geant4HitCollection& coll)  {
+    std::vector<const HIT*> hits(coll.GetSize());
+    for (std::size_t i=0; i < hits.size(); ++i) hits[i] = coll.hit(i);
+    return hits;
+  }
+
+  void convertTrackerHits(Geant4EDM4ToyReadout& output, const std::string& name, Geant4HitCollection& coll, Geant4ParticleMap* pm)  {
+    enum { X, Y, Z, EDEP, LENGTH, TIME, PX, PY, PZ, NCOLUMNS };
+    auto hits = gatherHits<Geant4Tracker::Hit>(coll);
+    HitColumns col(NCOLUMNS, hits.size());
+    for (std::size_t i=0; i < hits.size(); ++i)   {
+      const auto* hit = hits[i];
+      col[X][i]      = hit->position.x();
+      col[Y][i]      = hit->position.y();
+      col[Z][i]      = hit->position.z();
+      col[EDEP][i]   = hit->energyDeposit;
+      col[LENGTH][i] = hit->length;
+      col[TIME][i]   = hit->truth.time;
+      col[PX][i]     = hit->momentum.x();
+      col[PY][i]     = hit->momentum.y();
+      col[PZ][i]     = hit->momentum.z();
+    }
+    for (auto c : {X, Y, Z, LENGTH}) col.toUnit(c, CLHEP::mm);
+    for (auto c : {EDEP, PX, PY, PZ}) col.toUnit(c, CLHEP::GeV);
+    col.toUnit(TIME, CLHEP::ns);
+
+    auto& out = output.outputCollection<edm4hep::SimTrackerHitCollection>(name);
+    for (std::size_t i=0; i < hits.size(); ++i)   {
+      const auto* hit = hits[i];
+      const auto& t   = hit->truth;
+      auto sth = out.create();
       sth.setCellID( hit->cellID ) ;
-      sth.setEDep(hit->energyDeposit/CLHEP::GeV);
-      sth.setPathLength(hit->length/CLHEP::mm);
-      sth.setTime(hit->truth.time/CLHEP::ns);
-      sth.setParticle(mcp);
-      sth.setPosition( {pos.x()/CLHEP::mm, pos.y()/CLHEP::mm, pos.z()/CLHEP::mm} );
-      sth.setMomentum( {float(mom.x()/CLHEP::GeV),float(mom.y()/CLHEP::GeV),float(mom.z()/CLHEP::GeV)} );
-      auto particleIt = pm->particles().find(trackID);
+      sth.setEDep(col[EDEP][i]);
+      sth.setPathLength(col[LENGTH][i]);
+      sth.setTime(col[TIME][i]);
+      if ( auto mcp = output.particle(pm, t.trackID) ) sth.setParticle(*mcp);
+      sth.setPosition( {col[X][i], col[Y][i], col[Z][i]} );
+      sth.setMomentum( {float(col[PX][i]), float(col[PY][i]), float(col[PZ][i])} );
+      auto particleIt = pm->particles().find(pm->particleID(t.trackID));
       if( ( particleIt != pm->particles().end()) ){
         sth.setProducedBySecondary( (particleIt->second->originalG4ID != t.trackID) );
       }
     }
   }
-  else if( typeid( Geant4Calorimeter::Hit ) == coll->type().type() ){
-    Geant4Sensitive* sd = coll->sensitive();
-    int hit_creation_mode = sd->hitCreationMode();
 
-    auto& hits = m_calorimeterHits[colName];
-    
-    for(unsigned i=0 ; i < nhits ; ++i){
-      auto sch = hits.first->create();
-      const Geant4Calorimeter::Hit* hit = coll->hit(i);
-      const auto& pos = hit->position;
-      sch.setCellID( hit->cellID );
-      sch.setPosition({float(pos.x()/CLHEP::mm), float(pos.y()/CLHEP::mm), float(pos.z()/CLHEP::mm)});
-      sch.setEnergy( hit->energyDeposit/CLHEP::GeV );
-
-      for(auto ci=hit->truth.begin(); ci != hit->truth.end(); ++ci){
-
-        auto sCaloHitCont = hits.second->create();
-        sch.addToContributions( sCaloHitCont );
-
-        const Geant4HitData::Contribution& c = *ci;
-        int trackID = pm->particleID(c.trackID);
-        auto mcp = m_particles.at(trackID);
-        sCaloHitCont.setEnergy( c.deposit/CLHEP::GeV );
-        sCaloHitCont.setTime( c.time/CLHEP::ns );
-        sCaloHitCont.setParticle( mcp );
-
-        if ( hit_creation_mode == Geant4Sensitive::DETAILED_MODE )     {
-          edm4hep::Vector3f p(c.x/CLHEP::mm, c.y/CLHEP::mm, c.z/CLHEP::mm);
-          sCaloHitCont.setPDG( c.pdgID );
-          sCaloHitCont.setStepPosition( p );
-        }
+  /// Round a float to the given number of mantissa bits. The zeroed low bits compress away in the output file
+  float reduceMantissa(float value, int bits)  {
+    if ( bits >= 23 ) return value;
+    const int drop = 23 - std::max(bits, 0);
+    uint32_t word;
+    std::memcpy(&word, &value, sizeof(word));
+    word += 1u << (drop - 1);
+    word &= ~((1u << drop) - 1);
+    std::memcpy(&value, &word, sizeof(value));
+    return value;
+  }
+
+  /// Calorimeter hits of DDG4 and of the ToyCalorimeter share everything but the output type.
+  /// Compact output types have no position, the reduction applies to the ToyCalorimeter hits only
+  template <typename HIT, typename COLL, typename EXTRA>
+  void convertCalorimeterHits(Geant4EDM4ToyReadout& output, const std::string& name, Geant4HitCollection& coll,
+                              Geant4ParticleMap* pm, const Geant4EDM4ToyReadout::HitReduction& reduction, EXTRA&& extra)  {
+    enum { X, Y, Z, ENERGY, NCOLUMNS };
+    auto hits = gatherHits<HIT>(coll);
+    HitColumns col(NCOLUMNS, hits.size());
+    for (std::size_t i=0; i < hits.size(); ++i)   {
+      col[X][i]      = hits[i]->position.x();
+      col[Y][i]      = hits[i]->position.y();
+      col[Z][i]      = hits[i]->position.z();
+      col[ENERGY][i] = hits[i]->energyDeposit;
+    }
+    for (auto c : {X, Y, Z}) col.toUnit(c, CLHEP::mm);
+    col.toUnit(ENERGY, CLHEP::GeV);
+
+    // Collections without a sensitive action, as the benchmarks build them, are not detailed
+    const bool detailed = coll.sensitive() && coll.sensitive()->hitCreationMode() == Geant4Sensitive::DETAILED_MODE;
+    auto& out           = output.outputCollection<COLL>(name);
+    auto& contributions = output.outputCollection<edm4hep::CaloHitContributionCollection>(name + "Contributions");
+    for (std::size_t i=0; i < hits.size(); ++i)   {
+      if ( hits[i]->energyDeposit < reduction.threshold ) continue;    // zero suppression
+      auto sch = out.create();
+      sch.setCellID( hits[i]->cellID );
+      if constexpr ( requires { sch.setPosition(edm4hep::Vector3f()); } )   {
+        sch.setPosition({float(col[X][i]), float(col[Y][i]), float(col[Z][i])});
       }
+      sch.setEnergy( reduceMantissa(float(col[ENERGY][i]), reduction.energyBits) );
+      extra(sch, *hits[i]);
+      output.saveContributions(sch, hits[i]->truth, pm, contributions, detailed);
     }
   }
 
-  // Save the ToyCalorimeter custom hits
-  else if( typeid( ToyCaloHit ) == coll->type().type() ){
-    
-    Geant4Sensitive* sd = coll->sensitive();
-    int hit_creation_mode = sd->hitCreationMode();
-    (void)hit_creation_mode; // silence if kept for future
+  /// Converters of the hit types written by this plugin
+  struct DefaultConverters  {
+    DefaultConverters()   {
+      Geant4EDM4ToyReadout::registerConverter(typeid(Geant4Tracker::Hit), convertTrackerHits);
+      Geant4EDM4ToyReadout::registerConverter(typeid(Geant4Calorimeter::Hit),
+        [](Geant4EDM4ToyReadout& output, const std::string& name, Geant4HitCollection& coll, Geant4ParticleMap* pm)  {
+          convertCalorimeterHits<Geant4Calorimeter::Hit, edm4hep::SimCalorimeterHitCollection>(output, name, coll, pm,
+            Geant4EDM4ToyReadout::HitReduction(), [](auto&, const Geant4Calorimeter::Hit&) {});
+        });
+      Geant4EDM4ToyReadout::registerConverter(typeid(ToyCaloHit),
+        [](Geant4EDM4ToyReadout& output, const std::string& name, Geant4HitCollection& coll, Geant4ParticleMap* pm)  {
+          const auto& reduction = output.hitReduction();
+          auto interesting = [](auto& sch, const ToyCaloHit& hit) { sch.setYourInterestingQuantity(hit.yourInterestingQuantity); };
+          if ( !reduction.compact )   {
+            convertCalorimeterHits<ToyCaloHit, edm4toy::SimToyCalorimeterHitCollection>(output, name, coll, pm, reduction, interesting);
+            return;
+          }
+          auto* seg = dynamic_cast<const DDSegmentation::ToySegmentation*>(
+            coll.sensitive()->sensitiveDetector().readout().segmentation().segmentation());
+          if ( !seg || !seg->isFrozen() )   {
+            output.except("+++ CompactHits: the readout of %s has no frozen ToySegmentation", name.c_str());
+          }
+          output.addPositionTable(name, *seg);
+          convertCalorimeterHits<ToyCaloHit, edm4toy::CompactToyCalorimeterHitCollection>(output, name, coll, pm, reduction, interesting);
+        });
+    }
+  } s_defaultConverters;
+}
 
-    auto& hits = m_toycaloHits[colName];
-    
-    for(unsigned i=0 ; i < nhits ; ++i){
-      auto sch = hits.first->create();
-      const ToyCaloHit* hit = coll->hit(i);
-      const auto& pos = hit->position;
+std::optional<edm4hep::MCParticle> Geant4EDM4ToyReadout::particle(Geant4ParticleMap* pm, int trackID)  const  {
+  const int index = particleIndex(pm->particleID(trackID));
+  if ( index < 0 || std::size_t(index) >= m_particles.size() )   {
+    error("+++ Event %d: track %d has no written MCParticle, its link is left empty", m_eventNo, trackID);
+    return std::nullopt;
+  }
+  return m_particles[index];
+}
 
-      sch.setCellID( hit->cellID );
-      sch.setEnergy( hit->energyDeposit/CLHEP::GeV);
-      sch.setPosition({float(pos.x()/CLHEP::mm), float(pos.y()/CLHEP::mm), float(pos.z()/CLHEP::mm)});
+void Geant4EDM4ToyReadout::registerConverter(std::type_index type, converter_t converter)  {
+  converters()[type] = std::move(converter);
+}
 
-      sch.setYourInterestingQuantity(hit->yourInterestingQuantity);
+const Geant4EDM4ToyReadout::converter_t* Geant4EDM4ToyReadout::converter(std::type_index type)  {
+  const auto it = converters().find(type);
+  return it != converters().end() ? &it->second : nullptr;
+}
 
-      // Uncomment if you want to save MC step contributuions
-      
-      // for(auto ci=hit->truth.begin(); ci != hit->truth.end(); ++ci){
+void Geant4EDM4ToyReadout::saveCollection(OutputContext<G4Event>& /*ctxt*/, G4VHitsCollection* collection)  {
+  
+  Geant4HitCollection* coll = dynamic_cast<Geant4HitCollection*>(collection);
 
-      //   auto sCaloHitCont = hits.second->create();
-      //   sch.addToContributions( sCaloHitCont );
+  std::string colName = collection->GetName();
+  if( coll == nullptr ){
+    error(" no Geant4HitCollection:  %s ", colName.c_str());
+    return ;
+  }
 
-      //   const Geant4HitData::MonteCarloContrib& c = *ci;
-    
-      //   int trackID = pm->particleID(c.trackID);
-      //   auto mcp = m_particles.at(trackID);
-    
-      //   sCaloHitCont.setEnergy( c.deposit/CLHEP::GeV );
-      //   sCaloHitCont.setTime( c.time/CLHEP::ns );
-      //   sCaloHitCont.setParticle( mcp );
-        
-      //   edm4hep::Vector3f p(c.x/CLHEP::mm, c.y/CLHEP::mm, c.z/CLHEP::mm);
-    
-      //   sCaloHitCont.setPDG( c.pdgID );
-      //   sCaloHitCont.setStepPosition( p );
-      // }
-    }
-  } 
-  else {
+  Geant4ParticleMap* pm = context()->event().extension<Geant4ParticleMap>(false);
+  debug("+++ Saving EDM4hep collection %s with %d entries.", colName.c_str(), int(collection->GetSize()));
+
+  const converter_t* convert = converter(coll->type().type());
+  if( convert == nullptr ){
     error("+++ unknown type in Geant4HitCollection %s ", coll->type().type().name());
+    return;
   }
+  m_cellIDEncodingStrings.try_emplace(colName, LazyEncodingExtraction{coll});
+  (*convert)(*this, colName, *coll, pm);
 }
@@ -0,0 +1,150 @@
+#ifndef DD4HEP_DDG4_CustomEDM4HepReadout_H
+#define DD4HEP_DDG4_CustomEDM4HepReadout_H
+#include <DD4hep/Detector.h>
+#include <DDG4/EventParameters.h>
+#include <DDG4/Geant4OutputAction.h>
+#include <DDG4/RunParameters.h>
+#include <edm4hep/MCParticleCollection.h>
+#include <edm4hep/SimTrackerHitCollection.h>
+#include <edm4hep/SimCalorimeterHitCollection.h>
+#include <edm4hep/CaloHitContributionCollection.h>
+#include <edm4toy/SimToyCalorimeterHitCollection.h>
+#include <edm4toy/CompactToyCalorimeterHitCollection.h>
+#include "ToyCaloHit.h"
+#include "ToyContributions.h"
+#include "ToyAsyncFrameWriter.h"
+#include "ToyFrameWriter.h"
+#include "ToySDCounters.h"
+
+#include <podio/Frame.h>
+#include <podio/podioVersion.h>
+#include <CLHEP/Units/SystemOfUnits.h>
+
+#include <functional>
+#include <optional>
+#include <typeindex>
+#include <unordered_map>
+
+
+namespace dd4hep {
+
+  class ComponentCast;
+  namespace DDSegmentation { class ToySegmentation; }
+
+  namespace sim {
+
+    class Geant4ParticleMap;
+    class Geant4HitCollection;
+ 
+    class Geant4EDM4ToyReadout : public Geant4OutputAction  {
+      public:
+        /// Size reduction of the ToyCalorimeter hits, applied when they are converted
+        struct HitReduction  {
+          bool   compact    { false };   // CompactHits: no position, cell positions once in the metadata
+          double threshold  { 0 };       // EnergyThreshold: hits with less energy are not written
+          int    energyBits { 23 };      // EnergyMantissaBits: float mantissa bits kept of the hit energy
+        };
+
+      protected:
+        using writer_t = ToyCalorimeter::ToyFrameWriter;
+        using stringmap_t = std::map< std::string, std::string >;
+        using collectionmap_t = std::map< std::string, std::unique_ptr<podio::CollectionBase> >;
+
+        std::unique_ptr<writer_t>     m_file  { };
+        // AsyncWriter: one instance per worker thread, all sharing a writer thread through a bounded queue
+        std::shared_ptr<ToyAsyncFrameWriter> m_asyncFile { };
+        podio::Frame                  m_frame { };
+        edm4hep::MCParticleCollection m_particles { };
+        // Hit and contribution collections filled by the converters, put into the frame at commit
+        collectionmap_t               m_hitCollections;
+
+        stringmap_t                   m_runHeader;
+        stringmap_t                   m_eventParametersInt;
+        stringmap_t                   m_eventParametersFloat;
+        stringmap_t                   m_eventParametersString;
+        stringmap_t                   m_cellIDEncodingStrings{};
+        std::string                   m_section_name      { "events" };
+        int                           m_runNo             { 0 };
+        int                           m_runNumberOffset   { 0 };
+        int                           m_eventNo           { 0 };
+        int                           m_eventNumberOffset { 0 };
+        bool                          m_filesByRun        { false };
+        bool                          m_mergeContributions { false };
+        double                        m_contributionTimeBin { 1.0 };
+        bool                          m_asyncWriter       { false };
+        int                           m_writerQueueDepth  { 16 };
+        // OutputBackend, Compression, CompressionLevel, FlushSize
+        ToyCalorimeter::ToyWriterOptions m_writerOptions { };
+        // FilePerThread: one instance and one output file per worker thread, joined later by ToyMergeOutput
+        bool                          m_filePerThread     { false };
+        HitReduction                  m_hitReduction      { };
+        // Cell position tables of the compact hit collections, written with the metadata
+        ToyCalorimeter::ToyMetadata   m_positionTables    { };
+
+        // Instances writing to the one shared output file serialize on the action mutex
+        bool sharedWriter() const  { return !m_asyncWriter && !m_filePerThread; }
+        
+        // PruneParticles: write primaries, calorimeter contributors and particles passing the cuts only
+        bool                          m_pruneParticles    { false };
+        bool                          m_keepCalorimeterContributors { true };
+        double                        m_keepEnergyCut     { 1*CLHEP::GeV };
+        int                           m_keepGenerations   { 1 };
+        // Particle map ID -> index in m_particles (of the nearest written ancestor for pruned particles)
+        std::vector<int>              m_particleIndex;
+
+        // -1 for IDs outside the map and for pruned particles without a written ancestor
+        int particleIndex(int id) const  {
+          return (id >= 0 && std::size_t(id) < m_particleIndex.size()) ? m_particleIndex[id] : -1;
+        }
+        void markCalorimeterContributors(const G4Event* event, Geant4ParticleMap* pm, std::vector<char>& keep) const;
+        void saveParticles(Geant4ParticleMap* particles, const G4Event* event);
+        void saveFileMetaData();
+        void saveHotPathCounters(podio::Frame& runHeader, int runID) const;
+
+      public:
+        const HitReduction& hitReduction() const  { return m_hitReduction; }
+        /// Store the cell positions of a compact hit collection in the metadata, once per collection
+        void addPositionTable(const std::string& name, const DDSegmentation::ToySegmentation& segmentation);
+
+        /// Converts one Geant4HitCollection into EDM4hep collections of the readout
+        using converter_t = std::function<void(Geant4EDM4ToyReadout& output, const std::string& name,
+                                               Geant4HitCollection& hits, Geant4ParticleMap* pm)>;
+        /// Register the converter of a hit type. Plugins call this at load time, e.g. from a static object
+        static void registerConverter(std::type_index type, converter_t converter);
+        /// Registered converter of a hit type, nullptr if there is none
+        static const converter_t* converter(std::type_index type);
+
+        /// Output collection of the current event, created on first use
+        template <typename COLL> COLL& outputCollection(const std::string& name)   {
+          auto& coll = m_hitCollections[name];
+          if ( !coll ) coll = std::make_unique<COLL>();
+          return static_cast<COLL&>(*coll);
+        }
+        /// Written MC particle of a Geant4 track. Reports an error and returns nothing if the track has none
+        std::optional<edm4hep::MCParticle> particle(Geant4ParticleMap* pm, int trackID)  const;
+        template <typename HIT>
+        void saveContributions(HIT& sch, const Geant4HitData::Contributions& truth, Geant4ParticleMap* pm,
+                               edm4hep::CaloHitContributionCollection& contributions, bool detailed);
+
+        Geant4EDM4ToyReadout(Geant4Context* ctxt, const std::string& nam);
+        virtual ~Geant4EDM4ToyReadout();
+        virtual void beginRun(const G4Run* run);
+        virtual void endRun(const G4Run* run);
+        virtual void saveRun(const G4Run* run);
+        virtual void saveEvent( OutputContext<G4Event>& ctxt);
+        virtual void saveCollection( OutputContext<G4Event>& ctxt, G4VHitsCollection* collection);
+        virtual void commit( OutputContext<G4Event>& ctxt);
+        virtual void begin(const G4Event* event);
+      protected:
+      template <typename T>
+      void saveEventParameters(const std::map<std::string, std::string >& parameters)   {
+        for(const auto& p : parameters)   {
+          info("Saving event parameter: %-32s = %s", p.first.c_str(), p.second.c_str());
+          m_frame.putParameter(p.first, p.second);
+        }
+      }
+    };
+
+  }
+}
+#endif
@@ -0,0 +1,113 @@
+#include "ToyAsyncFrameWriter.h"
+#include <DD4hep/Printout.h>
+#include <TROOT.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+  std::mutex s_registryLock;
+  std::map<std::string, std::weak_ptr<ToyCalorimeter::ToyAsyncFrameWriter>> s_registry;
+}
+
+namespace ToyCalorimeter {
+
+  std::shared_ptr<ToyAsyncFrameWriter> ToyAsyncFrameWriter::acquire(const std::string& fileName, std::size_t queueDepth,
+                                                                    const ToyWriterOptions& options) {
+    std::lock_guard<std::mutex> guard(s_registryLock);
+    auto writer = s_registry[fileName].lock();
+    if ( !writer ) {
+      writer.reset(new ToyAsyncFrameWriter(fileName, queueDepth, options));
+      s_registry[fileName] = writer;
+    }
+    return writer;
+  }
+
+  ToyAsyncFrameWriter::ToyAsyncFrameWriter(const std::string& fileName, std::size_t queueDepth,
+                                           const ToyWriterOptions& options)
+    : m_fileName(fileName), m_queueDepth(queueDepth > 0 ? queueDepth : 1)
+  {
+    // Collections are built on the workers while this thread compresses and writes
+    ROOT::EnableThreadSafety();
+    m_writer = ToyFrameWriter::create(fileName, options);
+    m_thread = std::thread(&ToyAsyncFrameWriter::run, this);
+    dd4hep::printout(dd4hep::INFO, "ToyAsyncFrameWriter", "+++ Writing %s from a dedicated thread, queue depth %zu",
+                     fileName.c_str(), m_queueDepth);
+  }
+
+  ToyAsyncFrameWriter::~ToyAsyncFrameWriter() {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_stop = true;
+    }
+    m_notEmpty.notify_one();
+    m_thread.join();
+
+    for (auto& [runNumber, run] : m_runs) {
+      m_writer->writeFrame(run, "runs");
+      ++m_frames;
+    }
+    podio::Frame metadata {};
+    m_metadata.fill(metadata);
+    m_writer->writeFrame(metadata, "metadata");
+    m_writer->finish();
+
+    {
+      std::lock_guard<std::mutex> guard(s_registryLock);
+      auto it = s_registry.find(m_fileName);
+      if ( it != s_registry.end() && it->second.expired() ) s_registry.erase(it);
+    }
+    dd4hep::printout(dd4hep::INFO, "ToyAsyncFrameWriter",
+                     "+++ Closed %s: %zu frames in %.2f s of writing, at most %zu queued, workers waited %zu times",
+                     m_fileName.c_str(), m_frames, m_writeTime, m_maxQueued, m_waits);
+  }
+
+  void ToyAsyncFrameWriter::push(podio::Frame&& frame, const std::string& category) {
+    {
+      std::unique_lock<std::mutex> guard(m_lock);
+      if ( m_queue.size() >= m_queueDepth ) {
+        ++m_waits;
+        m_notFull.wait(guard, [this]() { return m_queue.size() < m_queueDepth; });
+      }
+      m_queue.emplace_back(std::move(frame), category);
+      m_maxQueued = std::max(m_maxQueued, m_queue.size());
+    }
+    m_notEmpty.notify_one();
+  }
+
+  void ToyAsyncFrameWriter::pushRun(int runNumber, podio::Frame&& frame) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_runs.insert_or_assign(runNumber, std::move(frame));
+  }
+
+  void ToyAsyncFrameWriter::addMetadata(const ToyMetadata& parameters) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_metadata.merge(parameters);
+  }
+
+  void ToyAsyncFrameWriter::run() {
+    for (;;) {
+      std::pair<podio::Frame, std::string> item;
+      {
+        std::unique_lock<std::mutex> guard(m_lock);
+        m_notEmpty.wait(guard, [this]() { return m_stop || !m_queue.empty(); });
+        if ( m_queue.empty() ) return;    // stopped and drained
+        item = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      m_notFull.notify_one();
+
+      auto start = std::chrono::steady_clock::now();
+      try {
+        m_writer->writeFrame(item.first, item.second);
+        ++m_frames;
+      }
+      catch (const std::exception& e) {
+        dd4hep::printout(dd4hep::ERROR, "ToyAsyncFrameWriter", "+++ Failed to write a %s frame to %s: %s",
+                         item.second.c_str(), m_fileName.c_str(), e.what());
+      }
+      m_writeTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+  }
+
+}
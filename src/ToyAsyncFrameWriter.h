@@ -0,0 +1,67 @@
+#ifndef ToyAsyncFrameWriter_h
+#define ToyAsyncFrameWriter_h 1
+#include "ToyFrameWriter.h"
+#include <podio/Frame.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace ToyCalorimeter {
+
+  // One output file written by a dedicated thread.
+  // The per-thread Geant4EDM4ToyReadout instances of a job share it: each worker builds its podio::Frame
+  // without any lock and pushes it into a bounded queue. When the queue is full, push() blocks until the
+  // writer thread has caught up (backpressure), so memory stays bounded by the queue depth.
+  // The file is finished when the last instance releases its handle.
+  class ToyAsyncFrameWriter {
+    public:
+      // Writer for a file name, created by the first caller and shared with all later ones
+      static std::shared_ptr<ToyAsyncFrameWriter> acquire(const std::string& fileName, std::size_t queueDepth,
+                                                          const ToyWriterOptions& options = {});
+
+      ~ToyAsyncFrameWriter();
+
+      void push(podio::Frame&& frame, const std::string& category);
+
+      // Every worker sees the end of a run. The frame pushed last for a run number replaces the earlier ones and
+      // is written when the file is finished: it carries the hot path counters of all workers.
+      void pushRun(int runNumber, podio::Frame&& frame);
+
+      // Collected from all workers and written as one metadata frame when the file is finished
+      void addMetadata(const ToyMetadata& parameters);
+
+      const std::string& fileName() const { return m_fileName; }
+
+    private:
+      ToyAsyncFrameWriter(const std::string& fileName, std::size_t queueDepth, const ToyWriterOptions& options);
+      void run();
+
+      std::string                                      m_fileName;
+      std::unique_ptr<ToyFrameWriter>                  m_writer;
+      std::deque<std::pair<podio::Frame, std::string>> m_queue;
+      std::size_t                                      m_queueDepth;
+      std::mutex                                       m_lock;
+      std::condition_variable                          m_notEmpty;
+      std::condition_variable                          m_notFull;
+      bool                                             m_stop {false};
+      std::map<int, podio::Frame>                      m_runs;
+      ToyMetadata                                      m_metadata;
+
+      // Statistics, printed when the file is finished
+      std::size_t                                      m_frames    {0};
+      std::size_t                                      m_waits     {0};
+      std::size_t                                      m_maxQueued {0};
+      double                                           m_writeTime {0.};
+
+      std::thread                                      m_thread;
+  };
+
+}
+
+#endif
@@ -8,9 +8,10 @@ ToyCalorimeter::ToyCaloHit::ToyCaloHit():
   position(),
   truth(),
   energyDeposit(0),
-  yourInterestingQuantity(0)
+  yourInterestingQuantity(0),
+  m_counted(hitCountingEnabled())
 {
-  dd4hep::InstanceCount::increment(this);
+  if ( m_counted ) dd4hep::InstanceCount::increment(this);
 }
 
 ToyCalorimeter::ToyCaloHit::ToyCaloHit(const Position& pos):
@@ -18,11 +19,12 @@ ToyCalorimeter::ToyCaloHit::ToyCaloHit(const Position& pos):
   position(pos),
   truth(),
   energyDeposit(0),
-  yourInterestingQuantity(0)
+  yourInterestingQuantity(0),
+  m_counted(hitCountingEnabled())
 {
-  dd4hep::InstanceCount::increment(this);
+  if ( m_counted ) dd4hep::InstanceCount::increment(this);
 }
 
 ToyCalorimeter::ToyCaloHit::~ToyCaloHit() {
-  dd4hep::InstanceCount::decrement(this);
-}
\ No newline at end of file
+  if ( m_counted ) dd4hep::InstanceCount::decrement(this);
+}
@@ -1,6 +1,7 @@
 #ifndef ToyCaloHit_h
 #define ToyCaloHit_h 1
 #include "DDG4/Geant4Data.h"
+#include "ToyHitPool.h"
 
 namespace ToyCalorimeter {
 
@@ -25,6 +26,20 @@ namespace ToyCalorimeter {
         virtual ~ToyCaloHit();
         ToyCaloHit& operator=(ToyCaloHit&& c) = delete;
         ToyCaloHit& operator=(const ToyCaloHit& c) = delete;
+
+        // Hits come from the per-thread ToyHitPool, see ToyHitPool.h
+        void* operator new(std::size_t size) {
+          if ( size != sizeof(ToyCaloHit) ) return ::operator new(size);
+          return ToyHitPool<ToyCaloHit>::allocate();
+        }
+        void operator delete(void* hit, std::size_t size) {
+          if ( size != sizeof(ToyCaloHit) ) return ::operator delete(hit);
+          ToyHitPool<ToyCaloHit>::release(hit);
+        }
+
+      private:
+        // Counted by dd4hep::InstanceCount, only while hit counting is enabled on the creating thread
+        bool          m_counted;   //!
     };
 
 };
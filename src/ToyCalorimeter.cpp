@@ -57,6 +57,24 @@ static Ref_t create_toy_calorimeter(Detector& theDetector, xml_h xmlElement, Sen
   dd4hep::Segmentation* _geoSeg=&geomseg;
   auto segmentation=dynamic_cast<dd4hep::DDSegmentation::ToySegmentation *>(_geoSeg->segmentation());
 
+  // An analytic segmentation computes the cell centres itself, its barrel parameters must describe this geometry
+  if ( segmentation->isAnalytic() ) {
+    if ( segmentation->phiSegments() != int(PHI_SEGMENTS) ||
+         std::abs(segmentation->barrelInnerR()-BARREL_INNER_R) > 1e-6*dd4hep::mm ||
+         std::abs(segmentation->barrelOuterR()-BARREL_OUTER_R) > 1e-6*dd4hep::mm ) {
+      except(detName, "+++ Analytic ToySegmentation parameters do not match the <dim> element of %s", detName.c_str());
+    }
+  }
+
+  // Sub-cells are laid out over the crystal box, whose size comes from the <box> element
+  if ( segmentation->hasSubCells() ) {
+    if ( std::abs(segmentation->crystalHalfX()-BOX_HALF_X) > 1e-6*dd4hep::mm ||
+         std::abs(segmentation->crystalHalfY()-BOX_HALF_Y) > 1e-6*dd4hep::mm ||
+         std::abs(segmentation->crystalHalfZ()-BOX_HALF_Z) > 1e-6*dd4hep::mm ) {
+      except(detName, "+++ ToySegmentation crystal half lengths do not match the <box> element of %s", detName.c_str());
+    }
+  }
+
   // ----------------------------------------------------------------
   // Create a global assembly volume for the calorimeter
   // ----------------------------------------------------------------
@@ -71,6 +89,11 @@ static Ref_t create_toy_calorimeter(Detector& theDetector, xml_h xmlElement, Sen
   // Set visualization attributes for the volume
   globalTubeVolume.setVisAttributes(theDetector, detectorXML.visStr());
 
+  // The envelope carries the calorimeter region, fast simulation models are attached to it
+  if ( detectorXML.hasAttr(_Unicode(region)) ) {
+    globalTubeVolume.setRegion(theDetector, detectorXML.regionStr());
+  }
+
   // Make a placed instance of the volume
   dd4hep::PlacedVolume globalTubePlacedVol = experimentalHall.placeVolume(globalTubeVolume);
 
@@ -113,32 +136,83 @@ static Ref_t create_toy_calorimeter(Detector& theDetector, xml_h xmlElement, Sen
 
   // Make placements of the box in phi
   int nPhi = PHI_SEGMENTS;
-  for (int i=0; i<nPhi; i++) {
-    double phi      = i*(2*M_PI/nPhi);
-    double dispX     = (rmin + 0.5*(rmax-rmin)) * cos(phi);
-    double dispY     = (rmin + 0.5*(rmax-rmin)) * sin(phi);
-    double dispZ     = 0.0;
-
-    // Create a new transformation for each instance (rotation + translation)
-    RotationZ     aRotation(phi);
-    Translation3D aDisplacement(dispX, dispY, dispZ);
-    Transform3D   aTransform(aRotation, aDisplacement);
-
-    auto volID   =segmentation->setVolumeID(detId,i,0,0); // system, phi, theta, depth
-    int  volID_32=segmentation->getFirst32bits(volID); // Used to ensure unique copy ids in geant4
-
-    // Make a new placed volume of exampleBoxVolume
-    dd4hep::PlacedVolume aBoxPlacedVol = globalTubeVolume.placeVolume(aBoxVolume, volID_32, aTransform);
-
-    // PhysVolID is used at dd4hep level, not geant4, have to repeat
-    aBoxPlacedVol.addPhysVolID("system", detId);
-    aBoxPlacedVol.addPhysVolID("phi", i);
+
+  // placement="param" builds the ring as one parameterised placement: Geant4 sees a single
+  // G4PVParameterised instead of nPhi physical volumes. The copy number is then only the
+  // replica number, so the cell has to come from an analytic segmentation.
+  std::string placementMode = dimXML.hasAttr(_Unicode(placement)) ? dimXML.attr<std::string>(_Unicode(placement)) : "explicit";
+  if ( placementMode == "param" ) {
+    if ( !segmentation->isAnalytic() ) {
+      except(detName, "+++ placement=\"param\" needs an analytic ToySegmentation (set phi_segments on the <segmentation>)");
+    }
+    // All replicas share one volume ID, so the volume manager cannot give the local position sub-cells need
+    if ( segmentation->hasSubCells() ) {
+      except(detName, "+++ placement=\"param\" cannot be combined with a ToySegmentation sub-cell grid");
+    }
+
+    // The replicated volume is a phi wedge with the crystal inside at mid radius. Its start and increment are
+    // pure rotations about z, which commute, so replica i is the wedge rotated by i*dphi however the placement
+    // composes them. A radial offset in the start transform would make the replicas spin about their own centre
+    // if the increment were applied in the local frame.
+    const double dphi = 2*M_PI/nPhi;
+    const double rmid = rmin + 0.5*(rmax-rmin);
+    if ( rmid-BOX_HALF_X < rmin || std::hypot(rmid+BOX_HALF_X, BOX_HALF_Y) > rmax ||
+         std::atan2(BOX_HALF_Y, rmid-BOX_HALF_X) > 0.5*dphi || BOX_HALF_Z > dz ) {
+      except(detName, "+++ placement=\"param\": the <box> does not fit into a phi wedge of the barrel");
+    }
+    dd4hep::Tube aWedgeShape(rmin, rmax, BOX_HALF_Z, -0.5*dphi, 0.5*dphi);
+    dd4hep::Volume aWedgeVolume("aWedgeVolume", aWedgeShape, theDetector.material("Vacuum"));
+    aWedgeVolume.setVisAttributes(theDetector.invisible());
+
+    dd4hep::PlacedVolume aBoxPlacedVol = aWedgeVolume.placeVolume(aBoxVolume, Position(rmid, 0.0, 0.0));
+    aBoxPlacedVol.addPhysVolID("phi", 0);
     aBoxPlacedVol.addPhysVolID("theta", 0);
     aBoxPlacedVol.addPhysVolID("depth", 0);
 
-    // Save the position of the placed volume for easy lookup when producing hits
-    segmentation->savePosition(volID_32, XYZVector(dispX, dispY, dispZ)/dd4hep::mm);
+    Transform3D aStart(RotationZ(0.));
+    Transform3D aIncrement(RotationZ(dphi));
+    dd4hep::PlacedVolume aRingPlacedVol = globalTubeVolume.paramVolume1D(aStart, aWedgeVolume, nPhi, aIncrement);
+
+    // The phi field is filled from the step position by the segmentation
+    aRingPlacedVol.addPhysVolID("system", detId);
+  }
+  else if ( placementMode == "explicit" ) {
+    for (int i=0; i<nPhi; i++) {
+      double phi      = i*(2*M_PI/nPhi);
+      double dispX     = (rmin + 0.5*(rmax-rmin)) * cos(phi);
+      double dispY     = (rmin + 0.5*(rmax-rmin)) * sin(phi);
+      double dispZ     = 0.0;
+
+      // Create a new transformation for each instance (rotation + translation)
+      RotationZ     aRotation(phi);
+      Translation3D aDisplacement(dispX, dispY, dispZ);
+      Transform3D   aTransform(aRotation, aDisplacement);
+
+      auto volID   =segmentation->setVolumeID(detId,i,0,0); // system, phi, theta, depth
+      int  volID_32=segmentation->getFirst32bits(volID); // Used to ensure unique copy ids in geant4
+
+      // Make a new placed volume of exampleBoxVolume
+      dd4hep::PlacedVolume aBoxPlacedVol = globalTubeVolume.placeVolume(aBoxVolume, volID_32, aTransform);
+
+      // PhysVolID is used at dd4hep level, not geant4, have to repeat
+      aBoxPlacedVol.addPhysVolID("system", detId);
+      aBoxPlacedVol.addPhysVolID("phi", i);
+      aBoxPlacedVol.addPhysVolID("theta", 0);
+      aBoxPlacedVol.addPhysVolID("depth", 0);
+
+      // Save the position of the placed volume for easy lookup when producing hits
+      // (not needed in analytic mode, where the segmentation computes it)
+      if ( !segmentation->isAnalytic() ) {
+        segmentation->savePosition(volID_32, XYZVector(dispX, dispY, dispZ)/dd4hep::mm);
+      }
+    }
   }
+  else {
+    except(detName, "+++ Unknown placement mode '%s', use \"explicit\" or \"param\"", placementMode.c_str());
+  }
+
+  // All cells are placed: build the dense lookup table shared by the sensitive actions
+  segmentation->freezePositions();
 
   return calorimeterDet;
 }
@@ -1,20 +1,115 @@
 #include "ToySegmentation.h"
 #include "ToyCaloHit.h"
+#include "ToyCellAccumulator.h"
+#include "ToyContributions.h"
+#include "ToyHitBooking.h"
+#include "ToySDCounters.h"
 #include "DDG4/Geant4SensDetAction.inl"
+#include "DDG4/Geant4FastSimSpot.h"
 #include "DDG4/Factories.h"
 #include "G4OpticalPhoton.hh"
 #include "G4VProcess.hh"
+#include "G4Threading.hh"
+#include "G4Run.hh"
+#include "G4Box.hh"
+#include "G4Material.hh"
+#include "G4MaterialPropertiesTable.hh"
+#include "G4LogicalVolume.hh"
+#include "G4NavigationHistory.hh"
+#include "G4VPhysicalVolume.hh"
 
 namespace ToyCalorimeter {
   class ToyCalorimeter_SDAction_Custom {
     public:
       typedef dd4hep::sim::Geant4Calorimeter::Hit NormalHit;
 
+      // The hits we create come from a per-thread pool, the collection still holds plain NormalHit objects
+      typedef ToyPooledHit<NormalHit> PooledNormalHit;
+
       // For custom hits
       typedef ToyCaloHit CustomHit;
       
       // Additional readout class if desired
       std::size_t  m_collectionID_interesting {0}; 
+
+      // Segmentation resolved once by the (thread local) action instead of on every step
+      const dd4hep::DDSegmentation::ToySegmentation* m_segmentation {nullptr};
+      int                                            m_systemID {0};
+
+      // Cell of a step or spot. The copy number is the 32 bit volume ID of the crystal; analytic mode finds the
+      // crystal from the global position alone. Only sub-cells need the local position, which the volume
+      // manager lookup of Geant4Sensitive::cellID() provides, so they use the lookup passed in.
+      template <typename LOOKUP>
+      dd4hep::VolumeID cellID(const G4VTouchable* touchable, const G4ThreeVector& global, LOOKUP&& volumeManagerLookup) const {
+        if ( m_segmentation->hasSubCells() ) return volumeManagerLookup();
+        if ( m_segmentation->isAnalytic() ) {
+          return m_segmentation->analyticCellID(m_systemID, dd4hep::DDSegmentation::Vector3D(global.x(), global.y(), global.z()));
+        }
+        return touchable->GetCopyNumber(0);
+      }
+
+      // Dense accumulation: sum deposits and the interesting quantity per cell index,
+      // both kinds of hits are created at the end of the event
+      bool               m_denseAccumulation {false};
+      ToyCellAccumulator m_cells;
+
+      // Optional per-thread hit pool statistics, printed for every event
+      bool               m_countHits {false};
+      ToyHitPoolCounters m_lastCounters;
+
+      // HotPathCounters: steps, hits created and updated and the process() time of this thread,
+      // handed to the run totals at the end of every event
+      bool          m_hotPathCounters {false};
+      ToySDCounters m_counters;
+
+      // nullptr when the counters are switched off
+      ToySDCounters* counters() { return m_hotPathCounters ? &m_counters : nullptr; }
+
+      // MC step contributions, merged per ancestor and capped per hit (m_truth holds them per cell index in dense mode)
+      ToyContributionPolicy         m_contributions;
+      std::vector<ContributionList> m_truth;
+      ToyTrackAncestry              m_ancestry;
+
+      // Contribution of a step or spot, kept under the ancestor of its track
+      dd4hep::sim::Geant4HitData::Contribution contribution(dd4hep::sim::Geant4HitData::Contribution c, int parentID) {
+        c.trackID =m_ancestry.ancestor(c.trackID, parentID);
+        return c;
+      }
+
+      // Parametrized optical photons: the photons are killed at creation (ToyOpticalPhotonKiller) and every step
+      // adds edep x SCINTILLATIONYIELD x collection efficiency to yourInterestingQuantity instead of 1.
+      // The efficiency table is binned along the local x axis of the crystal, i.e. its radial length.
+      bool                m_parametrizedPhotons {false};
+      std::vector<double> m_collectionEfficiency;
+      const G4Material*   m_yieldMaterial {nullptr};
+      double              m_yield {0.};
+      double              m_crystalHalfLength {0.};
+
+      // Used for steps and for fast simulation spots, both give a touchable and a global position
+      double expectedPhotons(const G4VTouchable* touchable, const G4ThreeVector& global, double edep) {
+        // The yield only changes with the material, so it is looked up once per material
+        const G4Material* material =touchable->GetVolume()->GetLogicalVolume()->GetMaterial();
+        if ( material != m_yieldMaterial ) {
+          const G4MaterialPropertiesTable* table =material->GetMaterialPropertiesTable();
+          m_yield =(table && table->ConstPropertyExists("SCINTILLATIONYIELD")) ? table->GetConstProperty("SCINTILLATIONYIELD") : 0.;
+          m_yieldMaterial =material;
+        }
+
+        double efficiency =1.;
+        if ( !m_collectionEfficiency.empty() ) {
+          if ( m_crystalHalfLength <= 0. ) {
+            const G4Box* box =dynamic_cast<const G4Box*>(touchable->GetSolid());
+            m_crystalHalfLength =box ? box->GetXHalfLength() : 0.;
+          }
+          if ( m_crystalHalfLength > 0. ) {
+            double x =touchable->GetHistory()->GetTopTransform().TransformPoint(global).x();
+            long n   =long(m_collectionEfficiency.size());
+            long bin =long((x+m_crystalHalfLength)/(2*m_crystalHalfLength)*n);
+            efficiency =m_collectionEfficiency[std::min(std::max(bin, 0L), n-1)];
+          }
+        }
+        return edep*m_yield*efficiency;
+      }
   };
 }
 namespace dd4hep {
@@ -22,67 +117,188 @@ namespace dd4hep {
 
     using namespace ToyCalorimeter;
     
+    template <> void Geant4SensitiveAction<ToyCalorimeter_SDAction_Custom>::initialize()    {
+      declareProperty("DenseAccumulation", m_userData.m_denseAccumulation);
+      declareProperty("CountHits", m_userData.m_countHits);
+      declareProperty("HotPathCounters", m_userData.m_hotPathCounters);
+      declareProperty("SaveContributions", m_userData.m_contributions.save);
+      declareProperty("MaxContributions", m_userData.m_contributions.maxContributions);
+      declareProperty("ContributionTimeBin", m_userData.m_contributions.timeBin);
+      declareProperty("ParametrizedPhotons", m_userData.m_parametrizedPhotons);
+      declareProperty("CollectionEfficiency", m_userData.m_collectionEfficiency);
+    }
+
     template <> void Geant4SensitiveAction<ToyCalorimeter_SDAction_Custom>::defineCollections()    {
       
       m_collectionID = defineCollection<ToyCalorimeter_SDAction_Custom::NormalHit>("ToyCalorimeterHits");
 
       // Declare a second ROOT collection (tree) for the custom hits
       m_userData.m_collectionID_interesting = defineCollection<ToyCalorimeter_SDAction_Custom::CustomHit>("ToyCalorimeterHitsInteresting");
+
+      // Lets the output warn when it prunes particles by their contributions but none are saved
+      registerContributionPolicy(m_userData.m_contributions);
+    }
+
+    template <> void Geant4SensitiveAction<ToyCalorimeter_SDAction_Custom>::begin(G4HCofThisEvent* hce)    {
+      Geant4Sensitive::begin(hce);
+      if ( !m_userData.m_segmentation ) {
+        dd4hep::Segmentation *_geoSeg=&m_segmentation;
+        m_userData.m_segmentation=dynamic_cast<dd4hep::DDSegmentation::ToySegmentation *>(_geoSeg->segmentation());
+        if ( !m_userData.m_segmentation ) {
+          except("+++ The readout of %s does not use a ToySegmentation", c_name());
+        }
+        m_userData.m_systemID =m_detector.id();
+        if ( m_userData.m_denseAccumulation ) {
+          m_userData.m_cells.resize(m_userData.m_segmentation->numberOfCells());
+          if ( m_userData.m_contributions.save ) {
+            m_userData.m_truth.resize(m_userData.m_segmentation->numberOfCells());
+          }
+        }
+        if ( m_userData.m_countHits ) {
+          enableHitCounting(true);
+        }
+      }
+      m_userData.m_cells.reset();
+      m_userData.m_ancestry.clear();
+    }
+
+    template <> void Geant4SensitiveAction<ToyCalorimeter_SDAction_Custom>::end(G4HCofThisEvent* hce)    {
+      // Dense accumulation: one hit of each kind per touched cell, created once per event
+      if ( m_userData.m_denseAccumulation ) {
+        Geant4HitCollection* interesting_coll =collection(m_userData.m_collectionID_interesting);
+        createDenseHits<ToyCalorimeter_SDAction_Custom::NormalHit, ToyCalorimeter_SDAction_Custom::PooledNormalHit>(
+          m_userData.m_cells, *m_userData.m_segmentation, collection(m_collectionID),
+          [this, interesting_coll](const ToyCellAccumulator::Cell& cell, ToyCalorimeter_SDAction_Custom::NormalHit* hit) {
+            if ( !m_userData.m_truth.empty() ) {
+              hit->truth.swap(m_userData.m_truth[cell.index]);
+            }
+            auto* hitInteresting =new ToyCalorimeter_SDAction_Custom::CustomHit(hit->position);
+            hitInteresting->cellID =cell.cellID;
+            hitInteresting->yourInterestingQuantity =m_userData.m_cells.quantity(cell.index);
+            interesting_coll->add(cell.cellID, hitInteresting);
+          });
+      }
+      // Hit pool statistics of this thread: new pool pages are the only heap allocations made for hits
+      if ( m_userData.m_countHits ) {
+        ToyHitPoolCounters now =ToyHitPool<ToyCalorimeter_SDAction_Custom::PooledNormalHit>::counters();
+        ToyHitPoolCounters custom =ToyHitPool<ToyCalorimeter_SDAction_Custom::CustomHit>::counters();
+        now.allocated +=custom.allocated;
+        now.pages     +=custom.pages;
+        info("+++ Hits allocated this event: %ld from the pools, %d new pool pages (%d in total)",
+             now.allocated-m_userData.m_lastCounters.allocated, now.pages-m_userData.m_lastCounters.pages, now.pages);
+        m_userData.m_lastCounters =now;
+      }
+      // Hot path counters of this event, summed per run and thread for the run frame of the output
+      if ( m_userData.m_hotPathCounters ) {
+        ToySDCounterRegistry::add(context()->run().run().GetRunID(), name(), std::max(0, G4Threading::G4GetThreadId()), m_userData.m_counters);
+        m_userData.m_counters ={};
+      }
+      Geant4Sensitive::end(hce);
     }
 
     template <> bool 
     Geant4SensitiveAction<ToyCalorimeter_SDAction_Custom>::process(const G4Step* step,G4TouchableHistory* /*hist*/) {
+      ToySDCounters* counters =m_userData.counters();
+      ToySDProcessTimer timer(counters);
+
       G4StepPoint        *thePrePoint =step->GetPreStepPoint();
       G4TouchableHandle  thePreStepTouchable =thePrePoint->GetTouchableHandle();
 
-      // Uncomment if you want to save MC step contributions
-      // Geant4StepHandler h(step);
-      // Geant4HitData::MonteCarloContrib contrib = Geant4HitData::extractContribution(step);
-
-      auto cellID =thePreStepTouchable->GetCopyNumber(0);
       G4Track *track =step->GetTrack();
       
-      // Get the segmentation for the sensitive detector
-      dd4hep::Segmentation *_geoSeg=&m_segmentation;
-      auto segmentation=dynamic_cast<dd4hep::DDSegmentation::ToySegmentation *>(_geoSeg->segmentation());
+      // The segmentation for the sensitive detector, resolved at the start of the event
+      auto segmentation=m_userData.m_segmentation;
 
-      // Get the position of the detector cell from the segmentation
-      DDSegmentation::Vector3D pos =segmentation->position(cellID);
-      Position global(pos.x(),pos.y(),pos.z());
+      // Global position as in Geant4Sensitive::cellID(step): the middle of the step
+      G4ThreeVector mid =0.5*(thePrePoint->GetPosition()+step->GetPostStepPoint()->GetPosition());
+      VolumeID cellID =m_userData.cellID(thePrePoint->GetTouchable(), mid, [&]() { return this->cellID(step); });
 
       // Get the energy deposited in the step
       G4double edep =step->GetTotalEnergyDeposit();
+      if ( counters ) {
+        ++counters->steps;
+        if ( !aboveStepThreshold(edep) ) ++counters->belowThreshold;
+      }
 
-      // Get the colletion for normal hits
-      Geant4HitCollection* coll =collection(m_collectionID);
+      // Either count the steps, or the expected number of detected scintillation photons
+      double quantity =1.0;
+      if ( m_userData.m_parametrizedPhotons ) {
+        quantity =m_userData.expectedPhotons(thePrePoint->GetTouchable(), mid, edep);
+      }
 
-      // Check if the hit already exists in the collection
-      // If not, create a new hit and add it to the collection
-      auto* hit =coll->findByKey<ToyCalorimeter_SDAction_Custom::NormalHit>(cellID);
-      if(!hit) {
-        hit =new ToyCalorimeter_SDAction_Custom::NormalHit(global);
-        hit->cellID =cellID;
-        coll->add(cellID, hit);
+      // Dense accumulation: no hit lookups, the hits are created in end()
+      if ( m_userData.m_denseAccumulation ) {
+        long index =segmentation->cellIndex(cellID);
+        if ( index < 0 ) {
+          except("+++ Cell %016llX is outside the ToySegmentation cell table", (unsigned long long)cellID);
+        }
+        bool created =m_userData.m_cells.add(index, cellID, stepDeposit(edep), quantity);
+        if ( counters ) counters->booked(created);
+        if ( m_userData.m_contributions.save && aboveStepThreshold(edep) ) {
+          addContribution(m_userData.m_truth[index], m_userData.contribution(Geant4HitData::extractContribution(step), track->GetParentID()), m_userData.m_contributions);
+        }
+        return true;
       }
-      
+
+      // Find the normal hit of the cell, or create it at the cell position of the segmentation
+      bool created =false;
+      auto* hit =findOrCreateHit<ToyCalorimeter_SDAction_Custom::NormalHit, ToyCalorimeter_SDAction_Custom::PooledNormalHit>(
+        collection(m_collectionID), *segmentation, cellID, created);
+      if ( counters ) counters->booked(created);
+
       // Add the energy deposit to the hit if it is above a threshold (in MeV)
-      if(edep>0.1) {
-        hit->energyDeposit+=edep;
-      }
+      hit->energyDeposit+=stepDeposit(edep);
 
       // ToyCaloHit collection for custom hits, same idea
-      Geant4HitCollection* interesting_coll =collection(m_userData.m_collectionID_interesting);
-      auto* hitInteresting =interesting_coll->findByKey<ToyCalorimeter_SDAction_Custom::CustomHit>(cellID);
-      if(!hitInteresting) {
-        hitInteresting =new ToyCalorimeter_SDAction_Custom::CustomHit(global);
-        hitInteresting->cellID =cellID;
-        interesting_coll->add(cellID, hitInteresting);
+      auto* hitInteresting =findOrCreateHit<ToyCalorimeter_SDAction_Custom::CustomHit>(
+        collection(m_userData.m_collectionID_interesting), *segmentation, cellID, created);
+      hitInteresting->yourInterestingQuantity += quantity;
+
+      // MC step contributions, merged per ancestor, PDG and time bin and capped per hit
+      if ( m_userData.m_contributions.save && aboveStepThreshold(edep) ) {
+        addContribution(hit->truth, m_userData.contribution(Geant4HitData::extractContribution(step), track->GetParentID()), m_userData.m_contributions);
+      }
+
+      return true;
+    }
+
+    template <> bool
+    Geant4SensitiveAction<ToyCalorimeter_SDAction_Custom>::processFastSim(const Geant4FastSimSpot* spot, G4TouchableHistory* /*hist*/) {
+      // Spots of a fast simulation shower model (e.g. ToyEMShowerModel) are booked like steps.
+      // They carry the parametrized shower energy, so the step threshold is not applied.
+      auto segmentation=m_userData.m_segmentation;
+      VolumeID cellID =m_userData.cellID(spot->touchable, spot->hitPosition(), [&]() { return this->cellID(spot->touchable, spot->hitPosition()); });
+      G4double edep =spot->energy();
+      ToySDCounters* counters =m_userData.counters();
+      if ( counters ) ++counters->spots;
+      double quantity =m_userData.m_parametrizedPhotons ? m_userData.expectedPhotons(spot->touchable, spot->hitPosition(), edep) : 1.0;
+
+      if ( m_userData.m_denseAccumulation ) {
+        long index =segmentation->cellIndex(cellID);
+        if ( index < 0 ) {
+          except("+++ Cell %016llX is outside the ToySegmentation cell table", (unsigned long long)cellID);
+        }
+        bool created =m_userData.m_cells.add(index, cellID, edep, quantity);
+        if ( counters ) counters->booked(created);
+        if ( m_userData.m_contributions.save ) {
+          addContribution(m_userData.m_truth[index], m_userData.contribution(Geant4HitData::extractContribution(spot), 0), m_userData.m_contributions);
+        }
+        return true;
       }
-      hitInteresting->yourInterestingQuantity += 1.0;
 
-      // Uncomment if you want to save MC step contributions
-      // hit->truth.emplace_back(contrib);
+      bool created =false;
+      auto* hit =findOrCreateHit<ToyCalorimeter_SDAction_Custom::NormalHit, ToyCalorimeter_SDAction_Custom::PooledNormalHit>(
+        collection(m_collectionID), *segmentation, cellID, created);
+      if ( counters ) counters->booked(created);
+      hit->energyDeposit+=edep;
 
+      auto* hitInteresting =findOrCreateHit<ToyCalorimeter_SDAction_Custom::CustomHit>(
+        collection(m_userData.m_collectionID_interesting), *segmentation, cellID, created);
+      hitInteresting->yourInterestingQuantity += quantity;
+
+      if ( m_userData.m_contributions.save ) {
+        addContribution(hit->truth, m_userData.contribution(Geant4HitData::extractContribution(spot), 0), m_userData.m_contributions);
+      }
       return true;
     }
   }
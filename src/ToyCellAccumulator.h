@@ -0,0 +1,62 @@
+#ifndef ToyCellAccumulator_h
+#define ToyCellAccumulator_h 1
+#include <cstdint>
+#include <vector>
+
+namespace ToyCalorimeter {
+
+  // Dense per-event sums over the readout cells of a ToySegmentation, indexed by ToySegmentation::cellIndex().
+  // Each sensitive action owns one, so it is only ever used by one thread.
+  // The touched list keeps the cells in first-hit order; harvesting and resetting only visit those cells.
+  class ToyCellAccumulator {
+    public:
+      struct Cell {
+        long               index;
+        unsigned long long cellID;
+      };
+
+      void resize(std::size_t nCells) {
+        m_energy.assign(nCells, 0.);
+        m_quantity.assign(nCells, 0.);
+        m_isTouched.assign(nCells, 0);
+        m_touched.clear();
+      }
+
+      std::size_t size() const { return m_energy.size(); }
+
+      // True for the first deposit of the event in the cell
+      inline bool add(long index, unsigned long long cellID, double energy, double quantity) {
+        const bool first = !m_isTouched[index];
+        if (first) {
+          m_isTouched[index] = 1;
+          m_touched.push_back({index, cellID});
+        }
+        m_energy[index]   += energy;
+        m_quantity[index] += quantity;
+        return first;
+      }
+
+      const std::vector<Cell>& touched() const { return m_touched; }
+      double energy(long index) const { return m_energy[index]; }
+      double quantity(long index) const { return m_quantity[index]; }
+
+      // O(touched cells), not O(cells)
+      void reset() {
+        for (const auto& cell : m_touched) {
+          m_energy[cell.index]    = 0.;
+          m_quantity[cell.index]  = 0.;
+          m_isTouched[cell.index] = 0;
+        }
+        m_touched.clear();
+      }
+
+    private:
+      std::vector<double>       m_energy;
+      std::vector<double>       m_quantity;
+      std::vector<std::uint8_t> m_isTouched;
+      std::vector<Cell>         m_touched;
+  };
+
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef ToyCellIDCoder_h
+#define ToyCellIDCoder_h 1
+#include "DDSegmentation/BitFieldCoder.h"
+#include <stdexcept>
+#include <string>
+
+namespace dd4hep {
+namespace DDSegmentation {
+
+// Cell ID coder for a layout fixed at compile time: system, phi, theta and depth
+// packed from bit 0 upwards, all unsigned. Offsets and masks are constants, so
+// encoding and decoding compile down to shifts and ands without any field name lookup.
+template <unsigned SystemBits, unsigned PhiBits, unsigned ThetaBits, unsigned DepthBits>
+class ToyCellIDCoder {
+    public:
+        static constexpr unsigned kSystemOffset = 0;
+        static constexpr unsigned kPhiOffset    = kSystemOffset + SystemBits;
+        static constexpr unsigned kThetaOffset  = kPhiOffset    + PhiBits;
+        static constexpr unsigned kDepthOffset  = kThetaOffset  + ThetaBits;
+        static constexpr unsigned kTotalBits    = kDepthOffset  + DepthBits;
+        static_assert(kTotalBits <= 64, "ToyCellIDCoder layout does not fit into a 64 bit cell ID");
+
+        static constexpr CellID kSystemMask = (CellID(1) << SystemBits) - 1;
+        static constexpr CellID kPhiMask    = (CellID(1) << PhiBits)    - 1;
+        static constexpr CellID kThetaMask  = (CellID(1) << ThetaBits)  - 1;
+        static constexpr CellID kDepthMask  = (CellID(1) << DepthBits)  - 1;
+
+        static constexpr int system(CellID id) { return static_cast<int>((id >> kSystemOffset) & kSystemMask); }
+        static constexpr int phi(CellID id)    { return static_cast<int>((id >> kPhiOffset)    & kPhiMask); }
+        static constexpr int theta(CellID id)  { return static_cast<int>((id >> kThetaOffset)  & kThetaMask); }
+        static constexpr int depth(CellID id)  { return static_cast<int>((id >> kDepthOffset)  & kDepthMask); }
+
+        // Same range check as BitFieldElement::set, so both coders reject the same inputs
+        static constexpr CellID encode(int system, int phi, int theta, int depth) {
+            return pack(system, kSystemMask, kSystemOffset) |
+                   pack(phi,    kPhiMask,    kPhiOffset)    |
+                   pack(theta,  kThetaMask,  kThetaOffset)  |
+                   pack(depth,  kDepthMask,  kDepthOffset);
+        }
+
+        // True if the runtime coder stores the four named fields exactly where this layout expects them.
+        // Extra fields above the four are allowed, they are left untouched by this coder.
+        static bool matches(const BitFieldCoder& coder,
+                            const std::string& systemId, const std::string& phiId,
+                            const std::string& thetaId,  const std::string& depthId) {
+            return hasField(coder, systemId, kSystemOffset, SystemBits) &&
+                   hasField(coder, phiId,    kPhiOffset,    PhiBits)    &&
+                   hasField(coder, thetaId,  kThetaOffset,  ThetaBits)  &&
+                   hasField(coder, depthId,  kDepthOffset,  DepthBits);
+        }
+
+    private:
+        static constexpr CellID pack(int value, CellID mask, unsigned offset) {
+            if (value < 0 || static_cast<CellID>(value) > mask) {
+                throw std::runtime_error("ToyCellIDCoder: field value out of range");
+            }
+            return static_cast<CellID>(value) << offset;
+        }
+
+        static bool hasField(const BitFieldCoder& coder, const std::string& name, unsigned offset, unsigned width) {
+            for (const auto& field : coder.fields()) {
+                if (field.name() == name) {
+                    return field.offset() == offset && field.width() == width && !field.isSigned();
+                }
+            }
+            return false;
+        }
+};
+
+// Layout of the ToyCalorimeter readout: <id>system:5,phi:9,theta:9,depth:9</id>
+typedef ToyCellIDCoder<5, 9, 9, 9> ToyDefaultCellIDCoder;
+
+}
+}
+
+#endif
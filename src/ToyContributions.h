@@ -0,0 +1,131 @@
+#ifndef ToyContributions_h
+#define ToyContributions_h 1
+#include "DDG4/Geant4Data.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <unordered_map>
+
+namespace ToyCalorimeter {
+
+  typedef dd4hep::sim::Geant4HitData::MonteCarloContrib Contribution;
+  typedef dd4hep::sim::Geant4HitData::Contributions     ContributionList;
+
+  // How the MC step contributions of a hit are kept.
+  // Steps of the same ancestor (see ToyTrackAncestry) and PDG code within one time bin are merged into one contribution,
+  // and a hit never holds more than maxContributions of them (0 = no limit, at least 1 otherwise).
+  struct ToyContributionPolicy {
+    bool   save             {false};
+    int    maxContributions {16};
+    double timeBin          {1.0};   // ns (CLHEP units)
+  };
+
+  // ToyCalorimeter sensitive actions of the job (counted once per thread) and how many of them save contributions.
+  // The actions register when they define their collections; the output checks it at the start of a run.
+  inline std::atomic<int> g_contributionActions {0};
+  inline std::atomic<int> g_contributionSavers  {0};
+
+  inline void registerContributionPolicy(const ToyContributionPolicy& policy) {
+    ++g_contributionActions;
+    if ( policy.save ) ++g_contributionSavers;
+  }
+  inline bool noContributionsSaved() { return g_contributionActions > 0 && g_contributionSavers == 0; }
+
+  inline long contributionTimeBin(double time, double timeBin) {
+    return timeBin > 0 ? long(std::floor(time/timeBin)) : 0;
+  }
+
+  // Sum the deposits and lengths, keep the earliest time and the deposit weighted step position
+  inline void mergeContribution(Contribution& into, const Contribution& c) {
+    double sum = into.deposit + c.deposit;
+    if ( sum > 0 ) {
+      double w0 = into.deposit/sum, w1 = c.deposit/sum;
+      into.x = w0*into.x + w1*c.x;
+      into.y = w0*into.y + w1*c.y;
+      into.z = w0*into.z + w1*c.z;
+    }
+    into.deposit = sum;
+    into.length += c.length;
+    into.time    = std::min(into.time, c.time);
+  }
+
+  // Track ID of the contribution holding the energy of steps that could not be attributed once a hit was full.
+  // It is written without an MC particle.
+  constexpr int kUnattributedTrack = -1;
+
+  // Ancestor a step contribution is kept under: the first track of its chain that had a step in the detector
+  // during the event (the particle entering the calorimeter, a primary or a particle created in the tracker).
+  // Geant4 finishes a track before its secondaries, so the parent of a shower particle is known when its first
+  // step comes. The particle map of the particle handler is only filled at the end of the event; the output
+  // resolves the ancestor through it to the MCParticle that is written.
+  class ToyTrackAncestry {
+  public:
+    void clear() { m_ancestor.clear(); }
+    // parentID is the parent of the step's track, 0 if unknown
+    int ancestor(int trackID, int parentID) {
+      auto [self, inserted] = m_ancestor.try_emplace(trackID, trackID);
+      if ( inserted && parentID > 0 ) {
+        auto parent = m_ancestor.find(parentID);
+        if ( parent != m_ancestor.end() ) self->second = parent->second;
+      }
+      return self->second;
+    }
+  private:
+    std::unordered_map<int, int> m_ancestor;
+  };
+
+  // Add one step contribution to a hit, c.trackID is the ancestor of the step's track. Memory per hit is bounded
+  // by the policy. Once the hit is full, the step is folded into the contribution of the same ancestor closest
+  // in time. Without one, the smallest deposit (possibly the step itself) moves into the unattributed
+  // contribution, which takes one of the maxContributions slots: energy is never credited to another ancestor.
+  inline void addContribution(ContributionList& truth, const Contribution& c, const ToyContributionPolicy& policy) {
+    long bin = contributionTimeBin(c.time, policy.timeBin);
+    for (auto& t : truth) {
+      if ( t.trackID == c.trackID && t.pdgID == c.pdgID && contributionTimeBin(t.time, policy.timeBin) == bin ) {
+        mergeContribution(t, c);
+        return;
+      }
+    }
+    if ( policy.maxContributions <= 0 || truth.size() < std::size_t(policy.maxContributions) ) {
+      truth.emplace_back(c);
+      return;
+    }
+
+    auto nearest = [&truth, &c](int trackID) -> Contribution* {
+      Contribution* found = nullptr;
+      for (auto& t : truth) {
+        if ( t.trackID == trackID && (!found || std::abs(t.time - c.time) < std::abs(found->time - c.time)) ) found = &t;
+      }
+      return found;
+    };
+    if ( Contribution* into = nearest(c.trackID) ) {
+      mergeContribution(*into, c);
+      return;
+    }
+
+    Contribution* unattributed = nearest(kUnattributedTrack);
+    auto smallest = [&truth]() -> Contribution* {
+      Contribution* found = nullptr;
+      for (auto& t : truth) {
+        if ( t.trackID != kUnattributedTrack && (!found || t.deposit < found->deposit) ) found = &t;
+      }
+      return found;
+    };
+    if ( !unattributed ) {
+      unattributed = smallest();
+      unattributed->trackID = kUnattributedTrack;
+      unattributed->pdgID   = 0;
+    }
+    Contribution* evict = smallest();
+    if ( !evict || c.deposit <= evict->deposit ) {
+      mergeContribution(*unattributed, c);
+      return;
+    }
+    mergeContribution(*unattributed, *evict);
+    *evict = c;
+  }
+
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include "DDG4/Geant4FastSimShowerModel.inl"
+#include "DDG4/Factories.h"
+#include "G4FastSimHitMaker.hh"
+#include "G4FastHit.hh"
+#include "G4FastTrack.hh"
+#include "G4FastStep.hh"
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "Randomize.hh"
+#include "CLHEP/Units/SystemOfUnits.h"
+#include <cmath>
+#include <vector>
+
+// Parameters of the parametrized EM shower in the ToyCalorimeter crystals.
+// The defaults describe PbWO4; all of them can be changed from the steering file.
+namespace ToyCalorimeter {
+  class ToyEMShowerParams {
+    public:
+      // Places the spots as G4FastHits: finds the crystal and calls the sensitive action's processFastSim
+      G4FastSimHitMaker hitMaker { };
+
+      double radiationLength  { 8.903  * CLHEP::mm };
+      double moliereRadius    { 19.6   * CLHEP::mm };
+      double criticalEnergy   { 9.64   * CLHEP::MeV };
+      double stepX0           { 0.5 };    // longitudinal step in units of X0
+      double maxDepthX0       { 25. };    // the shower is cut off after this depth
+      int    spotsPerStep     { 10 };
+
+      // Longitudinal profile: dE/dt = E b (bt)^(a-1) exp(-bt) / Gamma(a), t in X0, with
+      // t_max = (a-1)/b = ln(E/Ec) + C and C = -0.5 for electrons, +0.5 for photons
+      double profile(double t, double a, double b) const {
+        return b * std::pow(b*t, a-1.) * std::exp(-b*t) / std::tgamma(a);
+      }
+
+      // Lateral profile f(r) = 2 r R^2 / (r^2 + R^2)^2 with R = R_M/3, i.e. about 90% within one Moliere radius
+      double sampleRadius() const {
+        double u = G4UniformRand();
+        return (moliereRadius/3.) * std::sqrt(u/(1.-u));
+      }
+  };
+}
+
+namespace dd4hep {
+  namespace sim {
+
+    using namespace ToyCalorimeter;
+
+    template <> void Geant4FSShowerModel<ToyEMShowerParams>::initialize()    {
+      declareProperty("RadiationLength", locals.radiationLength);
+      declareProperty("MoliereRadius",   locals.moliereRadius);
+      declareProperty("CriticalEnergy",  locals.criticalEnergy);
+      declareProperty("StepX0",          locals.stepX0);
+      declareProperty("MaxDepthX0",      locals.maxDepthX0);
+      declareProperty("SpotsPerStep",    locals.spotsPerStep);
+    }
+
+    template <> void Geant4FSShowerModel<ToyEMShowerParams>::modelShower(const G4FastTrack& track, G4FastStep& step)   {
+      const G4Track*      primary   = track.GetPrimaryTrack();
+      G4ThreeVector       origin    = primary->GetPosition();
+      G4ThreeVector       direction = primary->GetMomentumDirection();
+      G4ThreeVector       axis1     = direction.orthogonal().unit();
+      G4ThreeVector       axis2     = direction.cross(axis1);
+      double              energy    = primary->GetKineticEnergy();
+      const G4ParticleDefinition* particle = primary->GetDefinition();
+
+      bool   isCharged = particle == G4Electron::Definition() || particle == G4Positron::Definition();
+      double b         = 0.5;
+      double tmax      = std::max(std::log(energy/locals.criticalEnergy) + (isCharged ? -0.5 : 0.5), 0.);
+      double a         = b*tmax + 1.;
+
+      // Weight of every longitudinal step, normalised to deposit the full energy within maxDepthX0
+      int nSteps = std::max(int(locals.maxDepthX0/locals.stepX0), 1);
+      std::vector<double> weights(nSteps);
+      double sum = 0.;
+      for (int i=0; i<nSteps; i++) {
+        weights[i] = locals.profile((i+0.5)*locals.stepX0, a, b);
+        sum += weights[i];
+      }
+
+      int nSpots = std::max(locals.spotsPerStep, 1);
+      for (int i=0; i<nSteps; i++) {
+        double stepEnergy = energy * weights[i] / sum;
+        if ( stepEnergy <= 0. ) continue;
+        G4ThreeVector centre = origin + direction * ((i+0.5)*locals.stepX0*locals.radiationLength);
+        for (int j=0; j<nSpots; j++) {
+          double r   = locals.sampleRadius();
+          double phi = CLHEP::twopi * G4UniformRand();
+          G4ThreeVector position = centre + r*(std::cos(phi)*axis1 + std::sin(phi)*axis2);
+          // Spots outside the sensitive crystals are lost, as leakage would be in full simulation
+          locals.hitMaker.make(G4FastHit(position, stepEnergy/nSpots), track);
+        }
+      }
+      this->killShower(step, energy);
+    }
+  }
+}
+
+namespace dd4hep { namespace sim {
+    typedef Geant4FSShowerModel<ToyEMShowerParams> ToyEMShowerModel;
+}}
+
+// Declare the shower model and set the name to be used in the steering file
+DECLARE_GEANT4ACTION(ToyEMShowerModel)
@@ -0,0 +1,118 @@
+#include "ToyFrameWriter.h"
+#include <podio/ROOTWriter.h>
+#include <podio/podioVersion.h>
+#ifdef TOYCALO_USE_RNTUPLE
+#if podio_VERSION_MAJOR > 0
+#include <podio/RNTupleWriter.h>
+#else
+#include <podio/ROOTNTupleWriter.h>
+#endif
+#endif
+#include <Compression.h>
+#include <TFile.h>
+#include <TROOT.h>
+#include <TTree.h>
+#include <TVirtualMutex.h>
+#include <set>
+#include <stdexcept>
+
+namespace {
+
+  using namespace ToyCalorimeter;
+
+  // The file podio::ROOTWriter opened for fileName. podio does not hand it out, and gFile is global: another
+  // thread may have opened or changed directory since. ROOT lists every open file, under gROOTMutex.
+  TFile* openedFile(const std::string& fileName) {
+    R__LOCKGUARD(gROOTMutex);
+    TFile* found = nullptr;
+    for ( auto* object : *gROOT->GetListOfFiles() ) {
+      auto* file = dynamic_cast<TFile*>(object);
+      if ( file && file->IsWritable() && fileName == file->GetName() ) found = file;
+    }
+    if ( !found ) throw std::runtime_error("podio opened no writable file " + fileName);
+    return found;
+  }
+
+  class TTreeFrameWriter : public ToyFrameWriter {
+    public:
+      TTreeFrameWriter(const std::string& fileName, const ToyWriterOptions& options)
+        : m_writer(fileName), m_file(openedFile(fileName)), m_flushSize(options.flushSize)
+      {
+        // Branches created later take over the settings of the file
+        const int settings = options.compressionSettings();
+        if ( settings >= 0 ) m_file->SetCompressionSettings(settings);
+      }
+
+      void writeFrame(const podio::Frame& frame, const std::string& category) override {
+        m_writer.writeFrame(frame, category);
+        // podio creates the tree of a category with its first frame
+        if ( m_flushSize > 0 && m_tuned.insert(category).second ) {
+          if ( auto* tree = m_file->Get<TTree>(category.c_str()) ) tree->SetAutoFlush(-m_flushSize);
+        }
+      }
+
+      void finish() override { m_writer.finish(); }
+
+    private:
+      podio::ROOTWriter     m_writer;
+      TFile*                m_file;
+      int                   m_flushSize;
+      std::set<std::string> m_tuned;
+  };
+
+#ifdef TOYCALO_USE_RNTUPLE
+  class RNTupleFrameWriter : public ToyFrameWriter {
+    public:
+      explicit RNTupleFrameWriter(const std::string& fileName) : m_writer(fileName) {}
+      void writeFrame(const podio::Frame& frame, const std::string& category) override { m_writer.writeFrame(frame, category); }
+      void finish() override { m_writer.finish(); }
+
+    private:
+#if podio_VERSION_MAJOR > 0
+      podio::RNTupleWriter     m_writer;
+#else
+      podio::ROOTNTupleWriter  m_writer;
+#endif
+  };
+#endif
+}
+
+namespace ToyCalorimeter {
+
+  int ToyWriterOptions::compressionSettings() const {
+    using Algorithm = ROOT::RCompressionSetting::EAlgorithm;
+    if ( compression.empty() ) return level >= 0 ? ROOT::CompressionSettings(Algorithm::kUseGlobal, level) : -1;
+    if ( compression == "ZSTD" ) return ROOT::CompressionSettings(Algorithm::kZSTD, level >= 0 ? level : 5);
+    if ( compression == "LZ4" )  return ROOT::CompressionSettings(Algorithm::kLZ4,  level >= 0 ? level : 4);
+    if ( compression == "LZMA" ) return ROOT::CompressionSettings(Algorithm::kLZMA, level >= 0 ? level : 7);
+    if ( compression == "ZLIB" ) return ROOT::CompressionSettings(Algorithm::kZLIB, level >= 0 ? level : 1);
+    throw std::invalid_argument("unknown compression algorithm " + compression + " (ZSTD, LZ4, LZMA or ZLIB)");
+  }
+
+  void ToyWriterOptions::validate() const {
+    if ( backend == "TTree" ) {
+      compressionSettings();
+      return;
+    }
+    if ( backend != "RNTuple" ) {
+      throw std::invalid_argument("unknown output backend " + backend + " (TTree or RNTuple)");
+    }
+#ifndef TOYCALO_USE_RNTUPLE
+    throw std::invalid_argument("RNTuple output needs a build with TOYCALO_USE_RNTUPLE and a podio with RNTuple support");
+#endif
+    // The podio RNTuple writer builds its RNTupleWriteOptions itself
+    if ( !compression.empty() || level >= 0 || flushSize > 0 ) {
+      throw std::invalid_argument("the podio RNTuple writer takes no Compression, CompressionLevel or FlushSize, "
+                                  "leave them unset for RNTuple output");
+    }
+  }
+
+  std::unique_ptr<ToyFrameWriter> ToyFrameWriter::create(const std::string& fileName, const ToyWriterOptions& options) {
+    options.validate();
+#ifdef TOYCALO_USE_RNTUPLE
+    if ( options.backend == "RNTuple" ) return std::make_unique<RNTupleFrameWriter>(fileName);
+#endif
+    return std::make_unique<TTreeFrameWriter>(fileName, options);
+  }
+
+}
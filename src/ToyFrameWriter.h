@@ -0,0 +1,60 @@
+#ifndef ToyFrameWriter_h
+#define ToyFrameWriter_h 1
+#include <podio/Frame.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ToyCalorimeter {
+
+  // Output settings of a podio file
+  struct ToyWriterOptions {
+    std::string backend     {"TTree"};   // TTree or RNTuple (needs TOYCALO_USE_RNTUPLE)
+    std::string compression {};          // ZSTD, LZ4, LZMA or ZLIB, empty for the ROOT default
+    int         level       {-1};        // compression level, -1 for the default of the algorithm
+    int         flushSize   {0};         // bytes buffered per TTree before a cluster is flushed, 0 for the ROOT default
+
+    // ROOT compression settings (algorithm*100 + level), -1 if not set. Throws on unknown algorithms
+    int compressionSettings() const;
+
+    // Throws std::invalid_argument for an unknown backend or algorithm, or for TTree settings given to RNTuple
+    void validate() const;
+  };
+
+  // Parameters of the metadata frame, collected while the run goes on and written once at its end
+  struct ToyMetadata {
+    std::map<std::string, std::string>        strings;
+    std::map<std::string, std::vector<int>>   ints;
+    std::map<std::string, std::vector<float>> floats;
+
+    // Entries already present are kept
+    void merge(const ToyMetadata& other) {
+      strings.insert(other.strings.begin(), other.strings.end());
+      ints.insert(other.ints.begin(), other.ints.end());
+      floats.insert(other.floats.begin(), other.floats.end());
+    }
+    void fill(podio::Frame& frame) const {
+      for (const auto& [name, value] : strings) frame.putParameter(name, value);
+      for (const auto& [name, value] : ints)    frame.putParameter(name, value);
+      for (const auto& [name, value] : floats)  frame.putParameter(name, value);
+    }
+  };
+
+  // podio::ROOTWriter or the podio RNTuple writer behind one interface.
+  // podio opens the file itself and takes no write options, so the TTree settings are applied to the file and
+  // to its trees after podio created them. The RNTuple writer uses the podio defaults and takes no options:
+  // create() rejects compression and flush settings for it before any file is opened.
+  class ToyFrameWriter {
+    public:
+      static std::unique_ptr<ToyFrameWriter> create(const std::string& fileName, const ToyWriterOptions& options = {});
+
+      virtual ~ToyFrameWriter() = default;
+      virtual void writeFrame(const podio::Frame& frame, const std::string& category) = 0;
+      virtual void finish() = 0;
+  };
+
+}
+
+#endif
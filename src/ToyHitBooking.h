@@ -0,0 +1,51 @@
+#ifndef ToyHitBooking_h
+#define ToyHitBooking_h 1
+#include "ToySegmentation.h"
+#include "ToyCellAccumulator.h"
+#include "DDG4/Geant4HitCollection.h"
+
+namespace ToyCalorimeter {
+
+  // Per-step bookkeeping of the ToyCalorimeter sensitive actions, shared with benchmarks/SensitiveBenchmarks.cpp
+  // so that the benchmark times the code process() runs.
+
+  // Steps with at most this deposit (MeV) book their cell but add no energy. Fast simulation spots have no threshold.
+  constexpr double kStepEnergyThreshold = 0.1;
+  inline bool   aboveStepThreshold(double edep) { return edep > kStepEnergyThreshold; }
+  inline double stepDeposit(double edep)        { return aboveStepThreshold(edep) ? edep : 0.0; }
+
+  // Hit of a cell in the collection of the event. On the first deposit in the cell it is created at the cell
+  // centre as a POOLED (the pooled type of HIT) and created is set.
+  template <typename HIT, typename POOLED = HIT>
+  HIT* findOrCreateHit(dd4hep::sim::Geant4HitCollection* coll, const dd4hep::DDSegmentation::ToySegmentation& segmentation,
+                       dd4hep::DDSegmentation::CellID cellID, bool& created) {
+    HIT* hit = coll->findByKey<HIT>(cellID);
+    created = !hit;
+    if ( created ) {
+      const auto pos = segmentation.position(cellID);
+      hit = new POOLED(dd4hep::Position(pos.x(), pos.y(), pos.z()));
+      hit->cellID = cellID;
+      coll->add(cellID, hit);
+    }
+    return hit;
+  }
+
+  // Dense accumulation, end of the event: one hit per touched cell with the summed energy.
+  // complete(cell, hit) adds whatever else the action keeps per cell; the accumulator is reset afterwards.
+  template <typename HIT, typename POOLED, typename COMPLETE>
+  void createDenseHits(ToyCellAccumulator& cells, const dd4hep::DDSegmentation::ToySegmentation& segmentation,
+                       dd4hep::sim::Geant4HitCollection* coll, COMPLETE&& complete) {
+    for ( const auto& cell : cells.touched() ) {
+      const auto pos = segmentation.position(cell.cellID);
+      HIT* hit = new POOLED(dd4hep::Position(pos.x(), pos.y(), pos.z()));
+      hit->cellID = cell.cellID;
+      hit->energyDeposit = cells.energy(cell.index);
+      complete(cell, hit);
+      coll->add(cell.cellID, hit);
+    }
+    cells.reset();
+  }
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef ToyHitPool_h
+#define ToyHitPool_h 1
+#include "G4Allocator.hh"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace ToyCalorimeter {
+
+  // Per-thread bookkeeping of a hit pool. allocated/released are only filled while counting is enabled,
+  // pages is the number of heap allocations the pool itself has made on this thread.
+  struct ToyHitPoolCounters {
+    long allocated {0};
+    long released  {0};
+    int  pages     {0};
+  };
+
+  // Counting is off by default and switched on per thread (by its SD action), for all hit types at once.
+  // ToyCaloHit then also counts its instances with dd4hep::InstanceCount.
+  inline G4ThreadLocal bool g_hitCounting = false;
+
+  inline void enableHitCounting(bool enable) { g_hitCounting = enable; }
+  inline bool hitCountingEnabled()           { return g_hitCounting; }
+
+  // One G4Allocator per hit type and thread: hit memory is recycled across events instead of going back to the
+  // global heap. Every hit records the pool it came from. Hits are normally deleted with the hit collections by
+  // the thread that created them; a hit deleted on another thread (e.g. a writer thread) is handed back to its
+  // owner, which recycles it on its next allocation. Pools are never destroyed, so a late hit always has an owner.
+  template <typename HIT> class ToyHitPool {
+    public:
+      static void* allocate() {
+        if ( !s_pool ) s_pool = new Pool;
+        if ( s_pool->pending.load(std::memory_order_acquire) ) s_pool->recycle();
+        if ( hitCountingEnabled() ) ++s_counters.allocated;
+        Slot* slot = s_pool->allocator.MallocSingle();
+        slot->owner = s_pool;
+        return slot->hit;
+      }
+
+      static void release(void* hit) {
+        if ( hitCountingEnabled() ) ++s_counters.released;
+        Slot* slot = reinterpret_cast<Slot*>(static_cast<unsigned char*>(hit) - offsetof(Slot, hit));
+        if ( slot->owner == s_pool ) s_pool->allocator.FreeSingle(slot);
+        else slot->owner->handBack(slot);
+      }
+
+      static ToyHitPoolCounters counters() {
+        ToyHitPoolCounters c = s_counters;
+        c.pages = s_pool ? s_pool->allocator.GetNoPages() : 0;
+        return c;
+      }
+
+    private:
+      struct Pool;
+      struct Slot {
+        Pool*                      owner;
+        alignas(HIT) unsigned char hit[sizeof(HIT)];
+      };
+      struct Pool {
+        G4Allocator<Slot>  allocator;
+        std::mutex         lock;
+        std::vector<Slot*> returned;          // deleted on other threads, freed by the owner
+        std::atomic<bool>  pending {false};
+
+        void handBack(Slot* slot) {
+          std::lock_guard<std::mutex> guard(lock);
+          returned.push_back(slot);
+          pending.store(true, std::memory_order_release);
+        }
+        void recycle() {
+          std::lock_guard<std::mutex> guard(lock);
+          for ( Slot* slot : returned ) allocator.FreeSingle(slot);
+          returned.clear();
+          pending.store(false, std::memory_order_relaxed);
+        }
+      };
+
+      static G4ThreadLocal Pool*              s_pool;
+      static G4ThreadLocal ToyHitPoolCounters s_counters;
+  };
+
+  template <typename HIT> G4ThreadLocal typename ToyHitPool<HIT>::Pool* ToyHitPool<HIT>::s_pool = nullptr;
+  template <typename HIT> G4ThreadLocal ToyHitPoolCounters ToyHitPool<HIT>::s_counters;
+
+  // Pooled version of a hit class we do not own (e.g. Geant4Calorimeter::Hit).
+  // Add it to the collection as a HIT*: the collection deletes it through the virtual
+  // destructor of HIT, which hands the memory back to the pool.
+  template <typename HIT> class ToyPooledHit : public HIT {
+    public:
+      using HIT::HIT;
+
+      void* operator new(std::size_t size) {
+        if ( size != sizeof(ToyPooledHit) ) return ::operator new(size);
+        return ToyHitPool<ToyPooledHit>::allocate();
+      }
+
+      void operator delete(void* hit, std::size_t size) {
+        if ( size != sizeof(ToyPooledHit) ) return ::operator delete(hit);
+        ToyHitPool<ToyPooledHit>::release(hit);
+      }
+  };
+
+}
+
+#endif
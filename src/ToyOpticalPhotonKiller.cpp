@@ -0,0 +1,54 @@
+#include "DDG4/Geant4StackingAction.h"
+#include "DDG4/Factories.h"
+#include "G4OpticalPhoton.hh"
+#include "G4Track.hh"
+#include "G4VProcess.hh"
+
+#include <map>
+#include <string>
+#include <utility>
+
+namespace ToyCalorimeter {
+
+  // Stacking action that kills optical photons as soon as they are created.
+  // Used together with the ParametrizedPhotons mode of ToyCalorimeter_SDAction_Custom,
+  // which adds the expected number of detected photons to the hits instead of tracking them.
+  // With CountPhotons the killed photons are counted per creator process and printed when the (thread's) action
+  // is deleted: the Scintillation count is what the parametrization replaces, see measure_optical.py.
+  class ToyOpticalPhotonKiller : public dd4hep::sim::Geant4StackingAction {
+    public:
+      ToyOpticalPhotonKiller(dd4hep::sim::Geant4Context* ctxt, const std::string& nam)
+        : dd4hep::sim::Geant4StackingAction(ctxt, nam) {
+        declareProperty("Enable", m_enable);
+        declareProperty("CountPhotons", m_countPhotons);
+      }
+      virtual ~ToyOpticalPhotonKiller() {
+        for ( const auto& [process, count] : m_killed ) {
+          always("+++ Killed %ld optical photons created by %s", count.second, count.first.c_str());
+        }
+      }
+
+      virtual dd4hep::sim::TrackClassification classifyNewTrack(G4StackManager* /*mgr*/, const G4Track* track) override {
+        if ( m_enable && track->GetDefinition() == G4OpticalPhoton::Definition() ) {
+          if ( m_countPhotons ) {
+            // Keyed by the process, the name is only copied for the first photon of each
+            const G4VProcess* process = track->GetCreatorProcess();
+            auto killed = m_killed.find(process);
+            if ( killed == m_killed.end() ) {
+              killed = m_killed.emplace(process, std::make_pair(process ? process->GetProcessName() : std::string("no process"), 0L)).first;
+            }
+            ++killed->second.second;
+          }
+          return dd4hep::sim::TrackClassification(fKill);
+        }
+        return dd4hep::sim::TrackClassification();
+      }
+
+    private:
+      bool m_enable {true};
+      bool m_countPhotons {false};
+      std::map<const G4VProcess*, std::pair<std::string, long>> m_killed;
+  };
+}
+
+DECLARE_GEANT4ACTION_NS(ToyCalorimeter,ToyOpticalPhotonKiller)
@@ -0,0 +1,22 @@
+#include "ToySDCounters.h"
+#include <mutex>
+
+namespace {
+  std::mutex s_countersLock;
+  std::map<int, ToyCalorimeter::ToySDRunCounters> s_counters;
+}
+
+namespace ToyCalorimeter {
+
+  void ToySDCounterRegistry::add(int run, const std::string& action, int thread, const ToySDCounters& counters) {
+    std::lock_guard<std::mutex> guard(s_countersLock);
+    s_counters[run][action][thread].merge(counters);
+  }
+
+  ToySDRunCounters ToySDCounterRegistry::counters(int run) {
+    std::lock_guard<std::mutex> guard(s_countersLock);
+    auto it = s_counters.find(run);
+    return it != s_counters.end() ? it->second : ToySDRunCounters{};
+  }
+
+}
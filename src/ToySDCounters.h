@@ -0,0 +1,66 @@
+#ifndef ToySDCounters_h
+#define ToySDCounters_h 1
+#include <chrono>
+#include <map>
+#include <string>
+
+namespace ToyCalorimeter {
+
+  // Hot path bookkeeping of one sensitive action instance, i.e. of one thread.
+  // Hits are created or updated by steps and fast simulation spots alike; in dense mode a hit counts as
+  // created by the first deposit in its cell. ToyCalorimeter_SDAction_Custom counts its ToyCalorimeterHits, the
+  // interesting hits follow the same cells. Only process() is timed.
+  struct ToySDCounters {
+    long                     steps          {0};
+    long                     belowThreshold {0};   // steps with edep <= 0.1 MeV, the deposit is not added
+    long                     spots          {0};
+    long                     hitsCreated    {0};
+    long                     hitsUpdated    {0};
+    std::chrono::nanoseconds processTime    {0};
+
+    void merge(const ToySDCounters& c) {
+      steps          += c.steps;
+      belowThreshold += c.belowThreshold;
+      spots          += c.spots;
+      hitsCreated    += c.hitsCreated;
+      hitsUpdated    += c.hitsUpdated;
+      processTime    += c.processTime;
+    }
+
+    inline void booked(bool created) {
+      if ( created ) ++hitsCreated;
+      else           ++hitsUpdated;
+    }
+  };
+
+  // Adds the wall time of its scope to the counters. With no counters (HotPathCounters = False) the clock is not read.
+  class ToySDProcessTimer {
+    public:
+      explicit ToySDProcessTimer(ToySDCounters* counters) : m_counters(counters) {
+        if ( m_counters ) m_start = std::chrono::steady_clock::now();
+      }
+      ~ToySDProcessTimer() {
+        if ( m_counters ) m_counters->processTime += std::chrono::steady_clock::now() - m_start;
+      }
+      ToySDProcessTimer(const ToySDProcessTimer&) = delete;
+      ToySDProcessTimer& operator=(const ToySDProcessTimer&) = delete;
+
+    private:
+      ToySDCounters*                        m_counters;
+      std::chrono::steady_clock::time_point m_start;
+  };
+
+  // Counters of a run: action name -> thread -> counters
+  typedef std::map<std::string, std::map<int, ToySDCounters>> ToySDRunCounters;
+
+  // Process wide sums of the per-thread counters, filled by the sensitive actions once per event and
+  // read by Geant4EDM4ToyReadout when it writes the run frame
+  class ToySDCounterRegistry {
+    public:
+      static void add(int run, const std::string& action, int thread, const ToySDCounters& counters);
+      static ToySDRunCounters counters(int run);
+  };
+
+}
+
+#endif
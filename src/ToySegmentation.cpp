@@ -1,7 +1,11 @@
 #include "ToySegmentation.h"
+#include <algorithm>
 #include <climits>
 #include <cmath>
 #include <stdexcept>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace dd4hep {
 namespace DDSegmentation {
@@ -13,6 +17,19 @@ ToySegmentation::ToySegmentation(const std::string& cellEncoding) : Segmentation
     registerIdentifier("identifier_phi",    "Cell ID identifier for Phi",    fPhiId,    "phi");
     registerIdentifier("identifier_theta",  "Cell ID identifier for Theta",  fThetaId,  "theta");
     registerIdentifier("identifier_depth",  "Cell ID identifier for Depth",  fDepthId,  "depth");
+    registerParameter("phi_segments",   "Number of crystals in the phi ring, 0 to use saved positions", fPhiSegments, 0);
+    registerParameter("barrel_inner_r", "Inner radius of the barrel", fBarrelInnerR, 0., SegmentationParameter::LengthUnit, true);
+    registerParameter("barrel_outer_r", "Outer radius of the barrel", fBarrelOuterR, 0., SegmentationParameter::LengthUnit, true);
+    registerParameter("grid_nx", "Number of sub-cells along the crystal x axis", fGridNX, 1, SegmentationParameter::NoUnit, true);
+    registerParameter("grid_ny", "Number of sub-cells along the crystal y axis", fGridNY, 1, SegmentationParameter::NoUnit, true);
+    registerParameter("grid_nz", "Number of sub-cells along the crystal z axis", fGridNZ, 1, SegmentationParameter::NoUnit, true);
+    registerParameter("crystal_half_x", "Crystal half length in x", fCrystalHalfX, 0., SegmentationParameter::LengthUnit, true);
+    registerParameter("crystal_half_y", "Crystal half length in y", fCrystalHalfY, 0., SegmentationParameter::LengthUnit, true);
+    registerParameter("crystal_half_z", "Crystal half length in z", fCrystalHalfZ, 0., SegmentationParameter::LengthUnit, true);
+    registerIdentifier("identifier_grid_x", "Cell ID identifier for the sub-cell x index", fGridXId, "x");
+    registerIdentifier("identifier_grid_y", "Cell ID identifier for the sub-cell y index", fGridYId, "y");
+    registerIdentifier("identifier_grid_z", "Cell ID identifier for the sub-cell z index", fGridZId, "z");
+    resolveLayout();
 }
 
 ToySegmentation::ToySegmentation(const BitFieldCoder* decoder) : Segmentation(decoder) {
@@ -22,17 +39,321 @@ ToySegmentation::ToySegmentation(const BitFieldCoder* decoder) : Segmentation(de
     registerIdentifier("identifier_phi",    "Cell ID identifier for Phi",    fPhiId,    "phi");
     registerIdentifier("identifier_theta",  "Cell ID identifier for Theta",  fThetaId,  "theta");
     registerIdentifier("identifier_depth",  "Cell ID identifier for Depth",  fDepthId,  "depth");
+    registerParameter("phi_segments",   "Number of crystals in the phi ring, 0 to use saved positions", fPhiSegments, 0);
+    registerParameter("barrel_inner_r", "Inner radius of the barrel", fBarrelInnerR, 0., SegmentationParameter::LengthUnit, true);
+    registerParameter("barrel_outer_r", "Outer radius of the barrel", fBarrelOuterR, 0., SegmentationParameter::LengthUnit, true);
+    registerParameter("grid_nx", "Number of sub-cells along the crystal x axis", fGridNX, 1, SegmentationParameter::NoUnit, true);
+    registerParameter("grid_ny", "Number of sub-cells along the crystal y axis", fGridNY, 1, SegmentationParameter::NoUnit, true);
+    registerParameter("grid_nz", "Number of sub-cells along the crystal z axis", fGridNZ, 1, SegmentationParameter::NoUnit, true);
+    registerParameter("crystal_half_x", "Crystal half length in x", fCrystalHalfX, 0., SegmentationParameter::LengthUnit, true);
+    registerParameter("crystal_half_y", "Crystal half length in y", fCrystalHalfY, 0., SegmentationParameter::LengthUnit, true);
+    registerParameter("crystal_half_z", "Crystal half length in z", fCrystalHalfZ, 0., SegmentationParameter::LengthUnit, true);
+    registerIdentifier("identifier_grid_x", "Cell ID identifier for the sub-cell x index", fGridXId, "x");
+    registerIdentifier("identifier_grid_y", "Cell ID identifier for the sub-cell y index", fGridYId, "y");
+    registerIdentifier("identifier_grid_z", "Cell ID identifier for the sub-cell z index", fGridZId, "z");
+    resolveLayout();
 }
 
 ToySegmentation::~ToySegmentation() {}
 
+void ToySegmentation::resolveLayout() {
+    fFixedLayout = FixedCoder::matches(*_decoder, fSystemId, fPhiId, fThetaId, fDepthId);
+
+    // Sub-cell fields are optional in the readout <id>
+    auto optionalField = [this](const std::string& name) -> const BitFieldElement* {
+        for (const auto& field : _decoder->fields()) {
+            if (field.name() == name) return &field;
+        }
+        return nullptr;
+    };
+    fGridXField = optionalField(fGridXId);
+    fGridYField = optionalField(fGridYId);
+    fGridZField = optionalField(fGridZId);
+}
+
 Vector3D ToySegmentation::position(const CellID& cID) const {
-    if (fPositionOf.find(cID) != fPositionOf.end()) {
-        return fPositionOf.find(cID)->second;
+    const Vector3D centre = crystalPosition(cID);
+    if (!hasSubCells()) {
+        return centre;
+    }
+    // The crystal's local x axis points along its radius: rotate the sub-cell offset by the crystal's phi
+    const double r = std::hypot(centre.x(), centre.y());
+    if (r == 0) {
+        return centre;
     }
-    return Vector3D(0,0,0);
+    const double cosPhi = centre.x()/r;
+    const double sinPhi = centre.y()/r;
+    const double dx = ((GridX(cID) + 0.5)*2*fCrystalHalfX/fGridNX - fCrystalHalfX)/dd4hep::mm;
+    const double dy = ((GridY(cID) + 0.5)*2*fCrystalHalfY/fGridNY - fCrystalHalfY)/dd4hep::mm;
+    const double dz = ((GridZ(cID) + 0.5)*2*fCrystalHalfZ/fGridNZ - fCrystalHalfZ)/dd4hep::mm;
+    return Vector3D(centre.x() + cosPhi*dx - sinPhi*dy, centre.y() + sinPhi*dx + cosPhi*dy, centre.z() + dz);
 };
 
+Vector3D ToySegmentation::crystalPosition(const CellID& cID) const {
+    if (isAnalytic()) {
+        // Crystals sit at mid radius on the z=0 ring, rotated by phi, in mm like the saved positions.
+        // Any other cell has no crystal in analytic mode, and no position either.
+        const int phi = Phi(cID);
+        if (phi < 0 || phi >= fPhiSegments || Theta(cID) != 0 || Depth(cID) != 0) {
+            throw std::runtime_error("ToySegmentation: cell is not on the analytic ring (phi below phi_segments, theta and depth 0)");
+        }
+        const double r = 0.5*(fBarrelInnerR + fBarrelOuterR)/dd4hep::mm;
+        const double angle = phi*(2*M_PI/fPhiSegments);
+        return Vector3D(r*std::cos(angle), r*std::sin(angle), 0);
+    }
+    const long idx = crystalIndex(cID);
+    if (idx < 0) {
+        return Vector3D(0,0,0);
+    }
+    return Vector3D(fPosX[idx], fPosY[idx], fPosZ[idx]);
+}
+
+void ToySegmentation::savePosition(int volID_32, Vector3D pos) {
+    if (fFrozen) {
+        throw std::runtime_error("ToySegmentation: cannot save a position after the position table is frozen");
+    }
+    fPendingPositions.emplace_back(volID_32, pos);
+}
+
+void ToySegmentation::bindFields() {
+    // Identifier names may have been changed from the compact XML after construction
+    resolveLayout();
+    fPhiField   = &(*_decoder)[fPhiId];
+    fThetaField = &(*_decoder)[fThetaId];
+    fDepthField = &(*_decoder)[fDepthId];
+
+    if (hasSubCells()) {
+        auto checkGrid = [](const BitFieldElement* field, int n, double halfLength) {
+            if (n < 1 || (n > 1 && halfLength <= 0)) {
+                throw std::runtime_error("ToySegmentation: sub-cell grid needs n >= 1 and a positive crystal half length");
+            }
+            if (n > 1 && (!field || n > (1L << field->width()))) {
+                throw std::runtime_error("ToySegmentation: readout <id> has no field wide enough for the sub-cell grid");
+            }
+        };
+        checkGrid(fGridXField, fGridNX, fCrystalHalfX);
+        checkGrid(fGridYField, fGridNY, fCrystalHalfY);
+        checkGrid(fGridZField, fGridNZ, fCrystalHalfZ);
+    }
+}
+
+void ToySegmentation::freezePositions() {
+    if (fFrozen) return;
+
+    bindFields();
+    if (isAnalytic()) {
+        if (!fPendingPositions.empty()) {
+            throw std::runtime_error("ToySegmentation: positions were saved for a segmentation in analytic mode");
+        }
+        if (fPhiSegments > (1L << fPhiField->width())) {
+            throw std::runtime_error("ToySegmentation: phi_segments exceeds the readout bit field width");
+        }
+        fNPhi   = fPhiSegments;
+        fNTheta = 1;
+        fNDepth = 1;
+        fFrozen = true;
+        return;
+    }
+
+    // The table extent of each field is its highest saved index + 1, bounded by the field's bit width.
+    // Sizing by the full bit widths (2^27 cells for phi:9,theta:9,depth:9) would waste gigabytes.
+    long nPhi = 0, nTheta = 0, nDepth = 0;
+    for (const auto& [volID_32, pos] : fPendingPositions) {
+        const CellID cID = convertFirst32to64(volID_32);
+        nPhi   = std::max(nPhi,   static_cast<long>(fPhiField->value(cID))   + 1);
+        nTheta = std::max(nTheta, static_cast<long>(fThetaField->value(cID)) + 1);
+        nDepth = std::max(nDepth, static_cast<long>(fDepthField->value(cID)) + 1);
+    }
+    if (nPhi   > (1L << fPhiField->width())   ||
+        nTheta > (1L << fThetaField->width()) ||
+        nDepth > (1L << fDepthField->width())) {
+        throw std::runtime_error("ToySegmentation: cell index exceeds the readout bit field width");
+    }
+
+    const std::size_t nCells = static_cast<std::size_t>(nPhi*nTheta*nDepth);
+    fPosX.assign(nCells, 0.);
+    fPosY.assign(nCells, 0.);
+    fPosZ.assign(nCells, 0.);
+    fNPhi   = nPhi;
+    fNTheta = nTheta;
+    fNDepth = nDepth;
+    fFrozen = true;
+
+    for (const auto& [volID_32, pos] : fPendingPositions) {
+        const long idx = crystalIndex(convertFirst32to64(volID_32));
+        if (idx < 0) {
+            throw std::runtime_error("ToySegmentation: negative cell index in saved position");
+        }
+        fPosX[idx] = pos.x();
+        fPosY[idx] = pos.y();
+        fPosZ[idx] = pos.z();
+    }
+    fPendingPositions.clear();
+    fPendingPositions.shrink_to_fit();
+}
+
+
+std::vector<std::pair<std::string, long>> ToySegmentation::cellIndexLayout() const {
+    std::vector<std::pair<std::string, long>> layout;
+    if (hasSubCells()) {
+        if (fGridNX > 1) layout.emplace_back(fGridXId, fGridNX);
+        if (fGridNY > 1) layout.emplace_back(fGridYId, fGridNY);
+        if (fGridNZ > 1) layout.emplace_back(fGridZId, fGridNZ);
+    }
+    layout.emplace_back(fPhiId, fNPhi);
+    layout.emplace_back(fThetaId, fNTheta);
+    layout.emplace_back(fDepthId, fNDepth);
+    return layout;
+}
+
+void ToySegmentation::buildNeighbourTable() {
+    if (!fFrozen) {
+        throw std::runtime_error("ToySegmentation: the neighbour table needs a frozen segmentation");
+    }
+    const long nSub = subCellsPerCrystal();
+    const std::size_t nCells = numberOfCells();
+    if (nCells*(27*nSub) > UINT32_MAX) {
+        throw std::runtime_error("ToySegmentation: too many cells for a 32 bit neighbour table");
+    }
+
+    // Touching crystals of every crystal; duplicates appear when the ring has fewer than 3 phi cells
+    std::vector<uint32_t> offsets, crystals;
+    offsets.reserve(numberOfCrystals()+1);
+    offsets.push_back(0);
+    std::vector<long> touching;
+    for (long depth = 0; depth < fNDepth; depth++) {
+        for (long theta = 0; theta < fNTheta; theta++) {
+            for (long phi = 0; phi < fNPhi; phi++) {
+                touching.clear();
+                for (long dd = -1; dd <= 1; dd++) {
+                    if (depth+dd < 0 || depth+dd >= fNDepth) continue;
+                    for (long dt = -1; dt <= 1; dt++) {
+                        if (theta+dt < 0 || theta+dt >= fNTheta) continue;
+                        for (long dp = -1; dp <= 1; dp++) {
+                            const long p = (phi + dp + fNPhi) % fNPhi;
+                            touching.push_back(p + fNPhi*((theta+dt) + fNTheta*(depth+dd)));
+                        }
+                    }
+                }
+                std::sort(touching.begin(), touching.end());
+                touching.erase(std::unique(touching.begin(), touching.end()), touching.end());
+                crystals.insert(crystals.end(), touching.begin(), touching.end());
+                offsets.push_back(crystals.size());
+            }
+        }
+    }
+
+    // Expand to cells: every sub-cell of the touching crystals, except the cell itself
+    fNeighbourOffsets.assign(1, 0);
+    fNeighbourOffsets.reserve(nCells+1);
+    fNeighbourIndices.clear();
+    fNeighbourIndices.reserve((crystals.size()*nSub - numberOfCrystals())*nSub);
+    for (std::size_t crystal = 0; crystal < numberOfCrystals(); crystal++) {
+        for (long sub = 0; sub < nSub; sub++) {
+            const uint32_t self = crystal*nSub + sub;
+            for (uint32_t k = offsets[crystal]; k < offsets[crystal+1]; k++) {
+                for (long other = 0; other < nSub; other++) {
+                    const uint32_t cell = crystals[k]*nSub + other;
+                    if (cell != self) fNeighbourIndices.push_back(cell);
+                }
+            }
+            fNeighbourOffsets.push_back(fNeighbourIndices.size());
+        }
+    }
+}
+
+void ToySegmentation::neighbours(const CellID& cellID, std::set<CellID>& cellNeighbours) const {
+    const long index = cellIndex(cellID);
+    if (index < 0 || !hasNeighbourTable()) return;
+    const int system = System(cellID);
+    for (const uint32_t n : neighbours(index)) {
+        const CellID base = cellIDOfIndex(n);
+        const CellID id = setCellID(system, Phi(base), Theta(base), Depth(base));
+        cellNeighbours.insert(hasSubCells() ? setSubCell(id, GridX(base), GridY(base), GridZ(base)) : id);
+    }
+}
+
+void ToySegmentation::decode(std::span<const CellID> cellIDs,
+                             std::span<int> system, std::span<int> phi, std::span<int> theta, std::span<int> depth) const {
+    const std::size_t n = cellIDs.size();
+    if (system.size() < n || phi.size() < n || theta.size() < n || depth.size() < n) {
+        throw std::runtime_error("ToySegmentation::decode: output span is smaller than the input");
+    }
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    if (fFixedLayout) {
+        // Four 64 bit IDs per iteration; the permutation gathers the low 32 bits of each lane into 128 bits
+        const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        const __m256i systemMask = _mm256_set1_epi64x(static_cast<long long>(FixedCoder::kSystemMask));
+        const __m256i phiMask    = _mm256_set1_epi64x(static_cast<long long>(FixedCoder::kPhiMask));
+        const __m256i thetaMask  = _mm256_set1_epi64x(static_cast<long long>(FixedCoder::kThetaMask));
+        const __m256i depthMask  = _mm256_set1_epi64x(static_cast<long long>(FixedCoder::kDepthMask));
+        auto store = [&pack](int* out, __m256i v) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, pack)));
+        };
+        for (; i + 4 <= n; i += 4) {
+            const __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cellIDs.data() + i));
+            store(system.data() + i, _mm256_and_si256(_mm256_srli_epi64(ids, FixedCoder::kSystemOffset), systemMask));
+            store(phi.data()    + i, _mm256_and_si256(_mm256_srli_epi64(ids, FixedCoder::kPhiOffset),    phiMask));
+            store(theta.data()  + i, _mm256_and_si256(_mm256_srli_epi64(ids, FixedCoder::kThetaOffset),  thetaMask));
+            store(depth.data()  + i, _mm256_and_si256(_mm256_srli_epi64(ids, FixedCoder::kDepthOffset),  depthMask));
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        system[i] = System(cellIDs[i]);
+        phi[i]    = Phi(cellIDs[i]);
+        theta[i]  = Theta(cellIDs[i]);
+        depth[i]  = Depth(cellIDs[i]);
+    }
+}
+
+void ToySegmentation::positions(std::span<const CellID> cellIDs,
+                                std::span<double> x, std::span<double> y, std::span<double> z) const {
+    const std::size_t n = cellIDs.size();
+    if (x.size() < n || y.size() < n || z.size() < n) {
+        throw std::runtime_error("ToySegmentation::positions: output span is smaller than the input");
+    }
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    if (fFixedLayout && fFrozen && !isAnalytic() && !hasSubCells()) {
+        // Decode four IDs, compute their table indices in 32 bit lanes and gather x/y/z.
+        // Cells outside the table are masked off and come out as (0,0,0), like position().
+        const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        const __m256i phiMask   = _mm256_set1_epi64x(static_cast<long long>(FixedCoder::kPhiMask));
+        const __m256i thetaMask = _mm256_set1_epi64x(static_cast<long long>(FixedCoder::kThetaMask));
+        const __m256i depthMask = _mm256_set1_epi64x(static_cast<long long>(FixedCoder::kDepthMask));
+        const __m128i nPhi   = _mm_set1_epi32(static_cast<int>(fNPhi));
+        const __m128i nTheta = _mm_set1_epi32(static_cast<int>(fNTheta));
+        const __m128i nDepth = _mm_set1_epi32(static_cast<int>(fNDepth));
+        const __m256d zero   = _mm256_setzero_pd();
+        auto field = [&pack](__m256i ids, int offset, __m256i mask) {
+            const __m256i v = _mm256_and_si256(_mm256_srl_epi64(ids, _mm_cvtsi32_si128(offset)), mask);
+            return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, pack));
+        };
+        for (; i + 4 <= n; i += 4) {
+            const __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cellIDs.data() + i));
+            const __m128i p = field(ids, FixedCoder::kPhiOffset,   phiMask);
+            const __m128i t = field(ids, FixedCoder::kThetaOffset, thetaMask);
+            const __m128i d = field(ids, FixedCoder::kDepthOffset, depthMask);
+            const __m128i valid = _mm_and_si128(_mm_cmplt_epi32(p, nPhi),
+                                  _mm_and_si128(_mm_cmplt_epi32(t, nTheta), _mm_cmplt_epi32(d, nDepth)));
+            const __m128i idx = _mm_and_si128(valid,
+                _mm_add_epi32(p, _mm_mullo_epi32(nPhi, _mm_add_epi32(t, _mm_mullo_epi32(nTheta, d)))));
+            const __m256d mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(valid));
+            _mm256_storeu_pd(x.data() + i, _mm256_mask_i32gather_pd(zero, fPosX.data(), idx, mask, 8));
+            _mm256_storeu_pd(y.data() + i, _mm256_mask_i32gather_pd(zero, fPosY.data(), idx, mask, 8));
+            _mm256_storeu_pd(z.data() + i, _mm256_mask_i32gather_pd(zero, fPosZ.data(), idx, mask, 8));
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        const Vector3D pos = position(cellIDs[i]);
+        x[i] = pos.x();
+        y[i] = pos.y();
+        z[i] = pos.z();
+    }
+}
 
 }
 }
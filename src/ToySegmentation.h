@@ -3,28 +3,102 @@
 #include "DDSegmentation/Segmentation.h"
 #include "Math/Vector3D.h"
 #include "DD4hep/DetFactoryHelper.h"
+#include "ToyCellIDCoder.h"
 #include <vector>
+#include <set>
+#include <span>
+#include <string>
+#include <cstdint>
 #include <cmath>
 #include <climits>
+#include <stdexcept>
 
 namespace dd4hep {
 namespace DDSegmentation {
 
 class ToySegmentation : public Segmentation {
     public:
+        typedef ToyDefaultCellIDCoder FixedCoder;
+
         ToySegmentation(const std::string& aCellEncoding);
         ToySegmentation(const BitFieldCoder* decoder);
         virtual ~ToySegmentation() override;
 
         virtual Vector3D position(const CellID& aCellID) const override;
 
-        CellID cellID(const Vector3D& /*localPosition*/, 
-            const Vector3D& /*globalPosition*/, 
+        // In analytic mode phi is computed from the global position, otherwise the volume ID is passed through.
+        // Analytic mode rejects volumes off the single ring it describes instead of moving them onto it.
+        // With a sub-cell grid the local position selects the sub-cell inside the crystal.
+        CellID cellID(const Vector3D& localPosition, 
+            const Vector3D& globalPosition, 
             const VolumeID& vID) const override {
-            return setCellID(System(vID), Phi(vID), Theta(vID), Depth(vID) );
+            if (isAnalytic() && (Theta(vID) != 0 || Depth(vID) != 0)) {
+                throw std::runtime_error("ToySegmentation: analytic mode describes a single ring, the volume has theta or depth != 0");
+            }
+            const CellID crystal = isAnalytic()
+                ? analyticCellID(System(vID), globalPosition)
+                : setCellID(System(vID), Phi(vID), Theta(vID), Depth(vID) );
+            if (!hasSubCells()) return crystal;
+            return setSubCell(crystal,
+                              gridIndex(localPosition.x(), fCrystalHalfX, fGridNX),
+                              gridIndex(localPosition.y(), fCrystalHalfY, fGridNY),
+                              gridIndex(localPosition.z(), fCrystalHalfZ, fGridNZ));
         }
 
+        // Analytic mode: cell centres follow from the barrel parameters of the <segmentation> element,
+        // so no positions have to be saved and segmentations not built with the geometry work too
+        bool isAnalytic() const { return fPhiSegments > 0; }
+        int phiSegments() const { return fPhiSegments; }
+        double barrelInnerR() const { return fBarrelInnerR; }
+        double barrelOuterR() const { return fBarrelOuterR; }
+
+        // Phi index of the crystal containing a global position, O(1)
+        inline int analyticPhi(const Vector3D& globalPosition) const {
+            const double dPhi = 2*M_PI/fPhiSegments;
+            double phi = std::atan2(globalPosition.y(), globalPosition.x());
+            if (phi < 0) phi += 2*M_PI;
+            return static_cast<int>(std::floor(phi/dPhi + 0.5)) % fPhiSegments;
+        }
+
+        // Crystal containing a global position, from the barrel parameters alone: no volume ID, touchable or
+        // volume manager lookup. The analytic barrel is a single ring, so theta and depth are always 0:
+        // ToyCalorimeter places no other crystals, and position() throws for cells with any other theta or depth.
+        inline CellID analyticCellID(int system, const Vector3D& globalPosition) const {
+            return setCellID(system, analyticPhi(globalPosition), 0, 0);
+        }
+
+        // Sub-cell grid: every crystal is split into grid_nx x grid_ny x grid_nz readout cells
+        // along its local axes, without placing any extra volumes
+        bool hasSubCells() const { return fGridNX*fGridNY*fGridNZ > 1; }
+        int subCellsPerCrystal() const { return fGridNX*fGridNY*fGridNZ; }
+
+        double crystalHalfX() const { return fCrystalHalfX; }
+        double crystalHalfY() const { return fCrystalHalfY; }
+        double crystalHalfZ() const { return fCrystalHalfZ; }
+
+        // The cell of a step cannot be taken from the touchable copy number, cellID() needs the step position
+        bool needsStepPosition() const { return isAnalytic() || hasSubCells(); }
+
+        // Index of a local coordinate in a grid of n bins over [-halfLength, halfLength], O(1)
+        static inline int gridIndex(double local, double halfLength, int n) {
+            if (n <= 1) return 0;
+            const int i = static_cast<int>(std::floor((local + halfLength)*n/(2*halfLength)));
+            return i < 0 ? 0 : (i >= n ? n-1 : i);
+        }
+
+        CellID setSubCell(CellID crystalID, int GridX, int GridY, int GridZ) const {
+            if (fGridXField) fGridXField->set(crystalID, GridX);
+            if (fGridYField) fGridYField->set(crystalID, GridY);
+            if (fGridZField) fGridZField->set(crystalID, GridZ);
+            return crystalID;
+        }
+
+        int GridX(const CellID& aCellID) const { return fGridXField ? static_cast<int>(fGridXField->value(aCellID)) : 0; }
+        int GridY(const CellID& aCellID) const { return fGridYField ? static_cast<int>(fGridYField->value(aCellID)) : 0; }
+        int GridZ(const CellID& aCellID) const { return fGridZField ? static_cast<int>(fGridZField->value(aCellID)) : 0; }
+
         VolumeID setVolumeID(int System, int Phi, int Theta, int Depth) const {
+            if (fFixedLayout) return FixedCoder::encode(System, Phi, Theta, Depth);
             VolumeID SystemId = static_cast<VolumeID>(System);
             VolumeID PhiId = static_cast<VolumeID>(Phi);
             VolumeID ThetaId = static_cast<VolumeID>(Theta);
@@ -38,6 +112,7 @@ class ToySegmentation : public Segmentation {
         }
 
         CellID setCellID(int System, int Phi, int Theta, int Depth) const {
+            if (fFixedLayout) return FixedCoder::encode(System, Phi, Theta, Depth);
             VolumeID SystemId = static_cast<VolumeID>(System);
             VolumeID PhiId = static_cast<VolumeID>(Phi);
             VolumeID ThetaId = static_cast<VolumeID>(Theta);
@@ -51,21 +126,25 @@ class ToySegmentation : public Segmentation {
         }
         
         int System(const CellID& aCellID) const {
+            if (fFixedLayout) return FixedCoder::system(aCellID);
             VolumeID System = static_cast<VolumeID>(_decoder->get(aCellID, fSystemId));
             return static_cast<int>(System);
         }
         
         int Phi(const CellID& aCellID) const {
+            if (fFixedLayout) return FixedCoder::phi(aCellID);
             VolumeID Phi = static_cast<VolumeID>(_decoder->get(aCellID, fPhiId));
             return static_cast<int>(Phi);
         }
         
         int Theta(const CellID& aCellID) const {
+            if (fFixedLayout) return FixedCoder::theta(aCellID);
             VolumeID Theta = static_cast<VolumeID>(_decoder->get(aCellID, fThetaId));
             return static_cast<int>(Theta);
         }
         
         int Depth(const CellID& aCellID) const {
+            if (fFixedLayout) return FixedCoder::depth(aCellID);
             VolumeID Depth = static_cast<VolumeID>(_decoder->get(aCellID, fDepthId));
             return static_cast<int>(Depth);
         }
@@ -89,7 +168,84 @@ class ToySegmentation : public Segmentation {
         int Theta(const int& aId32) const { return Theta( convertFirst32to64(aId32) ); }
         int Depth(const int& aId32) const { return Depth( convertFirst32to64(aId32) ); }
 
-        inline void savePosition(int volID_32, Vector3D pos) {fPositionOf.emplace(volID_32,pos);}
+        // Positions are staged while the geometry is built and moved into the dense table by freezePositions()
+        void savePosition(int volID_32, Vector3D pos);
+
+        // Build the dense (phi, theta, depth) position table; no positions can be saved afterwards
+        void freezePositions();
+        bool isFrozen() const { return fFrozen; }
+
+        // Dense index of a crystal in the position table, -1 if the crystal is not in the table.
+        // In analytic mode the table has the extents of the ring but no stored positions.
+        inline long crystalIndex(const CellID& aCellID) const {
+            if (!fFrozen) return -1;
+            const long phi   = fFixedLayout ? FixedCoder::phi(aCellID)   : static_cast<long>(fPhiField->value(aCellID));
+            const long theta = fFixedLayout ? FixedCoder::theta(aCellID) : static_cast<long>(fThetaField->value(aCellID));
+            const long depth = fFixedLayout ? FixedCoder::depth(aCellID) : static_cast<long>(fDepthField->value(aCellID));
+            if (phi < 0 || phi >= fNPhi || theta < 0 || theta >= fNTheta || depth < 0 || depth >= fNDepth) return -1;
+            return phi + fNPhi*(theta + fNTheta*depth);
+        }
+        std::size_t numberOfCrystals() const { return static_cast<std::size_t>(fNPhi*fNTheta*fNDepth); }
+
+        // Dense index of a readout cell, sub-cells of a crystal are contiguous. -1 if not in the table.
+        inline long cellIndex(const CellID& aCellID) const {
+            const long crystal = crystalIndex(aCellID);
+            if (crystal < 0 || !hasSubCells()) return crystal;
+            return crystal*subCellsPerCrystal() + GridX(aCellID) + fGridNX*(GridY(aCellID) + fGridNY*GridZ(aCellID));
+        }
+        std::size_t numberOfCells() const { return numberOfCrystals()*subCellsPerCrystal(); }
+
+        // Inverse of cellIndex(): cell ID of a dense index, with the system field left at 0
+        inline CellID cellIDOfIndex(long index) const {
+            const long nSub    = subCellsPerCrystal();
+            const long crystal = index / nSub;
+            const long sub     = index % nSub;
+            const CellID id = setCellID(0, crystal % fNPhi, (crystal / fNPhi) % fNTheta, crystal / (fNPhi*fNTheta));
+            if (!hasSubCells()) return id;
+            return setSubCell(id, sub % fGridNX, (sub / fGridNX) % fGridNY, sub / (fGridNX*fGridNY));
+        }
+
+        // cellIndex() as a mixed-radix number of cell ID fields, least significant first: (field, extent).
+        // Readers can compute the index of a hit from the cell ID encoding alone.
+        std::vector<std::pair<std::string, long>> cellIndexLayout() const;
+
+        // Ring symmetry: the same cell moved by dPhi crystals around the ring, wrapping at numberOfPhiCells().
+        // Needs a frozen segmentation; theta, depth and sub-cell fields are kept.
+        long numberOfPhiCells() const { return fNPhi; }
+        inline CellID rotatePhi(CellID aCellID, long dPhi) const {
+            long phi = (Phi(aCellID) + dPhi) % fNPhi;
+            if (phi < 0) phi += fNPhi;
+            fPhiField->set(aCellID, phi);
+            return aCellID;
+        }
+
+        // Neighbour table over cellIndex(), in CSR form: the neighbours of cell i are
+        // neighbourIndices()[neighbourOffsets()[i] .. neighbourOffsets()[i+1]). Crystals touching in phi (wrapping
+        // around the ring), theta and depth are neighbours, diagonals included. With sub-cells, all sub-cells
+        // of the same and of the touching crystals are neighbours. Built once by buildNeighbourTable() on a
+        // frozen segmentation, read-only afterwards.
+        void buildNeighbourTable();
+        bool hasNeighbourTable() const { return !fNeighbourOffsets.empty(); }
+        std::span<const uint32_t> neighbourOffsets() const { return fNeighbourOffsets; }
+        std::span<const uint32_t> neighbourIndices() const { return fNeighbourIndices; }
+        inline std::span<const uint32_t> neighbours(long index) const {
+            return std::span<const uint32_t>(fNeighbourIndices).subspan(fNeighbourOffsets[index],
+                                                                       fNeighbourOffsets[index+1] - fNeighbourOffsets[index]);
+        }
+
+        // Segmentation interface, from the neighbour table; nothing is added without one
+        virtual void neighbours(const CellID& cellID, std::set<CellID>& neighbours) const override;
+
+        // Batch versions of System/Phi/Theta/Depth and position() for a whole event of cells.
+        // Output spans must hold at least cellIDs.size() entries. Vectorized with AVX2 when built with
+        // TOYCALO_ENABLE_AVX2, benchmarks/SegmentationBatchCheck compares both paths.
+        void decode(std::span<const CellID> cellIDs,
+                    std::span<int> system, std::span<int> phi, std::span<int> theta, std::span<int> depth) const;
+        void positions(std::span<const CellID> cellIDs,
+                       std::span<double> x, std::span<double> y, std::span<double> z) const;
+
+        // True if the readout <id> matches FixedCoder and the compile-time coder is in use
+        bool hasFixedLayout() const { return fFixedLayout; }
 
     // Define the fields for the cellId
     protected:
@@ -98,9 +254,48 @@ class ToySegmentation : public Segmentation {
         std::string fThetaId;
         std::string fDepthId;
 
-    // Lookup map to store cellIds and their positions
+        // Decide between the compile-time and the generic coder, done once per layout
+        void resolveLayout();
+        bool fFixedLayout {false};
+
+        // Barrel parameters for analytic mode, phi_segments = 0 disables it
+        int fPhiSegments;
+        double fBarrelInnerR;
+        double fBarrelOuterR;
+
+        // Sub-cell grid, 1x1x1 is one cell per crystal
+        int fGridNX;
+        int fGridNY;
+        int fGridNZ;
+        double fCrystalHalfX;
+        double fCrystalHalfY;
+        double fCrystalHalfZ;
+        std::string fGridXId;
+        std::string fGridYId;
+        std::string fGridZId;
+
+    // Dense position table, structure-of-arrays indexed by crystalIndex()
+    // Read-only once frozen, so it can be shared by all worker threads
     private:
-        mutable std::unordered_map<int, Vector3D> fPositionOf;
+        Vector3D crystalPosition(const CellID& aCellID) const;
+        void bindFields();
+
+        std::vector<std::pair<int, Vector3D>> fPendingPositions;
+        std::vector<double> fPosX;
+        std::vector<double> fPosY;
+        std::vector<double> fPosZ;
+        long fNPhi   {0};
+        long fNTheta {0};
+        long fNDepth {0};
+        bool fFrozen {false};
+        const BitFieldElement* fPhiField   {nullptr};
+        const BitFieldElement* fThetaField {nullptr};
+        const BitFieldElement* fDepthField {nullptr};
+        const BitFieldElement* fGridXField {nullptr};
+        const BitFieldElement* fGridYField {nullptr};
+        const BitFieldElement* fGridZField {nullptr};
+        std::vector<uint32_t> fNeighbourOffsets;
+        std::vector<uint32_t> fNeighbourIndices;
 
 };
 }
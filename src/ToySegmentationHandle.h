@@ -48,12 +48,28 @@ public:
     inline int Theta(const CellID& aCellID) const { return access()->implementation->Theta(aCellID); }
     inline int Depth(const CellID& aCellID) const { return access()->implementation->Depth(aCellID); }
 
+    inline CellID setSubCell(const CellID& crystalID, int GridX, int GridY, int GridZ) const {
+        return access()->implementation->setSubCell(crystalID, GridX, GridY, GridZ);
+    }
+    inline int GridX(const CellID& aCellID) const { return access()->implementation->GridX(aCellID); }
+    inline int GridY(const CellID& aCellID) const { return access()->implementation->GridY(aCellID); }
+    inline int GridZ(const CellID& aCellID) const { return access()->implementation->GridZ(aCellID); }
+
     inline int getFirst32bits(const CellID& aCellID) const { return access()->implementation->getFirst32bits(aCellID); }
     inline int getLast32bits(const CellID& aCellID) const { return access()->implementation->getLast32bits(aCellID); }
 
     inline CellID convertFirst32to64(const int aId32) const { return access()->implementation->convertFirst32to64(aId32); }
     inline CellID convertLast32to64(const int aId32) const { return access()->implementation->convertLast32to64(aId32); }
 
+    inline void decode(std::span<const CellID> cellIDs,
+                       std::span<int> system, std::span<int> phi, std::span<int> theta, std::span<int> depth) const {
+        access()->implementation->decode(cellIDs, system, phi, theta, depth);
+    }
+    inline void positions(std::span<const CellID> cellIDs,
+                          std::span<double> x, std::span<double> y, std::span<double> z) const {
+        access()->implementation->positions(cellIDs, x, y, z);
+    }
+
     inline int System(const int& aId32) const { return access()->implementation->System(aId32); }
     inline int Phi(const int& aId32) const { return access()->implementation->Phi(aId32); }
     inline int Theta(const int& aId32) const { return access()->implementation->Theta(aId32); }
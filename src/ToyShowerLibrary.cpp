@@ -0,0 +1,153 @@
+#include "ToyShowerLibrary.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  // Version 2 bins the signed cosine, libraries of version 1 are rejected
+  constexpr char kLibraryMagic[8] = {'T','O','Y','S','H','L','B','2'};
+
+  std::size_t numberOfBins(const ToyCalorimeter::ToyShowerLibrary::Header& h) {
+    return static_cast<std::size_t>(h.nParticles)*h.nEnergy*h.nAngle;
+  }
+}
+
+namespace ToyCalorimeter {
+
+  bool ToyShowerLibrary::open(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+      ::close(fd);
+      return false;
+    }
+    const std::size_t fileSize = static_cast<std::size_t>(st.st_size);
+    void* base = ::mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) return false;
+    std::shared_ptr<const void> mapping(base, [fileSize](const void* p) { ::munmap(const_cast<void*>(p), fileSize); });
+
+    const auto* header = static_cast<const Header*>(base);
+    if (std::memcmp(header->magic, kLibraryMagic, sizeof(kLibraryMagic)) != 0 ||
+        header->nParticles == 0 || header->nParticles > kMaxParticles ||
+        header->nEnergy == 0 || header->nAngle == 0 || header->nPhi == 0 ||
+        header->eMin <= 0 || header->eMax <= header->eMin) {
+      return false;
+    }
+    const std::size_t nBins = numberOfBins(*header);
+    if (fileSize != sizeof(Header) + nBins*sizeof(Bin) + header->nShowers*sizeof(Shower) + header->nDeposits*sizeof(Deposit)) {
+      return false;
+    }
+    const char* data = static_cast<const char*>(base) + sizeof(Header);
+    m_bins     = reinterpret_cast<const Bin*>(data);
+    m_showers  = reinterpret_cast<const Shower*>(data + nBins*sizeof(Bin));
+    m_deposits = reinterpret_cast<const Deposit*>(data + nBins*sizeof(Bin) + header->nShowers*sizeof(Shower));
+    m_header   = header;
+    m_mapping  = std::move(mapping);
+    return true;
+  }
+
+  long ToyShowerLibrary::binIndex(const Header& h, int pdg, double energy, double cosAngle) {
+    long particle = -1;
+    for (uint32_t i=0; i<h.nParticles; i++) {
+      if (h.pdg[i] == pdg) particle = i;
+    }
+    if (particle < 0 || energy <= 0) return -1;
+    long e = static_cast<long>(std::floor(std::log(energy/h.eMin)/std::log(h.eMax/h.eMin)*h.nEnergy));
+    long a = static_cast<long>(std::floor(0.5*(cosAngle + 1)*h.nAngle));
+    e = std::clamp(e, 0L, static_cast<long>(h.nEnergy)-1);
+    a = std::clamp(a, 0L, static_cast<long>(h.nAngle)-1);
+    return (particle*h.nEnergy + e)*h.nAngle + a;
+  }
+
+  std::span<const ToyShowerLibrary::Deposit> ToyShowerLibrary::shower(long bin, double u) const {
+    if (!hasShowers(bin)) return {};
+    const Bin& b = m_bins[bin];
+    const uint64_t i = std::min(static_cast<uint64_t>(u*b.nShowers), b.nShowers-1);
+    const Shower& s = m_showers[b.firstShower + i];
+    return {m_deposits + s.firstDeposit, static_cast<std::size_t>(s.nDeposits)};
+  }
+
+  int ToyShowerLibrary::entryPhi(double x, double y, unsigned nPhi) {
+    const double dPhi = 2*M_PI/nPhi;
+    double phi = std::atan2(y, x);
+    if (phi < 0) phi += 2*M_PI;
+    return static_cast<int>(std::floor(phi/dPhi + 0.5)) % static_cast<int>(nPhi);
+  }
+
+  double ToyShowerLibrary::entryCosine(double dx, double dy, double dz, int phi, unsigned nPhi) {
+    const double norm = std::sqrt(dx*dx + dy*dy + dz*dz);
+    if (norm <= 0) return 1.;
+    const double axis = phi*2*M_PI/nPhi;
+    return (dx*std::cos(axis) + dy*std::sin(axis))/norm;
+  }
+
+  ToyShowerLibraryWriter::ToyShowerLibraryWriter(const std::vector<int>& pdg, unsigned nEnergy, double eMin, double eMax,
+                                                 unsigned nAngle, unsigned nPhi) {
+    if (pdg.empty() || pdg.size() > ToyShowerLibrary::kMaxParticles || nEnergy == 0 || nAngle == 0 || nPhi == 0 ||
+        eMin <= 0 || eMax <= eMin) {
+      throw std::runtime_error("ToyShowerLibraryWriter: invalid library binning");
+    }
+    std::memset(&m_header, 0, sizeof(m_header));
+    std::memcpy(m_header.magic, kLibraryMagic, sizeof(kLibraryMagic));
+    std::copy(pdg.begin(), pdg.end(), m_header.pdg);
+    m_header.nParticles = static_cast<uint32_t>(pdg.size());
+    m_header.nEnergy    = nEnergy;
+    m_header.nAngle     = nAngle;
+    m_header.nPhi       = nPhi;
+    m_header.eMin       = eMin;
+    m_header.eMax       = eMax;
+    m_bins.resize(numberOfBins(m_header));
+  }
+
+  bool ToyShowerLibraryWriter::add(int pdg, double energy, double cosAngle, std::vector<ToyShowerLibrary::Deposit> deposits) {
+    if (energy < m_header.eMin || energy > m_header.eMax) return false;
+    const long bin = ToyShowerLibrary::binIndex(m_header, pdg, energy, cosAngle);
+    if (bin < 0) return false;
+    m_bins[bin].push_back({energy, std::move(deposits)});
+    ++m_nShowers;
+    return true;
+  }
+
+  void ToyShowerLibraryWriter::write(const std::string& path) const {
+    ToyShowerLibrary::Header header = m_header;
+    std::vector<ToyShowerLibrary::Bin>    bins(m_bins.size());
+    std::vector<ToyShowerLibrary::Shower> showers;
+    header.nDeposits = 0;
+    for (std::size_t b=0; b<m_bins.size(); b++) {
+      bins[b].firstShower = showers.size();
+      bins[b].nShowers    = m_bins[b].size();
+      for (const auto& entry : m_bins[b]) {
+        showers.push_back({header.nDeposits, entry.deposits.size(), entry.energy});
+        header.nDeposits += entry.deposits.size();
+      }
+    }
+    header.nShowers = showers.size();
+
+    // Write next to the target and rename, so concurrent jobs never map a half written file
+    const std::string tmpPath = path + ".tmp" + std::to_string(::getpid());
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(bins.data()), bins.size()*sizeof(ToyShowerLibrary::Bin));
+    out.write(reinterpret_cast<const char*>(showers.data()), showers.size()*sizeof(ToyShowerLibrary::Shower));
+    for (const auto& bin : m_bins) {
+      for (const auto& entry : bin) {
+        out.write(reinterpret_cast<const char*>(entry.deposits.data()), entry.deposits.size()*sizeof(ToyShowerLibrary::Deposit));
+      }
+    }
+    out.close();
+    if (!out || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+      std::remove(tmpPath.c_str());
+      throw std::runtime_error("ToyShowerLibraryWriter: failed to write shower library " + path);
+    }
+  }
+
+}
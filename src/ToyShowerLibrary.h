@@ -0,0 +1,101 @@
+#ifndef ToyShowerLibrary_h
+#define ToyShowerLibrary_h 1
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ToyCalorimeter {
+
+  // Frozen shower library: per-cell energy deposits of full simulation showers, binned by particle type,
+  // kinetic energy (log bins) and the cosine of the angle between the track and the axis of the entry crystal
+  // (equal bins over [-1,1], so tracks leaving the ring inwards do not share bins with those entering it).
+  // Cells are stored with their phi index relative to the entry crystal, so a shower can be replayed in any
+  // crystal of the ring with ToySegmentation::rotatePhi(). Energies are in GeV.
+  //
+  // The file is memory-mapped read-only, so all processes on a node share the same pages.
+  // Finding the bin of a track and picking a shower in it are both O(1).
+  class ToyShowerLibrary {
+    public:
+      static constexpr std::size_t kMaxParticles = 8;
+
+      struct Header {
+        char     magic[8];
+        int32_t  pdg[kMaxParticles];
+        uint32_t nParticles;
+        uint32_t nEnergy;
+        uint32_t nAngle;
+        uint32_t nPhi;
+        double   eMin;
+        double   eMax;
+        uint64_t nShowers;
+        uint64_t nDeposits;
+      };
+      struct Bin {
+        uint64_t firstShower;
+        uint64_t nShowers;
+      };
+      struct Shower {
+        uint64_t firstDeposit;
+        uint64_t nDeposits;
+        double   energy;        // kinetic energy of the recorded primary
+      };
+      struct Deposit {
+        uint64_t cellID;        // phi field relative to the entry crystal
+        double   fraction;      // fraction of the primary kinetic energy
+      };
+
+      // Open a library file, false if it is missing or not a library
+      bool open(const std::string& path);
+      bool isOpen() const { return m_header != nullptr; }
+      const Header& header() const { return *m_header; }
+
+      // Bin of a track, -1 if its particle type is not in the library
+      long binIndex(int pdg, double energy, double cosAngle) const { return binIndex(*m_header, pdg, energy, cosAngle); }
+      static long binIndex(const Header& header, int pdg, double energy, double cosAngle);
+
+      bool hasShowers(long bin) const { return bin >= 0 && m_bins[bin].nShowers > 0; }
+
+      // Shower number floor(u*n) of a bin, u in [0,1); empty if the bin has no showers
+      std::span<const Deposit> shower(long bin, double u) const;
+
+      // Phi index of the crystal at global (x, y) for a ring of nPhi crystals with crystal 0 at phi = 0
+      static int entryPhi(double x, double y, unsigned nPhi);
+      // Cosine between a direction and the radial axis of crystal phi
+      static double entryCosine(double dx, double dy, double dz, int phi, unsigned nPhi);
+
+    private:
+      std::shared_ptr<const void> m_mapping;
+      const Header*  m_header   {nullptr};
+      const Bin*     m_bins     {nullptr};
+      const Shower*  m_showers  {nullptr};
+      const Deposit* m_deposits {nullptr};
+  };
+
+  // Collects showers and writes them as a library file
+  class ToyShowerLibraryWriter {
+    public:
+      ToyShowerLibraryWriter(const std::vector<int>& pdg, unsigned nEnergy, double eMin, double eMax, unsigned nAngle, unsigned nPhi);
+
+      // Deposits must already be relative in phi. False if the shower is outside the binning.
+      bool add(int pdg, double energy, double cosAngle, std::vector<ToyShowerLibrary::Deposit> deposits);
+
+      std::size_t numberOfShowers() const { return m_nShowers; }
+
+      // Written next to the target and renamed, throws std::runtime_error on failure
+      void write(const std::string& path) const;
+
+    private:
+      struct Entry {
+        double energy;
+        std::vector<ToyShowerLibrary::Deposit> deposits;
+      };
+      ToyShowerLibrary::Header        m_header;
+      std::vector<std::vector<Entry>> m_bins;
+      std::size_t                     m_nShowers {0};
+  };
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include "ToySegmentation.h"
+#include "ToyShowerLibrary.h"
+#include "DD4hep/Detector.h"
+#include "DDG4/Geant4FastSimShowerModel.inl"
+#include "DDG4/Factories.h"
+#include "G4FastSimHitMaker.hh"
+#include "G4FastHit.hh"
+#include "G4FastTrack.hh"
+#include "G4FastStep.hh"
+#include "Randomize.hh"
+#include "CLHEP/Units/SystemOfUnits.h"
+
+// Replays showers from a frozen shower library (see ToyShowerLibrary.h and tools/ToyShowerLibraryBuilder)
+// instead of tracking them. A recorded shower is rotated around the ring to the crystal the particle enters.
+namespace ToyCalorimeter {
+  class ToyShowerLibraryParams {
+    public:
+      G4FastSimHitMaker hitMaker { };
+
+      std::string       libraryPath;
+      std::string       detectorName { "MyToyCalorimeter" };
+      ToyShowerLibrary  library;
+      const dd4hep::DDSegmentation::ToySegmentation* segmentation {nullptr};
+
+      // Library bin and entry crystal of a track entering the calorimeter envelope
+      long bin(const G4Track* primary, int& phi) const {
+        const G4ThreeVector& pos = primary->GetPosition();
+        const G4ThreeVector& dir = primary->GetMomentumDirection();
+        const unsigned nPhi = library.header().nPhi;
+        phi = ToyShowerLibrary::entryPhi(pos.x(), pos.y(), nPhi);
+        double cosAngle = ToyShowerLibrary::entryCosine(dir.x(), dir.y(), dir.z(), phi, nPhi);
+        return library.binIndex(primary->GetDefinition()->GetPDGEncoding(), primary->GetKineticEnergy()/CLHEP::GeV, cosAngle);
+      }
+  };
+}
+
+namespace dd4hep {
+  namespace sim {
+
+    using namespace ToyCalorimeter;
+
+    template <> void Geant4FSShowerModel<ToyShowerLibraryParams>::initialize()    {
+      declareProperty("Library",  locals.libraryPath);
+      declareProperty("Detector", locals.detectorName);
+    }
+
+    template <> void Geant4FSShowerModel<ToyShowerLibraryParams>::constructSensitives(Geant4DetectorConstructionContext* ctxt)   {
+      this->Geant4FastSimShowerModel::constructSensitives(ctxt);
+      if ( !locals.library.open(locals.libraryPath) ) {
+        except("+++ Cannot open shower library %s", locals.libraryPath.c_str());
+      }
+      dd4hep::Segmentation seg =context()->detectorDescription().sensitiveDetector(locals.detectorName).readout().segmentation();
+      locals.segmentation =dynamic_cast<const dd4hep::DDSegmentation::ToySegmentation*>(seg.segmentation());
+      if ( !locals.segmentation || !locals.segmentation->isFrozen() ) {
+        except("+++ The readout of %s does not use a ToySegmentation", locals.detectorName.c_str());
+      }
+      if ( locals.segmentation->numberOfPhiCells() != long(locals.library.header().nPhi) ) {
+        except("+++ Shower library %s was built for %u crystals in phi, the geometry has %ld",
+               locals.libraryPath.c_str(), locals.library.header().nPhi, locals.segmentation->numberOfPhiCells());
+      }
+      info("+++ Replaying showers from %s (%lu showers)", locals.libraryPath.c_str(), (unsigned long)locals.library.header().nShowers);
+    }
+
+    template <> bool Geant4FSShowerModel<ToyShowerLibraryParams>::check_trigger(const G4FastTrack& track)   {
+      if ( !this->Geant4FastSimShowerModel::check_trigger(track) ) return false;
+      // Tracks without recorded showers in their bin are simulated normally
+      int phi =0;
+      return locals.library.hasShowers(locals.bin(track.GetPrimaryTrack(), phi));
+    }
+
+    template <> void Geant4FSShowerModel<ToyShowerLibraryParams>::modelShower(const G4FastTrack& track, G4FastStep& step)   {
+      const G4Track* primary =track.GetPrimaryTrack();
+      double energy =primary->GetKineticEnergy();
+      int    phi    =0;
+      long   bin    =locals.bin(primary, phi);
+
+      for (const auto& deposit : locals.library.shower(bin, G4UniformRand())) {
+        auto cellID =locals.segmentation->rotatePhi(deposit.cellID, phi);
+        auto pos    =locals.segmentation->position(cellID);    // mm
+        locals.hitMaker.make(G4FastHit(G4ThreeVector(pos.x(), pos.y(), pos.z())*CLHEP::mm, deposit.fraction*energy), track);
+      }
+      this->killShower(step, energy);
+    }
+  }
+}
+
+namespace dd4hep { namespace sim {
+    typedef Geant4FSShowerModel<ToyShowerLibraryParams> ToyShowerLibraryModel;
+}}
+
+// Declare the shower model and set the name to be used in the steering file
+DECLARE_GEANT4ACTION(ToyShowerLibraryModel)
@@ -0,0 +1,128 @@
+// Multithreaded analysis of the ToyCalorimeter output.
+//
+// Every thread opens its own podio reader and runs a ToyAnalysis over a contiguous range of events; the
+// histograms of all threads are added at the end and written as TH1Ds. phiSectorProfile is the mean energy
+// per phi sector and event. The event rate is printed, to compare with the PyROOT loops of eventdisplay.py.
+//
+// Compact hits (edm4toy::CompactToyCalorimeterHit) are positioned from the cell table in the input metadata.
+//
+//   ToyCaloAnalysis -o histograms.root [options] toy_calorimeter_output.root ...
+//
+//   --collection NAME    calorimeter hit collection                  (ToyCalorimeterHits)
+//   --particles NAME     MC particle collection                      (MCParticles)
+//   --phi-sectors N      sectors of the phi profile                  (64)
+//   --max-energy E       upper edge of the energy histograms in GeV  (100)
+//   --threads N          worker threads                              (hardware concurrency)
+#include "ToyAnalysis.h"
+#include "ToyToolSupport.h"
+#include <podio/Frame.h>
+#include <podio/ROOTReader.h>
+#include <TFile.h>
+#include <TH1D.h>
+#include <TROOT.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ToyCalorimeter;
+
+namespace {
+
+  void write(const ToyHistogram& histogram, const std::string& name, double scale = 1.) {
+    TH1D h(name.c_str(), histogram.title.c_str(), histogram.nBins, histogram.low, histogram.high);
+    for (int b=0; b<histogram.nBins+2; b++) {
+      h.SetBinContent(b, histogram.sumW[b]*scale);
+      h.SetBinError(b, std::sqrt(histogram.sumW2[b])*scale);
+    }
+    h.SetEntries(histogram.entries);
+    h.Write();
+  }
+}
+
+int main(int argc, char** argv) {
+  ToyAnalysisOptions options;
+  std::string output;
+  std::vector<std::string> inputs;
+  unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  ToyCommandLine cmd(argc, argv,
+    "ToyCaloAnalysis -o histograms.root [--collection NAME] [--particles NAME] [--phi-sectors N]\n"
+    "         [--max-energy E] [--threads N] input.root ...");
+  while (cmd.next()) {
+    const std::string& arg = cmd.arg();
+    if      (arg == "-o")             output             = cmd.value();
+    else if (arg == "--collection")   options.collection = cmd.value();
+    else if (arg == "--particles")    options.particles  = cmd.value();
+    else if (arg == "--phi-sectors")  options.phiSectors = std::max(1, std::stoi(cmd.value()));
+    else if (arg == "--max-energy")   options.maxEnergy  = std::stod(cmd.value());
+    else if (arg == "--threads")      nThreads           = std::max(1, std::stoi(cmd.value()));
+    else if (cmd.isOption())          return cmd.usage();
+    else                              inputs.push_back(arg);
+  }
+  if (output.empty() || inputs.empty()) return cmd.usage();
+
+  ROOT::EnableThreadSafety();
+  unsigned nEvents = 0;
+  {
+    podio::ROOTReader reader;
+    reader.openFiles(inputs);
+    nEvents = reader.getEntries("events");
+    // Compact hits are positioned from the cell table in the metadata
+    if (reader.getEntries("metadata") > 0) {
+      options.positions = std::make_shared<const ToyCellPositionTable>(podio::Frame(reader.readEntry("metadata", 0)), options.collection);
+    }
+  }
+  nThreads = std::max(1u, std::min(nThreads, nEvents));
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<ToyAnalysis> analyses(nThreads, ToyAnalysis(options));
+  std::vector<std::exception_ptr> errors(nThreads);
+  std::vector<std::thread> workers;
+  for (unsigned t=0; t<nThreads; t++) {
+    workers.emplace_back([&, t]() {
+      try {
+        podio::ROOTReader reader;
+        reader.openFiles(inputs);
+        const unsigned first = uint64_t(nEvents)*t/nThreads;
+        const unsigned last  = uint64_t(nEvents)*(t+1)/nThreads;
+        for (unsigned i=first; i<last; i++) {
+          analyses[t].process(podio::Frame(reader.readEntry("events", i)));
+        }
+      }
+      catch (...) {
+        errors[t] = std::current_exception();
+      }
+    });
+  }
+  for (auto& worker : workers) worker.join();
+  for (auto& error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+  for (unsigned t=1; t<nThreads; t++) analyses[0].merge(analyses[t]);
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const ToyAnalysis& result = analyses[0];
+  TFile file(output.c_str(), "RECREATE");
+  if (file.IsZombie()) {
+    std::cerr << "cannot create " << output << std::endl;
+    return 1;
+  }
+  for (const auto& histogram : result.histograms()) write(histogram, histogram.name);
+  for (const auto& histogram : result.histograms()) {
+    if (histogram.name == "phiSectorEnergy" && result.events() > 0) {
+      write(histogram, "phiSectorProfile", 1./result.events());
+    }
+  }
+  file.Close();
+
+  std::cout << "Analysed " << result.events() << " events with " << nThreads << " threads in " << seconds
+            << " s (" << (seconds > 0 ? result.events()/seconds : 0.) << " events/s), histograms in " << output << std::endl;
+  return 0;
+}
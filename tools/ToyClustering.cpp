@@ -0,0 +1,284 @@
+// Topological clustering of ToyCalorimeter hits.
+//
+// Reads digitized hits (edm4hep::CalorimeterHit, see ToyDigitizer) or simulated hits (edm4hep::SimCalorimeterHit,
+// edm4toy::SimToyCalorimeterHit or edm4toy::CompactToyCalorimeterHit), clusters them with ToyTopoClustering over the neighbour table of the
+// ToySegmentation and adds edm4hep::Clusters to the events. Clusters of simulated hits point to
+// CalorimeterHit copies of them, written as <output-collection>Hits. Events are clustered in parallel and
+// written in input order.
+//
+//   ToyClustering --compact ToyCalorimeter.xml -o clusters.root [options] input.root ...
+//
+// With --benchmark N no files are read or written: N synthetic events of --benchmark-hits hits in showers
+// of about 200 cells are clustered on all threads and the rate is printed.
+//
+//   --detector NAME          sub-detector of the hit collection       (MyToyCalorimeter)
+//   --collection NAME        hit collection                           (ToyCalorimeterDigiHits)
+//   --output-collection NAME cluster collection                       (ToyCalorimeterClusters)
+//   --seed-threshold E       GeV                                      (0.1)
+//   --grow-threshold E       GeV                                      (0.02)
+//   --cell-threshold E       GeV                                      (0.005)
+//   --threads N              worker threads                           (hardware concurrency)
+//   --benchmark N            synthetic events instead of input files
+//   --benchmark-hits N       hits per synthetic event                 (50000)
+#include "ToyCellPositionTable.h"
+#include "ToySegmentation.h"
+#include "ToyThreadPool.h"
+#include "ToyToolSupport.h"
+#include "ToyTopoClustering.h"
+#include <DD4hep/Detector.h>
+#include <edm4hep/CalorimeterHitCollection.h>
+#include <edm4hep/ClusterCollection.h>
+#include <podio/Frame.h>
+#include <podio/ROOTReader.h>
+#include <podio/ROOTWriter.h>
+#include <TROOT.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using dd4hep::DDSegmentation::ToySegmentation;
+using namespace ToyCalorimeter;
+
+namespace {
+
+  struct Settings {
+    std::string          collection       {"ToyCalorimeterDigiHits"};
+    std::string          outputCollection {"ToyCalorimeterClusters"};
+    ToyClusteringOptions options;
+    ToyCellPositionTable positions;      // compact hits only
+  };
+
+  // Clustering state of the calling thread
+  ToyTopoClustering& clustering(const ToySegmentation& segmentation, const ToyClusteringOptions& options) {
+    thread_local std::unique_ptr<ToyTopoClustering> instance;
+    if (!instance) instance = std::make_unique<ToyTopoClustering>(segmentation, options);
+    return *instance;
+  }
+
+  // Hit columns of an event
+  struct HitColumns {
+    std::vector<long>  cellIndex;
+    std::vector<float> energy;
+    std::vector<int>   cluster;
+
+    template <typename COLL> void fill(const COLL& hits, const ToySegmentation& segmentation) {
+      cellIndex.resize(hits.size());
+      energy.resize(hits.size());
+      cluster.resize(hits.size());
+      for (std::size_t i=0; i<hits.size(); i++) {
+        cellIndex[i] = segmentation.cellIndex(hits[i].getCellID());
+        energy[i]    = hits[i].getEnergy();
+      }
+    }
+  };
+
+  // CalorimeterHits for clusters of simulated hits, time from the earliest contribution
+  template <typename COLL> edm4hep::CalorimeterHitCollection recoHits(const COLL& simHits, const ToyCellPositionTable& positions) {
+    edm4hep::CalorimeterHitCollection hits;
+    for (const auto& sim : simHits) {
+      float time = 0;
+      const auto contributions = sim.getContributions();
+      if (!contributions.empty()) {
+        time = contributions[0].getTime();
+        for (const auto& c : contributions) time = std::min(time, c.getTime());
+      }
+      auto hit = hits.create();
+      hit.setCellID(sim.getCellID());
+      hit.setEnergy(sim.getEnergy());
+      hit.setTime(time);
+      hit.setPosition(hitPosition(sim, positions));
+    }
+    return hits;
+  }
+
+  edm4hep::ClusterCollection makeClusters(const edm4hep::CalorimeterHitCollection& hits, const std::vector<int>& cluster, int nClusters) {
+    edm4hep::ClusterCollection clusters;
+    std::vector<edm4hep::MutableCluster> out;
+    std::vector<double> x(nClusters, 0.), y(nClusters, 0.), z(nClusters, 0.), e(nClusters, 0.);
+    for (int c=0; c<nClusters; c++) out.push_back(clusters.create());
+    for (std::size_t i=0; i<hits.size(); i++) {
+      const int c = cluster[i];
+      if (c < 0) continue;
+      const auto hit = hits[i];
+      const auto& pos = hit.getPosition();
+      const double w = hit.getEnergy();
+      e[c] += w;
+      x[c] += w*pos.x;
+      y[c] += w*pos.y;
+      z[c] += w*pos.z;
+      out[c].addToHits(hit);
+      out[c].addToHitContributions(w);
+    }
+    for (int c=0; c<nClusters; c++) {
+      const double w = e[c] > 0 ? 1./e[c] : 0.;
+      const edm4hep::Vector3f position(x[c]*w, y[c]*w, z[c]*w);
+      out[c].setEnergy(e[c]);
+      out[c].setPosition(position);
+      out[c].setPhi(std::atan2(position.y, position.x));
+      out[c].setITheta(std::atan2(std::hypot(position.x, position.y), position.z));
+    }
+    return clusters;
+  }
+
+  podio::Frame cluster(podio::Frame&& event, const Settings& settings, const ToySegmentation& segmentation) {
+    auto& topo = clustering(segmentation, settings.options);
+    HitColumns columns;
+    const podio::CollectionBase* input = event.get(settings.collection);
+    const edm4hep::CalorimeterHitCollection* hits = dynamic_cast<const edm4hep::CalorimeterHitCollection*>(input);
+    if (!hits && input) {
+      // Simulated hits: clusters point to CalorimeterHit copies written next to them
+      edm4hep::CalorimeterHitCollection copies;
+      const bool known = visitSimCalorimeterHits(input, [&](const auto& sim) { copies = recoHits(sim, settings.positions); });
+      if (!known) throw std::runtime_error(settings.collection + " is a " + std::string(input->getTypeName()) + ", not a calorimeter hit collection");
+      hits = &event.put(std::move(copies), settings.outputCollection + "Hits");
+    }
+    if (!hits) {
+      event.put(edm4hep::ClusterCollection(), settings.outputCollection);
+      return std::move(event);
+    }
+    columns.fill(*hits, segmentation);
+    const int nClusters = topo.run(columns.cellIndex, columns.energy, columns.cluster);
+    event.put(makeClusters(*hits, columns.cluster, nClusters), settings.outputCollection);
+    return std::move(event);
+  }
+
+  // Showers of about 200 cells grown breadth first from random cells, energies falling with the distance
+  void syntheticEvent(const ToySegmentation& segmentation, std::size_t nHits, std::mt19937_64& engine,
+                      std::vector<long>& cellIndex, std::vector<float>& energy, std::vector<char>& used) {
+    cellIndex.clear();
+    energy.clear();
+    std::uniform_int_distribution<long> anyCell(0, segmentation.numberOfCells()-1);
+    std::uniform_real_distribution<float> flat(0.5f, 1.5f);
+    std::vector<std::pair<long, int>> queue;
+    while (cellIndex.size() < nHits) {
+      queue.assign(1, {anyCell(engine), 0});
+      const std::size_t showerEnd = std::min(nHits, cellIndex.size() + 200);
+      for (std::size_t q=0; q<queue.size() && cellIndex.size() < showerEnd; q++) {
+        const auto [cell, step] = queue[q];
+        if (used[cell]) continue;
+        used[cell] = 1;
+        cellIndex.push_back(cell);
+        energy.push_back(2.f*std::exp(-1.5f*step)*flat(engine));
+        for (const uint32_t n : segmentation.neighbours(cell)) {
+          if (!used[n]) queue.emplace_back(n, step+1);
+        }
+      }
+      if (cellIndex.size() >= segmentation.numberOfCells()) break;
+    }
+    for (const long cell : cellIndex) used[cell] = 0;
+  }
+
+  void benchmark(const ToySegmentation& segmentation, const ToyClusteringOptions& options,
+                 unsigned nEvents, std::size_t nHits, unsigned nThreads) {
+    std::atomic<unsigned> next {0};
+    std::atomic<long> totalHits {0}, totalClusters {0};
+    std::vector<double> clusteringSeconds(nThreads, 0.);
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t=0; t<nThreads; t++) {
+      workers.emplace_back([&, t]() {
+        auto& topo = clustering(segmentation, options);
+        std::vector<long> cellIndex;
+        std::vector<float> energy;
+        std::vector<int> cluster;
+        std::vector<char> used(segmentation.numberOfCells(), 0);
+        double& seconds = clusteringSeconds[t];
+        for (unsigned ev; (ev = next++) < nEvents; ) {
+          std::mt19937_64 engine(ev);
+          syntheticEvent(segmentation, nHits, engine, cellIndex, energy, used);
+          cluster.resize(cellIndex.size());
+          const auto begin = std::chrono::steady_clock::now();
+          totalClusters += topo.run(cellIndex, energy, cluster);
+          seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+          totalHits += cellIndex.size();
+        }
+      });
+    }
+    for (auto& worker : workers) worker.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Clustered " << nEvents << " synthetic events of " << nHits << " hits with " << nThreads << " threads: "
+              << double(totalClusters)/std::max(1u, nEvents) << " clusters per event, "
+              << totalHits/seconds << " hits/s including event generation, clustering "
+              << *std::min_element(clusteringSeconds.begin(), clusteringSeconds.end()) << " to "
+              << *std::max_element(clusteringSeconds.begin(), clusteringSeconds.end()) << " s per thread" << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  Settings settings;
+  std::string compact, output, detector = "MyToyCalorimeter";
+  std::vector<std::string> inputs;
+  unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+  unsigned benchmarkEvents = 0;
+  std::size_t benchmarkHits = 50000;
+
+  ToyCommandLine cmd(argc, argv,
+    "ToyClustering --compact FILE -o output [--detector NAME] [--collection NAME] [--output-collection NAME]\n"
+    "         [--seed-threshold E] [--grow-threshold E] [--cell-threshold E] [--threads N] input.root ...\n"
+    "       ToyClustering --compact FILE --benchmark N [--benchmark-hits N] [--threads N]");
+  while (cmd.next()) {
+    const std::string& arg = cmd.arg();
+    if      (arg == "--compact")           compact                        = cmd.value();
+    else if (arg == "-o")                  output                         = cmd.value();
+    else if (arg == "--detector")          detector                       = cmd.value();
+    else if (arg == "--collection")        settings.collection            = cmd.value();
+    else if (arg == "--output-collection") settings.outputCollection      = cmd.value();
+    else if (arg == "--seed-threshold")    settings.options.seedThreshold = std::stod(cmd.value());
+    else if (arg == "--grow-threshold")    settings.options.growThreshold = std::stod(cmd.value());
+    else if (arg == "--cell-threshold")    settings.options.cellThreshold = std::stod(cmd.value());
+    else if (arg == "--threads")           nThreads                       = std::max(1, std::stoi(cmd.value()));
+    else if (arg == "--benchmark")         benchmarkEvents                = std::stoul(cmd.value());
+    else if (arg == "--benchmark-hits")    benchmarkHits                  = std::stoul(cmd.value());
+    else if (cmd.isOption())               return cmd.usage();
+    else                                   inputs.push_back(arg);
+  }
+  if (compact.empty() || (benchmarkEvents == 0 && (output.empty() || inputs.empty()))) return cmd.usage();
+
+  dd4hep::Detector& description = dd4hep::Detector::getInstance();
+  description.fromCompact(compact);
+  auto* segmentation = dynamic_cast<ToySegmentation*>(
+    description.sensitiveDetector(detector).readout().segmentation().segmentation());
+  if (!segmentation || !segmentation->isFrozen()) {
+    std::cerr << "the readout of " << detector << " has no frozen ToySegmentation" << std::endl;
+    return 1;
+  }
+  segmentation->buildNeighbourTable();
+
+  if (benchmarkEvents > 0) {
+    benchmark(*segmentation, settings.options, benchmarkEvents, benchmarkHits, nThreads);
+    return 0;
+  }
+
+  ROOT::EnableThreadSafety();
+  podio::ROOTReader reader;
+  reader.openFiles(inputs);
+  podio::ROOTWriter writer(output);
+  if (reader.getEntries("metadata") > 0) {
+    settings.positions = ToyCellPositionTable(podio::Frame(reader.readEntry("metadata", 0)), settings.collection);
+  }
+
+  ToyThreadPool pool(nThreads);
+  const unsigned nEvents = reader.getEntries("events");
+  processInOrder(pool, nEvents,
+    [&]() { return podio::Frame(reader.readNextEntry("events")); },
+    [&](podio::Frame&& event) { return cluster(std::move(event), settings, *segmentation); },
+    [&](podio::Frame&& clustered) { writer.writeFrame(clustered, "events"); });
+
+  for (unsigned i=0; i<reader.getEntries("runs"); i++) {
+    writer.writeFrame(podio::Frame(reader.readNextEntry("runs")), "runs");
+  }
+  if (reader.getEntries("metadata") > 0) {
+    writer.writeFrame(podio::Frame(reader.readEntry("metadata", 0)), "metadata");
+  }
+  writer.finish();
+  std::cout << "Clustered " << nEvents << " events into " << output << " with " << nThreads << " threads" << std::endl;
+  return 0;
+}
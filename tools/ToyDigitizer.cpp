@@ -0,0 +1,233 @@
+// Digitization of the ToyCalorimeter simulation output.
+//
+// Reads the simulated calorimeter hits of every event (edm4hep::SimCalorimeterHit, edm4toy::SimToyCalorimeterHit
+// or edm4toy::CompactToyCalorimeterHit, positioned from the cell table in the metadata), applies per-cell noise, gain (ADC conversion with saturation), threshold and
+// time smearing, and writes edm4hep::CalorimeterHits. Hits without energy, as the
+// simulation writes for cells that only saw steps below its 0.1 MeV cut, fail every threshold.
+// The metadata of the input is copied, with <output-collection>__CellIDEncoding added.
+//
+// Limitations:
+//  - noise is added to the cells that have a simulated hit only; cells without one never produce a noise hit
+//  - the hit time is the earliest MC contribution of the cell. Without contributions it is 0 plus the smearing,
+//    which is the case for the default SaveContributions=False of the simulation output
+//
+// Events are digitized in parallel on a thread pool and written in input order. Every event draws its random
+// numbers from a generator seeded with (seed, run number, event number), so the output does not depend on
+// the number of threads.
+//
+// The per-cell constants are dense arrays indexed by ToySegmentation::cellIndex(), so the geometry is loaded
+// to know the cell layout. Defaults apply to all cells; a constants file overrides single cells with lines
+//   cellIndex threshold[GeV] noise[GeV] gain[ADC/GeV] timeResolution[ns]
+//
+//   ToyDigitizer --compact ToyCalorimeter.xml -o digi.root [options] toy_calorimeter_output.root ...
+//
+//   --detector NAME       sub-detector of the hit collection              (MyToyCalorimeter)
+//   --collection NAME     simulated hit collection                        (ToyCalorimeterHits)
+//   --output-collection   digitized hit collection                        (ToyCalorimeterDigiHits)
+//   --threshold E         energy threshold in GeV                         (0.001)
+//   --noise E             noise per cell in GeV                           (0.0005)
+//   --gain G              ADC counts per GeV                              (1000)
+//   --adc-max N           ADC saturation                                  (65535)
+//   --time-resolution T   time smearing in ns                             (0.1)
+//   --constants FILE      per-cell constants
+//   --seed N              base random seed                                (42)
+//   --threads N           worker threads                                  (hardware concurrency)
+#include "ToyCellPositionTable.h"
+#include "ToySegmentation.h"
+#include "ToyThreadPool.h"
+#include "ToyToolSupport.h"
+#include <DD4hep/Detector.h>
+#include <edm4hep/CalorimeterHitCollection.h>
+#include <edm4hep/EventHeaderCollection.h>
+#include <podio/Frame.h>
+#include <podio/ROOTReader.h>
+#include <podio/ROOTWriter.h>
+#include <TROOT.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using dd4hep::DDSegmentation::ToySegmentation;
+using ToyCalorimeter::ToyCellPositionTable;
+using ToyCalorimeter::ToyThreadPool;
+using ToyCalorimeter::processInOrder;
+
+namespace {
+
+  // Per-cell constants, structure-of-arrays indexed by ToySegmentation::cellIndex()
+  struct DigiConstants {
+    std::vector<float> threshold, noise, gain, timeResolution;
+    double adcMax {65535};
+
+    DigiConstants(std::size_t nCells, float threshold0, float noise0, float gain0, float time0)
+      : threshold(nCells, threshold0), noise(nCells, noise0), gain(nCells, gain0), timeResolution(nCells, time0) {}
+
+    // Lines "cellIndex threshold noise gain timeResolution", '#' starts a comment
+    void read(const std::string& path) {
+      std::ifstream in(path);
+      if (!in) throw std::runtime_error("cannot open constants file " + path);
+      for (std::string line; std::getline(in, line); ) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        long index;
+        float t, n, g, r;
+        if (!(fields >> index >> t >> n >> g >> r)) continue;
+        if (index < 0 || std::size_t(index) >= threshold.size()) {
+          throw std::runtime_error("cell index " + std::to_string(index) + " in " + path + " is outside the segmentation");
+        }
+        threshold[index] = t;
+        noise[index] = n;
+        gain[index] = g;
+        timeResolution[index] = r;
+      }
+    }
+  };
+
+  // splitmix64 finalizer: well mixed seeds from consecutive run and event numbers
+  uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27))*0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  struct Settings {
+    std::string collection       {"ToyCalorimeterHits"};
+    std::string outputCollection {"ToyCalorimeterDigiHits"};
+    uint64_t    seed             {42};
+    ToyCellPositionTable positions;      // compact hits only
+  };
+
+  // Hits of one event, the same for all three simulated hit types
+  template <typename COLL>
+  void digitizeHits(const COLL& simHits, const ToySegmentation& segmentation, const DigiConstants& constants,
+                    const ToyCellPositionTable& positions, std::mt19937_64& engine, edm4hep::CalorimeterHitCollection& digiHits) {
+    std::normal_distribution<double> gauss(0., 1.);
+    for (const auto& sim : simHits) {
+      const long index = segmentation.cellIndex(sim.getCellID());
+      if (index < 0) continue;
+      // Noise is drawn for every hit, so the random sequence does not depend on the thresholds
+      const double noisy  = sim.getEnergy() + constants.noise[index]*gauss(engine);
+      const double smear  = constants.timeResolution[index]*gauss(engine);
+      const double counts = std::clamp(std::round(noisy*constants.gain[index]), 0., constants.adcMax);
+      const double energy = counts/constants.gain[index];
+      if (energy < constants.threshold[index]) continue;
+
+      double time = 0;
+      if (!sim.getContributions().empty()) {
+        time = sim.getContributions()[0].getTime();
+        for (const auto& c : sim.getContributions()) time = std::min(time, double(c.getTime()));
+      }
+      auto digi = digiHits.create();
+      digi.setCellID(sim.getCellID());
+      digi.setEnergy(energy);
+      digi.setEnergyError(constants.noise[index]);
+      digi.setTime(time + smear);
+      digi.setPosition(ToyCalorimeter::hitPosition(sim, positions));
+    }
+  }
+
+  podio::Frame digitize(podio::Frame&& event, const Settings& settings, const ToySegmentation& segmentation,
+                        const DigiConstants& constants) {
+    const auto& headers = event.get<edm4hep::EventHeaderCollection>("EventHeader");
+    const uint64_t run  = headers.empty() ? 0 : headers[0].getRunNumber();
+    const uint64_t evt  = headers.empty() ? 0 : headers[0].getEventNumber();
+    std::mt19937_64 engine(mix(settings.seed ^ mix(run ^ mix(evt))));
+
+    edm4hep::CalorimeterHitCollection digiHits;
+    const podio::CollectionBase* simHits = event.get(settings.collection);
+    const bool known = ToyCalorimeter::visitSimCalorimeterHits(simHits, [&](const auto& hits) {
+      digitizeHits(hits, segmentation, constants, settings.positions, engine, digiHits);
+    });
+    if (!known && simHits) {
+      throw std::runtime_error(settings.collection + " is a " + std::string(simHits->getTypeName()) + ", not a simulated calorimeter hit collection");
+    }
+
+    podio::Frame output;
+    output.put(headers.clone(), "EventHeader");
+    output.put(std::move(digiHits), settings.outputCollection);
+    return output;
+  }
+}
+
+int main(int argc, char** argv) {
+  Settings settings;
+  std::string compact, output, detector = "MyToyCalorimeter", constantsFile;
+  std::vector<std::string> inputs;
+  float threshold = 0.001, noise = 0.0005, gain = 1000, timeResolution = 0.1;
+  double adcMax = 65535;
+  unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  ToyCalorimeter::ToyCommandLine cmd(argc, argv,
+    "ToyDigitizer --compact FILE -o output [--detector NAME] [--collection NAME] [--output-collection NAME]\n"
+    "         [--threshold E] [--noise E] [--gain G] [--adc-max N] [--time-resolution T] [--constants FILE]\n"
+    "         [--seed N] [--threads N] input.root ...");
+  while (cmd.next()) {
+    const std::string& arg = cmd.arg();
+    if      (arg == "--compact")           compact                   = cmd.value();
+    else if (arg == "-o")                  output                    = cmd.value();
+    else if (arg == "--detector")          detector                  = cmd.value();
+    else if (arg == "--collection")        settings.collection       = cmd.value();
+    else if (arg == "--output-collection") settings.outputCollection = cmd.value();
+    else if (arg == "--threshold")         threshold                 = std::stof(cmd.value());
+    else if (arg == "--noise")             noise                     = std::stof(cmd.value());
+    else if (arg == "--gain")              gain                      = std::stof(cmd.value());
+    else if (arg == "--adc-max")           adcMax                    = std::stod(cmd.value());
+    else if (arg == "--time-resolution")   timeResolution            = std::stof(cmd.value());
+    else if (arg == "--constants")         constantsFile             = cmd.value();
+    else if (arg == "--seed")              settings.seed             = std::stoull(cmd.value());
+    else if (arg == "--threads")           nThreads                  = std::max(1, std::stoi(cmd.value()));
+    else if (cmd.isOption())               return cmd.usage();
+    else                                   inputs.push_back(arg);
+  }
+  if (compact.empty() || output.empty() || inputs.empty()) return cmd.usage();
+
+  // The geometry fixes the cell layout of the constants table
+  dd4hep::Detector& description = dd4hep::Detector::getInstance();
+  description.fromCompact(compact);
+  const dd4hep::Readout readout = description.sensitiveDetector(detector).readout();
+  auto* segmentation = dynamic_cast<const ToySegmentation*>(readout.segmentation().segmentation());
+  if (!segmentation || !segmentation->isFrozen()) {
+    std::cerr << "the readout of " << detector << " has no frozen ToySegmentation" << std::endl;
+    return 1;
+  }
+  DigiConstants constants(segmentation->numberOfCells(), threshold, noise, gain, timeResolution);
+  constants.adcMax = adcMax;
+  if (!constantsFile.empty()) constants.read(constantsFile);
+
+  ROOT::EnableThreadSafety();
+  podio::ROOTReader reader;
+  reader.openFiles(inputs);
+  podio::ROOTWriter writer(output);
+  if (reader.getEntries("metadata") > 0) {
+    settings.positions = ToyCellPositionTable(podio::Frame(reader.readEntry("metadata", 0)), settings.collection);
+  }
+
+  // Frames are read and written on this thread, in order
+  ToyThreadPool pool(nThreads);
+  const unsigned nEvents = reader.getEntries("events");
+  processInOrder(pool, nEvents,
+    [&]() { return podio::Frame(reader.readNextEntry("events")); },
+    [&](podio::Frame&& event) { return digitize(std::move(event), settings, *segmentation, constants); },
+    [&](podio::Frame&& digitized) { writer.writeFrame(digitized, "events"); });
+
+  for (unsigned i=0; i<reader.getEntries("runs"); i++) {
+    writer.writeFrame(podio::Frame(reader.readNextEntry("runs")), "runs");
+  }
+  // The input metadata, plus the cell ID encoding of the digitized collection for readers decoding its cell IDs
+  podio::Frame metadata;
+  if (reader.getEntries("metadata") > 0) metadata = podio::Frame(reader.readEntry("metadata", 0));
+  metadata.putParameter(settings.outputCollection + "__CellIDEncoding", readout.idSpec().fieldDescription());
+  writer.writeFrame(metadata, "metadata");
+  writer.finish();
+  std::cout << "Digitized " << nEvents << " events into " << output << " with " << nThreads << " threads" << std::endl;
+  return 0;
+}
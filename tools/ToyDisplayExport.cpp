@@ -0,0 +1,290 @@
+// Exports ToyCalorimeter events for the event display as one columnar binary file per run.
+//
+// Every event is stored at several levels of detail. Level 0 has all hits and MC particles. Level k merges the
+// hits of 2^k x 2^k crystals in (phi, theta) of every depth layer, with energy-weighted positions and summed
+// energies, and keeps only MC particles above track-cut*10^(k-1) GeV. eventdisplay.py (ToyDisplayFile)
+// memory-maps the file and reads every column as a numpy array without copying it.
+//
+// Layout, little-endian, every column starts at a multiple of 8 bytes:
+//   Header        magic "TOYDISP1", uint32 version, uint32 nLevels, uint64 nEvents, uint64 directoryOffset
+//   hit block     uint64 cellID[n], float32 x[n], y[n], z[n], energy[n]                  (mm, GeV)
+//   track block   int32 pdg[n], float32 energy[n], x0[n], y0[n], z0[n], x1[n], y1[n], z1[n] (vertex, endpoint)
+//   directory     EventEntry[nEvents], then Block[nEvents*nLevels] (event-major)
+//
+// The hit collection can hold edm4hep::SimCalorimeterHits, edm4toy::SimToyCalorimeterHits or
+// edm4toy::CompactToyCalorimeterHits, the latter positioned from the cell table in the metadata.
+//
+//   ToyDisplayExport -o display.bin [options] toy_calorimeter_output.root ...
+//
+//   --collection NAME    calorimeter hit collection                  (ToyCalorimeterHits)
+//   --particles NAME     MC particle collection                      (MCParticles)
+//   --levels N           levels of detail, including the full event  (4)
+//   --track-cut E        energy cut of level 1 in GeV                (0.01)
+#include "ToyCellPositionTable.h"
+#include "ToyToolSupport.h"
+#include <DDSegmentation/BitFieldCoder.h>
+#include <edm4hep/EventHeaderCollection.h>
+#include <edm4hep/MCParticleCollection.h>
+#include <podio/Frame.h>
+#include <podio/ROOTReader.h>
+#include <podio/podioVersion.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+  struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t nLevels;
+    uint64_t nEvents;
+    uint64_t directoryOffset;
+  };
+  struct EventEntry {
+    uint64_t run;
+    uint64_t event;
+  };
+  struct Block {
+    uint64_t hitsOffset;
+    uint64_t nHits;
+    uint64_t tracksOffset;
+    uint64_t nTracks;
+  };
+
+  struct Hits {
+    std::vector<uint64_t> cellID;
+    std::vector<float>    x, y, z, energy;
+    void push_back(uint64_t id, float px, float py, float pz, float e) {
+      cellID.push_back(id);
+      x.push_back(px);
+      y.push_back(py);
+      z.push_back(pz);
+      energy.push_back(e);
+    }
+  };
+  struct Tracks {
+    std::vector<int32_t> pdg;
+    std::vector<float>   energy, x0, y0, z0, x1, y1, z1;
+  };
+
+  class DisplayFileWriter {
+    public:
+      DisplayFileWriter(const std::string& path, uint32_t nLevels) : m_out(path, std::ios::binary), m_nLevels(nLevels) {
+        if (!m_out) throw std::runtime_error("cannot create " + path);
+        Header header {};
+        m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      }
+
+      void beginEvent(uint64_t run, uint64_t event) { m_events.push_back({run, event}); }
+
+      void addLevel(const Hits& hits, const Tracks& tracks) {
+        Block block {};
+        block.nHits      = hits.cellID.size();
+        block.hitsOffset = column(hits.cellID);
+        for (const auto* c : {&hits.x, &hits.y, &hits.z, &hits.energy}) column(*c);
+        block.nTracks      = tracks.pdg.size();
+        block.tracksOffset = column(tracks.pdg);
+        for (const auto* c : {&tracks.energy, &tracks.x0, &tracks.y0, &tracks.z0, &tracks.x1, &tracks.y1, &tracks.z1}) column(*c);
+        m_blocks.push_back(block);
+      }
+
+      void finish() {
+        Header header {};
+        std::memcpy(header.magic, "TOYDISP1", 8);
+        header.version         = 1;
+        header.nLevels         = m_nLevels;
+        header.nEvents         = m_events.size();
+        header.directoryOffset = position();
+        m_out.write(reinterpret_cast<const char*>(m_events.data()), m_events.size()*sizeof(EventEntry));
+        m_out.write(reinterpret_cast<const char*>(m_blocks.data()), m_blocks.size()*sizeof(Block));
+        m_out.seekp(0);
+        m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        m_out.close();
+        if (!m_out) throw std::runtime_error("write error in the display file");
+      }
+
+    private:
+      uint64_t position() { return static_cast<uint64_t>(m_out.tellp()); }
+
+      // Writes a column padded to 8 bytes, returns its offset
+      template <typename T> uint64_t column(const std::vector<T>& values) {
+        const uint64_t offset = position();
+        const std::size_t bytes = values.size()*sizeof(T);
+        m_out.write(reinterpret_cast<const char*>(values.data()), bytes);
+        static const char zeros[8] = {};
+        if (bytes % 8) m_out.write(zeros, 8 - bytes % 8);
+        return offset;
+      }
+
+      std::ofstream           m_out;
+      uint32_t                m_nLevels;
+      std::vector<EventEntry> m_events;
+      std::vector<Block>      m_blocks;
+  };
+
+  // Cell ID fields used to merge neighbouring crystals
+  struct CellFields {
+    const dd4hep::DDSegmentation::BitFieldElement* phi   {nullptr};
+    const dd4hep::DDSegmentation::BitFieldElement* theta {nullptr};
+    std::vector<const dd4hep::DDSegmentation::BitFieldElement*> subCell;
+  };
+
+  // Level k: hits of 2^k x 2^k crystals in (phi, theta) summed into one, sub-cells merged as well.
+  // The merged hit takes the cell ID of the first crystal of its group.
+  void mergeCells(const Hits& in, const CellFields& fields, int level, Hits& out) {
+    const std::size_t n = in.cellID.size();
+    std::vector<uint64_t> group(n);
+    for (std::size_t i=0; i<n; i++) {
+      uint64_t id = in.cellID[i];
+      fields.phi->set(id, (fields.phi->value(id) >> level) << level);
+      fields.theta->set(id, (fields.theta->value(id) >> level) << level);
+      for (const auto* field : fields.subCell) field->set(id, 0);
+      group[i] = id;
+    }
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return group[a] < group[b]; });
+
+    for (std::size_t first=0; first<n; ) {
+      std::size_t last = first;
+      double e = 0, x = 0, y = 0, z = 0;
+      for (; last<n && group[order[last]] == group[order[first]]; last++) {
+        const uint32_t i = order[last];
+        const double w = in.energy[i];
+        e += w;
+        x += w*in.x[i];
+        y += w*in.y[i];
+        z += w*in.z[i];
+      }
+      if (e > 0) {
+        out.push_back(group[order[first]], x/e, y/e, z/e, e);
+      }
+      else {
+        // No energy to weight with, take the plain mean
+        x = y = z = 0;
+        for (std::size_t k=first; k<last; k++) {
+          x += in.x[order[k]];
+          y += in.y[order[k]];
+          z += in.z[order[k]];
+        }
+        const double m = last - first;
+        out.push_back(group[order[first]], x/m, y/m, z/m, 0.f);
+      }
+      first = last;
+    }
+  }
+
+  template <typename COLL> void fillHits(const COLL& collection, const ToyCalorimeter::ToyCellPositionTable& positions, Hits& hits) {
+    for (const auto& hit : collection) {
+      const auto pos = ToyCalorimeter::hitPosition(hit, positions);
+      hits.push_back(hit.getCellID(), pos.x, pos.y, pos.z, hit.getEnergy());
+    }
+  }
+
+  void fillTracks(const edm4hep::MCParticleCollection& particles, double cut, Tracks& tracks) {
+    for (const auto& p : particles) {
+      const double energy = p.getEnergy();
+      if (energy < cut) continue;
+      const auto& v = p.getVertex();
+      const auto& e = p.getEndpoint();
+      tracks.pdg.push_back(p.getPDG());
+      tracks.energy.push_back(energy);
+      tracks.x0.push_back(v.x);
+      tracks.y0.push_back(v.y);
+      tracks.z0.push_back(v.z);
+      tracks.x1.push_back(e.x);
+      tracks.y1.push_back(e.y);
+      tracks.z1.push_back(e.z);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  std::string output, collection = "ToyCalorimeterHits", particlesName = "MCParticles";
+  std::vector<std::string> inputs;
+  int nLevels = 4;
+  double trackCut = 0.01;
+
+  ToyCalorimeter::ToyCommandLine cmd(argc, argv,
+    "ToyDisplayExport -o display.bin [--collection NAME] [--particles NAME] [--levels N]\n"
+    "         [--track-cut E] input.root ...");
+  while (cmd.next()) {
+    const std::string& arg = cmd.arg();
+    if      (arg == "-o")             output        = cmd.value();
+    else if (arg == "--collection")   collection    = cmd.value();
+    else if (arg == "--particles")    particlesName = cmd.value();
+    else if (arg == "--levels")       nLevels       = std::max(1, std::stoi(cmd.value()));
+    else if (arg == "--track-cut")    trackCut      = std::stod(cmd.value());
+    else if (cmd.isOption())          return cmd.usage();
+    else                              inputs.push_back(arg);
+  }
+  if (output.empty() || inputs.empty()) return cmd.usage();
+
+  podio::ROOTReader reader;
+  reader.openFiles(inputs);
+
+  // The cell ID layout of the hit collection is stored in the metadata by Geant4EDM4ToyReadout
+  podio::Frame metadata(reader.readEntry("metadata", 0));
+  #if podio_VERSION_MAJOR > 0 || podio_VERSION_MINOR > 16 || podio_VERSION_PATCH > 2
+  const std::string encoding = metadata.getParameter<std::string>(collection + "__CellIDEncoding").value_or("");
+  #else
+  const std::string encoding = metadata.getParameter<std::string>(collection + "__CellIDEncoding");
+  #endif
+  if (encoding.empty()) {
+    std::cerr << "no cell ID encoding for collection " << collection << " in the input metadata" << std::endl;
+    return 1;
+  }
+  dd4hep::DDSegmentation::BitFieldCoder coder(encoding);
+  const ToyCalorimeter::ToyCellPositionTable positions(metadata, collection);
+  CellFields fields;
+  fields.phi   = &coder["phi"];
+  fields.theta = &coder["theta"];
+  for (const auto& element : coder.fields()) {
+    // Sub-cell fields (x, y, z by default) are all merged into the crystal
+    const std::string& name = element.name();
+    if (name != "system" && name != "phi" && name != "theta" && name != "depth") fields.subCell.push_back(&coder[name]);
+  }
+
+  DisplayFileWriter writer(output, nLevels);
+  const unsigned nEvents = reader.getEntries("events");
+  uint64_t nHits = 0, nTracks = 0;
+  for (unsigned ev=0; ev<nEvents; ev++) {
+    podio::Frame frame(reader.readNextEntry("events"));
+    const auto& headers = frame.get<edm4hep::EventHeaderCollection>("EventHeader");
+    writer.beginEvent(headers.empty() ? 0 : headers[0].getRunNumber(), headers.empty() ? ev : headers[0].getEventNumber());
+
+    Hits full;
+    const podio::CollectionBase* hits = frame.get(collection);
+    const bool known = ToyCalorimeter::visitSimCalorimeterHits(hits, [&](const auto& simHits) { fillHits(simHits, positions, full); });
+    if (!known && hits) {
+      std::cerr << collection << " is a " << hits->getTypeName() << ", not a simulated calorimeter hit collection" << std::endl;
+      return 1;
+    }
+    const auto* particles = dynamic_cast<const edm4hep::MCParticleCollection*>(frame.get(particlesName));
+
+    for (int level=0; level<nLevels; level++) {
+      Hits merged;
+      if (level > 0) mergeCells(full, fields, level, merged);
+      Tracks tracks;
+      if (particles) fillTracks(*particles, level > 0 ? trackCut*std::pow(10., level-1) : 0., tracks);
+      writer.addLevel(level > 0 ? merged : full, tracks);
+      if (level == 0) {
+        nHits   += full.cellID.size();
+        nTracks += tracks.pdg.size();
+      }
+    }
+  }
+  writer.finish();
+  std::cout << "Exported " << nEvents << " events (" << nHits << " hits, " << nTracks << " MC particles) with "
+            << nLevels << " levels of detail to " << output << std::endl;
+  return 0;
+}
@@ -0,0 +1,147 @@
+// Write and read throughput of the Geant4EDM4ToyReadout output settings.
+//
+// The events of a ToyCalorimeter output file are loaded into memory once and written again with every
+// combination of backend, compression and flush size, so the timings contain the I/O only, no simulation.
+// Each file is then read back with all collections unpacked.
+//
+//   ToyIOBenchmark [options] toy_calorimeter_output.root
+//
+//   -n N                   events to use                               (all)
+//   --backends A,B         TTree and/or RNTuple                        (TTree)
+//   --compression A:L,...  algorithm:level, ZSTD, LZ4, LZMA, ZLIB     (ZSTD:5,LZ4:4,LZMA:7)
+//   --flush B,...          TTree flush sizes in bytes, 0 = ROOT default (0)
+//
+// RNTuple is written once with the podio defaults, the podio RNTuple writer takes no compression or flush size.
+//   --dir PATH             where the test files are written            (.)
+#include "ToyFrameWriter.h"
+#include "ToyToolSupport.h"
+#include <podio/Frame.h>
+#include <podio/ROOTReader.h>
+#include <podio/podioVersion.h>
+#ifdef TOYCALO_USE_RNTUPLE
+#if podio_VERSION_MAJOR > 0
+#include <podio/RNTupleReader.h>
+#else
+#include <podio/ROOTNTupleReader.h>
+#endif
+#endif
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ToyCalorimeter;
+
+namespace {
+
+  std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ','); ) items.push_back(item);
+    return items;
+  }
+
+  double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // Reads all events with every collection unpacked, returns the number of events
+  template <typename READER> unsigned read_all(const std::string& fileName) {
+    READER reader;
+    reader.openFile(fileName);
+    const unsigned n = reader.getEntries("events");
+    for (unsigned i=0; i<n; i++) {
+      podio::Frame frame(reader.readNextEntry("events"));
+      for (const auto& name : frame.getAvailableCollections()) frame.get(name);
+    }
+    return n;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::string input, dir = ".";
+  std::vector<std::string> backends = {"TTree"}, compressions = {"ZSTD:5", "LZ4:4", "LZMA:7"}, flushes = {"0"};
+  long maxEvents = -1;
+  ToyCommandLine cmd(argc, argv,
+    "ToyIOBenchmark [-n N] [--backends A,B] [--compression ALG:LEVEL,...] [--flush B,...] [--dir PATH] input.root");
+  while (cmd.next()) {
+    const std::string& arg = cmd.arg();
+    if      (arg == "-n")            maxEvents    = std::stol(cmd.value());
+    else if (arg == "--backends")    backends     = split(cmd.value());
+    else if (arg == "--compression") compressions = split(cmd.value());
+    else if (arg == "--flush")       flushes      = split(cmd.value());
+    else if (arg == "--dir")         dir          = cmd.value();
+    else if (cmd.isOption())         return cmd.usage();
+    else                             input = arg;
+  }
+  if (input.empty()) return cmd.usage();
+
+  // Events, runs and metadata held in memory with all collections unpacked
+  podio::ROOTReader reader;
+  reader.openFile(input);
+  std::vector<podio::Frame> events, runs, metadata;
+  unsigned nEvents = reader.getEntries("events");
+  if (maxEvents >= 0 && long(nEvents) > maxEvents) nEvents = unsigned(maxEvents);
+  for (unsigned i=0; i<nEvents; i++) {
+    events.emplace_back(reader.readNextEntry("events"));
+    for (const auto& name : events.back().getAvailableCollections()) events.back().get(name);
+  }
+  for (unsigned i=0; i<reader.getEntries("runs"); i++)     runs.emplace_back(reader.readNextEntry("runs"));
+  for (unsigned i=0; i<reader.getEntries("metadata"); i++) metadata.emplace_back(reader.readNextEntry("metadata"));
+
+  std::printf("%u events from %s\n", nEvents, input.c_str());
+  std::printf("%-8s %-8s %10s %12s %12s %12s %12s\n", "backend", "algo", "flush", "size [MB]", "write [ev/s]", "write [MB/s]", "read [ev/s]");
+  // The RNTuple writer takes no write options: one file with the podio defaults
+  const std::vector<std::string> defaultCompression = {"default"}, defaultFlush = {"0"};
+  for (const auto& backend : backends) {
+    const bool rntuple = backend == "RNTuple";
+    for (const auto& compression : rntuple ? defaultCompression : compressions) {
+      for (const auto& flush : rntuple ? defaultFlush : flushes) {
+        ToyWriterOptions options;
+        options.backend = backend;
+        if (!rntuple) {
+          options.compression = compression.substr(0, compression.find(':'));
+          options.level       = compression.find(':') != std::string::npos ? std::stoi(compression.substr(compression.find(':')+1)) : -1;
+          options.flushSize   = std::stoi(flush);
+        }
+        const std::string fileName = dir + "/toyio_" + backend + "_" + options.compression + std::to_string(options.level)
+                                   + "_" + flush + ".root";
+
+        auto start = std::chrono::steady_clock::now();
+        try {
+          auto writer = ToyFrameWriter::create(fileName, options);
+          for (const auto& frame : events)   writer->writeFrame(frame, "events");
+          for (const auto& frame : runs)     writer->writeFrame(frame, "runs");
+          for (const auto& frame : metadata) writer->writeFrame(frame, "metadata");
+          writer->finish();
+        }
+        catch (const std::exception& e) {
+          std::cerr << backend << " " << compression << ": " << e.what() << std::endl;
+          continue;
+        }
+        const double writeTime = seconds_since(start);
+        const double size = std::filesystem::file_size(fileName)/1.e6;
+
+        start = std::chrono::steady_clock::now();
+        unsigned nRead = 0;
+        if (backend == "TTree") nRead = read_all<podio::ROOTReader>(fileName);
+#ifdef TOYCALO_USE_RNTUPLE
+#if podio_VERSION_MAJOR > 0
+        else nRead = read_all<podio::RNTupleReader>(fileName);
+#else
+        else nRead = read_all<podio::ROOTNTupleReader>(fileName);
+#endif
+#endif
+        const double readTime = seconds_since(start);
+
+        std::printf("%-8s %-8s %10s %12.2f %12.1f %12.2f %12.1f\n", backend.c_str(), compression.c_str(), flush.c_str(),
+                    size, nEvents/writeTime, size/writeTime, nRead/readTime);
+        std::filesystem::remove(fileName);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,250 @@
+// Joins the per-thread output files of Geant4EDM4ToyReadout (FilePerThread) into one podio file.
+//
+//   ToyMergeOutput -o output.root output.t*.root
+//
+// The events of the merged file are ordered by (run number, event number). Only the small EventHeader
+// branch is decompressed to find that order. When the input files, taken one after the other, are already
+// in that order (one worker, FilesByRun files of consecutive runs, ...) the events are copied basket by
+// basket without being decompressed. Otherwise each event is read as a podio frame and written again in
+// order: compressed baskets hold several consecutive entries and cannot be reordered as they are.
+//
+// Run frames are joined per run number: the frame of the first file with that run is kept, and the hot path
+// counters of the others (<action>__Threads, __Steps, ..., one entry per thread) are appended to it, so the
+// merged frame holds the entries of every thread. The metadata and the podio bookkeeping are taken from the
+// first input: all files of one job share the collections and their cell ID encodings.
+#include "ToyFrameWriter.h"
+#include "ToyToolSupport.h"
+#include <edm4hep/EventHeaderData.h>
+#include <podio/Frame.h>
+#include <podio/ROOTReader.h>
+#include <podio/podioVersion.h>
+#include <Compression.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace ToyCalorimeter;
+
+namespace {
+
+  struct Entry {
+    int         run;
+    int         event;
+    std::size_t file;
+    Long64_t    entry;
+    bool operator<(const Entry& o) const { return std::tie(run, event, file, entry) < std::tie(o.run, o.event, o.file, o.entry); }
+  };
+
+  template <typename T> std::vector<T> parameter(const podio::Frame& frame, const std::string& key) {
+    #if podio_VERSION_MAJOR > 0 || podio_VERSION_MINOR > 16 || podio_VERSION_PATCH > 2
+    return frame.getParameter<std::vector<T>>(key).value_or(std::vector<T>{});
+    #else
+    return frame.getParameter<std::vector<T>>(key);
+    #endif
+  }
+
+  template <typename T> std::vector<std::string> parameterKeys(const podio::Frame& frame) {
+    #if podio_VERSION_MAJOR > 0 || podio_VERSION_MINOR > 16 || podio_VERSION_PATCH > 2
+    return frame.getParameterKeys<T>();
+    #else
+    return frame.getParameters().getKeys<T>();
+    #endif
+  }
+
+  // Appends the values of the parameters of from starting with prefix to those of into
+  template <typename T> void append(podio::Frame& into, const podio::Frame& from, const std::string& prefix) {
+    for (const auto& key : parameterKeys<T>(from)) {
+      if (key.rfind(prefix, 0) != 0) continue;
+      auto values = parameter<T>(into, key);
+      const auto more = parameter<T>(from, key);
+      values.insert(values.end(), more.begin(), more.end());
+      into.putParameter(key, std::move(values));
+    }
+  }
+
+  // Hot path counters of another file of the same run: every action with <action>__Threads has one entry per
+  // thread in each of its parameters (the High words of old podio versions included), which are appended
+  void joinCounters(podio::Frame& into, const podio::Frame& from) {
+    const std::string threads = "__Threads";
+    for (const auto& key : parameterKeys<int>(from)) {
+      if (key.size() <= threads.size() || key.compare(key.size()-threads.size(), threads.size(), threads) != 0) continue;
+      const std::string prefix = key.substr(0, key.size()-threads.size()) + "__";
+      append<int>(into, from, prefix);
+      append<float>(into, from, prefix);
+      #if podio_VERSION_MAJOR > 0 || podio_VERSION_MINOR > 16 || podio_VERSION_PATCH > 2
+      append<double>(into, from, prefix);
+      #endif
+    }
+  }
+
+  // Writer options with the compression of an input file
+  ToyWriterOptions writerOptions(const TFile& file) {
+    using Algorithm = ROOT::RCompressionSetting::EAlgorithm;
+    static const std::map<int, std::string> names = {
+      {Algorithm::kZLIB, "ZLIB"}, {Algorithm::kLZMA, "LZMA"}, {Algorithm::kLZ4, "LZ4"}, {Algorithm::kZSTD, "ZSTD"}};
+    ToyWriterOptions options;
+    const int settings = file.GetCompressionSettings();
+    auto name = names.find(settings/100);
+    if (name != names.end()) {
+      options.compression = name->second;
+      options.level       = settings%100;
+    }
+    return options;
+  }
+
+}
+
+int main(int argc, char** argv) {
+  std::string output;
+  std::vector<std::string> inputs;
+  ToyCommandLine cmd(argc, argv, "ToyMergeOutput -o output.root input.root ...");
+  while (cmd.next()) {
+    const std::string& arg = cmd.arg();
+    if      (arg == "-o")         output = cmd.value();
+    else if (cmd.isOption())      return cmd.usage();
+    else                          inputs.push_back(arg);
+  }
+  if (output.empty() || inputs.empty()) return cmd.usage();
+
+  std::vector<std::unique_ptr<TFile>> files;
+  std::vector<TTree*> events;
+  for (const auto& name : inputs) {
+    files.emplace_back(TFile::Open(name.c_str(), "READ"));
+    if (!files.back() || files.back()->IsZombie()) {
+      std::cerr << "cannot open " << name << std::endl;
+      return 1;
+    }
+    events.push_back(files.back()->Get<TTree>("events"));
+    if (!events.back() || !files.back()->Get<TTree>("runs")) {
+      std::cerr << name << " is not a Geant4EDM4ToyReadout output file" << std::endl;
+      return 1;
+    }
+  }
+
+  // Event order from the EventHeader branch alone
+  std::vector<Entry> order;
+  for (std::size_t f=0; f<events.size(); f++) {
+    std::vector<edm4hep::EventHeaderData>* header = nullptr;
+    events[f]->SetBranchStatus("*", false);
+    events[f]->SetBranchStatus("EventHeader*", true);
+    events[f]->SetBranchAddress("EventHeader", &header);
+    for (Long64_t i=0; i<events[f]->GetEntries(); i++) {
+      events[f]->GetEntry(i);
+      if (header && !header->empty())
+        order.push_back({header->front().runNumber, header->front().eventNumber, f, i});
+      else
+        order.push_back({-1, -1, f, i});
+    }
+    events[f]->ResetBranchAddresses();
+    events[f]->SetBranchStatus("*", true);
+    delete header;
+  }
+  const bool inOrder = std::is_sorted(order.begin(), order.end());
+
+  // One run frame per run number, in run order, with the counters of all files
+  std::vector<std::unique_ptr<podio::ROOTReader>> readers;
+  std::map<int, podio::Frame> runs;
+  for (const auto& name : inputs) {
+    readers.emplace_back(std::make_unique<podio::ROOTReader>());
+    readers.back()->openFile(name);
+    for (unsigned i=0; i<readers.back()->getEntries("runs"); i++) {
+      podio::Frame run(readers.back()->readEntry("runs", i));
+      #if podio_VERSION_MAJOR > 0 || podio_VERSION_MINOR > 16 || podio_VERSION_PATCH > 2
+      const int runNumber = run.getParameter<int>("runNumber").value_or(-1);
+      #else
+      const int runNumber = run.getParameter<int>("runNumber");
+      #endif
+      auto [merged, inserted] = runs.try_emplace(runNumber, std::move(run));
+      if (!inserted) joinCounters(merged->second, run);
+    }
+  }
+  const ToyWriterOptions options = writerOptions(*files.front());
+
+  if (!inOrder) {
+    // Every event read and written again in order, with the joined run frames and the first file's metadata
+    std::sort(order.begin(), order.end());
+    try {
+      auto writer = ToyFrameWriter::create(output, options);
+      for (const auto& e : order) {
+        writer->writeFrame(podio::Frame(readers[e.file]->readEntry("events", e.entry)), "events");
+      }
+      for (const auto& [number, run] : runs) writer->writeFrame(run, "runs");
+      for (unsigned i=0; i<readers.front()->getEntries("metadata"); i++) {
+        writer->writeFrame(podio::Frame(readers.front()->readEntry("metadata", i)), "metadata");
+      }
+      writer->finish();
+    }
+    catch (const std::exception& e) {
+      std::cerr << "cannot write " << output << ": " << e.what() << std::endl;
+      return 1;
+    }
+    std::cout << "Merged " << order.size() << " events and " << runs.size() << " runs from " << inputs.size()
+              << " files into " << output << " (events rewritten in order)" << std::endl;
+    return 0;
+  }
+
+  // The joined run frames go through podio into a scratch file, whose runs tree is copied like the others
+  const std::string runsFile = output + ".runs.tmp";
+  try {
+    auto writer = ToyFrameWriter::create(runsFile, options);
+    for (const auto& [number, run] : runs) writer->writeFrame(run, "runs");
+    writer->finish();
+  }
+  catch (const std::exception& e) {
+    std::cerr << "cannot write " << runsFile << ": " << e.what() << std::endl;
+    return 1;
+  }
+  std::unique_ptr<TFile> runsInput(TFile::Open(runsFile.c_str(), "READ"));
+  TTree* runsTree = runsInput ? runsInput->Get<TTree>("runs") : nullptr;
+  if (!runsTree) {
+    std::cerr << "cannot read the runs of " << runsFile << std::endl;
+    return 1;
+  }
+
+  TFile merged(output.c_str(), "RECREATE");
+  if (merged.IsZombie()) {
+    std::cerr << "cannot create " << output << std::endl;
+    return 1;
+  }
+  merged.SetCompressionSettings(files.front()->GetCompressionSettings());
+
+  merged.cd();
+  TTree* mergedEvents = events.front()->CloneTree(-1, "fast");
+  for (std::size_t f=1; f<events.size(); f++) {
+    mergedEvents->CopyEntries(events[f], -1, "fast");
+  }
+  merged.cd();
+  TTree* mergedRuns = runsTree->CloneTree(-1, "fast");
+
+  // metadata, podio_metadata and anything else: taken over from the first file
+  std::vector<TTree*> others;
+  std::set<std::string> names = {"events", "runs"};
+  for (auto* key : *files.front()->GetListOfKeys()) {
+    const std::string name = key->GetName();
+    if (!names.insert(name).second) continue;     // older cycles of a tree
+    auto* tree = files.front()->Get<TTree>(name.c_str());
+    if (!tree) continue;
+    merged.cd();
+    others.push_back(tree->CloneTree(-1, "fast"));
+  }
+
+  mergedEvents->Write();
+  mergedRuns->Write();
+  for (auto* tree : others) tree->Write();
+  const Long64_t nEvents = mergedEvents->GetEntries();
+  merged.Close();
+  runsInput.reset();
+  std::remove(runsFile.c_str());
+
+  std::cout << "Merged " << nEvents << " events and " << runs.size() << " runs from " << inputs.size()
+            << " files into " << output << " (compressed baskets copied)" << std::endl;
+  return 0;
+}
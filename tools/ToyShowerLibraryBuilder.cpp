@@ -0,0 +1,143 @@
+// Builds a ToyCalorimeter shower library from full simulation output.
+//
+// Every event of the input files must contain one primary particle showering in the calorimeter,
+// e.g. a run of toycalo_steering.py with SIM.gun.multiplicity = 1. The per-cell energy fractions of the
+// shower are stored relative to the crystal the primary enters; ToyShowerLibraryModel replays them.
+//
+//   ToyShowerLibraryBuilder -o showers.lib [options] toy_calorimeter_output.root ...
+//
+//   --collection NAME    calorimeter hit collection            (ToyCalorimeterHits)
+//   --phi-segments N     crystals in the phi ring               (64)
+//   --inner-r R          inner radius of the envelope in mm     (2250)
+//   --pdg A,B,...        particle types to record               (11,-11,22)
+//   --energy-bins N      log energy bins between emin and emax  (20)
+//   --emin E --emax E    kinetic energy range in GeV            (1, 100)
+//   --angle-bins N       bins in cos(entry angle) over [-1,1]   (10)
+//
+// Showers are binned and normalised with the kinetic energy of the primary, which is what
+// ToyShowerLibraryModel looks up and scales the replayed deposits with.
+#include "ToyShowerLibrary.h"
+#include "ToyToolSupport.h"
+#include <DDSegmentation/BitFieldCoder.h>
+#include <edm4hep/MCParticleCollection.h>
+#include <edm4hep/SimCalorimeterHitCollection.h>
+#include <podio/Frame.h>
+#include <podio/ROOTReader.h>
+#include <podio/podioVersion.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ToyCalorimeter;
+
+namespace {
+
+  std::vector<int> parse_pdg(const std::string& list) {
+    std::vector<int> pdg;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ','); ) {
+      pdg.push_back(std::stoi(item));
+    }
+    return pdg;
+  }
+
+  // Point where a straight line from the vertex reaches radius r in the xy plane
+  bool entry_point(const edm4hep::Vector3d& v, const edm4hep::Vector3f& p, double r, double& x, double& y) {
+    const double a = double(p.x)*p.x + double(p.y)*p.y;
+    const double b = 2*(v.x*p.x + v.y*p.y);
+    const double c = v.x*v.x + v.y*v.y - r*r;
+    const double disc = b*b - 4*a*c;
+    if (a <= 0 || disc < 0) return false;
+    const double t = (-b + std::sqrt(disc))/(2*a);
+    x = v.x + t*p.x;
+    y = v.y + t*p.y;
+    return true;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::string output, collection = "ToyCalorimeterHits";
+  std::vector<std::string> inputs;
+  std::vector<int> pdg = {11, -11, 22};
+  unsigned nPhi = 64, nEnergy = 20, nAngle = 10;
+  double innerR = 2250., eMin = 1., eMax = 100.;
+
+  ToyCommandLine cmd(argc, argv,
+    "ToyShowerLibraryBuilder -o library [--collection NAME] [--phi-segments N] [--inner-r R]\n"
+    "         [--pdg A,B,...] [--energy-bins N] [--emin E] [--emax E] [--angle-bins N] input.root ...");
+  while (cmd.next()) {
+    const std::string& arg = cmd.arg();
+    if      (arg == "-o")             output     = cmd.value();
+    else if (arg == "--collection")   collection = cmd.value();
+    else if (arg == "--phi-segments") nPhi       = std::stoul(cmd.value());
+    else if (arg == "--inner-r")      innerR     = std::stod(cmd.value());
+    else if (arg == "--pdg")          pdg        = parse_pdg(cmd.value());
+    else if (arg == "--energy-bins")  nEnergy    = std::stoul(cmd.value());
+    else if (arg == "--emin")         eMin       = std::stod(cmd.value());
+    else if (arg == "--emax")         eMax       = std::stod(cmd.value());
+    else if (arg == "--angle-bins")   nAngle     = std::stoul(cmd.value());
+    else if (cmd.isOption())          return cmd.usage();
+    else                              inputs.push_back(arg);
+  }
+  if (output.empty() || inputs.empty()) return cmd.usage();
+
+  podio::ROOTReader reader;
+  reader.openFiles(inputs);
+
+  // The cell ID layout of the hit collection is stored in the metadata by Geant4EDM4ToyReadout
+  podio::Frame metadata(reader.readEntry("metadata", 0));
+  #if podio_VERSION_MAJOR > 0 || podio_VERSION_MINOR > 16 || podio_VERSION_PATCH > 2
+  const std::string encoding = metadata.getParameter<std::string>(collection + "__CellIDEncoding").value_or("");
+  #else
+  const std::string encoding = metadata.getParameter<std::string>(collection + "__CellIDEncoding");
+  #endif
+  if (encoding.empty()) {
+    std::cerr << "no cell ID encoding for collection " << collection << " in the input metadata" << std::endl;
+    return 1;
+  }
+  dd4hep::DDSegmentation::BitFieldCoder coder(encoding);
+  const auto& phiField = coder["phi"];
+
+  ToyShowerLibraryWriter writer(pdg, nEnergy, eMin, eMax, nAngle, nPhi);
+  const unsigned nEvents = reader.getEntries("events");
+  unsigned skipped = 0;
+  for (unsigned ev=0; ev<nEvents; ev++) {
+    podio::Frame frame(reader.readNextEntry("events"));
+    const auto& particles = frame.get<edm4hep::MCParticleCollection>("MCParticles");
+    const auto& hits      = frame.get<edm4hep::SimCalorimeterHitCollection>(collection);
+
+    // The primary is the first generator particle without parents
+    auto primary = std::find_if(particles.begin(), particles.end(), [](const auto& p) {
+      return p.getGeneratorStatus() == 1 && p.getParents().empty();
+    });
+    double x, y;
+    if (primary == particles.end() || hits.empty() ||
+        !entry_point((*primary).getVertex(), (*primary).getMomentum(), innerR, x, y)) {
+      ++skipped;
+      continue;
+    }
+    const auto& mom = (*primary).getMomentum();
+    const double energy = (*primary).getEnergy() - (*primary).getMass();
+    const int    phi    = ToyShowerLibrary::entryPhi(x, y, nPhi);
+    const double cosine = ToyShowerLibrary::entryCosine(mom.x, mom.y, mom.z, phi, nPhi);
+
+    std::vector<ToyShowerLibrary::Deposit> deposits;
+    deposits.reserve(hits.size());
+    for (const auto& hit : hits) {
+      if (hit.getEnergy() <= 0) continue;
+      uint64_t cellID = hit.getCellID();
+      const long relative = ((long(phiField.value(cellID)) - phi) % long(nPhi) + nPhi) % nPhi;
+      phiField.set(cellID, relative);
+      deposits.push_back({cellID, hit.getEnergy()/energy});
+    }
+    if (!writer.add((*primary).getPDG(), energy, cosine, std::move(deposits))) ++skipped;
+  }
+
+  writer.write(output);
+  std::cout << "Wrote " << writer.numberOfShowers() << " showers to " << output
+            << " (" << skipped << " of " << nEvents << " events skipped)" << std::endl;
+  return 0;
+}